@@ -9,6 +9,18 @@
 
 
 namespace bm {
+    // Makes the compiler assume value is read, so that the work which
+    // computed it isn't optimized away.
+    template <typename T>
+    inline void doNotOptimize(const T& value) {
+#if defined(__GNUC__) || defined(__clang__)
+        asm volatile("" : : "r,m"(value) : "memory");
+#else
+        static const volatile void *sink;
+        sink = &value;
+#endif
+    }
+
     class Benchmark {
     public:
 
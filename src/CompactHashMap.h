@@ -0,0 +1,429 @@
+#ifndef AISDI_MAPS_COMPACTHASHMAP_H
+#define AISDI_MAPS_COMPACTHASHMAP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace aisdi {
+
+// HashMap laid out like CPython's dict: items are appended to a dense array,
+// so iterating is a linear scan in insertion order, and an open-addressed
+// table of their positions - 1, 2, 4 or 8 bytes wide, as few as the table's
+// size needs - finds them, with linear probing.
+//
+// Removal leaves a tombstone in both; the array is compacted when the table
+// is next rebuilt. Items move when the array grows or is compacted, so
+// inserting invalidates references and iterators, as with std::vector.
+template<typename KeyType, typename ValueType>
+class CompactHashMap {
+public:
+    using key_type = KeyType;
+    using mapped_type = ValueType;
+    using value_type = std::pair<const key_type, mapped_type>;
+    using size_type = std::size_t;
+    using reference = value_type&;
+    using const_reference = const value_type&;
+
+    class ConstIterator;
+
+    class Iterator;
+
+    using iterator = Iterator;
+    using const_iterator = ConstIterator;
+
+private:
+    static constexpr std::size_t REMOVED = ~std::size_t(0); // hash of a removed item
+    static constexpr std::size_t NOT_FOUND = ~std::size_t(0);
+    static constexpr std::size_t MIN_SLOTS = 8;
+
+    std::vector<value_type> items;
+    std::vector<std::size_t> hashes;     // of items, REMOVED for tombstones
+    std::vector<unsigned char> table;    // slots of indexBytes each; empty until first insert
+    std::size_t mask = 0;                // slots - 1
+    unsigned indexBytes = 1;
+    std::size_t usable = 0;              // items the array may hold before a rebuild
+    std::size_t size = 0;
+
+public:
+    CompactHashMap() { }
+
+    CompactHashMap(std::initializer_list<value_type> list)
+        : CompactHashMap()
+    {
+        for (auto&& pair : list)
+            (*this)[std::move(pair.first)] = std::move(pair.second);
+    }
+
+    CompactHashMap(const CompactHashMap& other) = default;
+
+    CompactHashMap(CompactHashMap&& other) noexcept
+        : CompactHashMap()
+    {
+        swap(other);
+    }
+
+    CompactHashMap& operator=(const CompactHashMap& other) {
+        if (this == &other) return *this;
+        CompactHashMap copy(other);
+        swap(copy);
+        return *this;
+    }
+
+    CompactHashMap& operator=(CompactHashMap&& other) noexcept {
+        if (this == &other) return *this;
+        CompactHashMap moved(std::move(other));
+        swap(moved);
+        return *this;
+    }
+
+    void swap(CompactHashMap& other) noexcept {
+        using std::swap;
+        swap(items, other.items);
+        swap(hashes, other.hashes);
+        swap(table, other.table);
+        swap(mask, other.mask);
+        swap(indexBytes, other.indexBytes);
+        swap(usable, other.usable);
+        swap(size, other.size);
+    }
+
+    bool isEmpty() const {
+        return !size;
+    }
+
+    template <typename Kk>
+    mapped_type& operator[](Kk&& key) {
+        const KeyType& searched = key;
+        std::size_t hash = hashOf(searched);
+        std::size_t found = indexOf(searched, hash);
+        if (found != NOT_FOUND) return items[found].second;
+
+        if (items.size() >= usable) rebuild(size + 1);
+        items.emplace_back(std::forward<Kk>(key), mapped_type());
+        try {
+            hashes.push_back(hash);
+        } catch (...) {
+            items.pop_back();
+            throw;
+        }
+        std::size_t slot = hash & mask;
+        while (indexAt(slot) < dummy()) slot = (slot + 1) & mask;
+        setIndex(slot, items.size() - 1);
+        ++size;
+        return items.back().second;
+    }
+
+    const mapped_type& valueOf(const key_type& key) const {
+        std::size_t found = indexOf(key, hashOf(key));
+        if (found == NOT_FOUND) throw std::out_of_range("item doesn't exist");
+        return items[found].second;
+    }
+
+    mapped_type& valueOf(const key_type& key) {
+        return const_cast<mapped_type&>(static_cast<const CompactHashMap&>(*this).valueOf(key));
+    }
+
+    const_iterator find(const key_type& key) const {
+        std::size_t found = indexOf(key, hashOf(key));
+        return ConstIterator(this, found == NOT_FOUND ? items.size() : found);
+    }
+
+    iterator find(const key_type& key) {
+        return static_cast<const CompactHashMap&>(*this).find(key);
+    }
+
+    void remove(const key_type& key) {
+        std::size_t hash = hashOf(key);
+        std::size_t slot = slotOf(key, hash);
+        if (slot == NOT_FOUND) throw std::out_of_range("delete unexisting item");
+        if (size == 1) {
+            clear();
+            return;
+        }
+        std::size_t index = indexAt(slot);
+        setIndex(slot, dummy());
+        hashes[index] = REMOVED;
+        items[index].second = mapped_type(); // the key waits for compaction
+        --size;
+    }
+
+    void remove(const const_iterator& it) {
+        if (it == cend()) throw std::out_of_range("delete unexisting item");
+        remove(it->first);
+    }
+
+    size_type getSize() const {
+        return size;
+    }
+
+    // Makes room for n items without rebuilding the table.
+    void reserve(std::size_t n) {
+        if (n > usable) rebuild(n);
+    }
+
+    bool operator==(const CompactHashMap& other) const {
+        if (size != other.size) return false;
+        for (const auto& item : *this) {
+            std::size_t found = other.indexOf(item.first, hashOf(item.first));
+            if (found == NOT_FOUND || other.items[found].second != item.second)
+                return false;
+        }
+        return true;
+    }
+
+    bool operator!=(const CompactHashMap& other) const {
+        return !(*this == other);
+    }
+
+    // Keeps the storage for reuse.
+    void clear() {
+        items.clear();
+        hashes.clear();
+        std::memset(table.data(), 0xFF, table.size()); // all empty
+        usable = table.empty() ? 0 : usableFor(mask + 1);
+        size = 0;
+    }
+
+    iterator begin() {
+        return cbegin();
+    }
+
+    iterator end() {
+        return cend();
+    }
+
+    const_iterator cbegin() const {
+        return ConstIterator(this, nextLive(0));
+    }
+
+    const_iterator cend() const {
+        return ConstIterator(this, items.size());
+    }
+
+    const_iterator begin() const {
+        return cbegin();
+    }
+
+    const_iterator end() const {
+        return cend();
+    }
+
+private:
+    static std::size_t hashOf(const key_type& key) {
+        return std::hash<KeyType>()(key) & (REMOVED >> 1);
+    }
+
+    // at most 2/3 of the slots are ever taken, so probes always reach an empty one
+    static std::size_t usableFor(std::size_t slots) {
+        return slots * 2 / 3;
+    }
+
+    // index values of free slots: empty and once taken (a tombstone)
+    std::size_t empty() const {
+        return indexBytes == sizeof(std::uint64_t) ? ~std::uint64_t(0) : (std::uint64_t(1) << 8 * indexBytes) - 1;
+    }
+
+    std::size_t dummy() const {
+        return empty() - 1;
+    }
+
+    std::size_t indexAt(std::size_t slot) const {
+        const unsigned char *at = table.data() + slot * indexBytes;
+        switch (indexBytes) {
+        case 1: return *at;
+        case 2: { std::uint16_t index; std::memcpy(&index, at, 2); return index; }
+        case 4: { std::uint32_t index; std::memcpy(&index, at, 4); return index; }
+        default: { std::uint64_t index; std::memcpy(&index, at, 8); return index; }
+        }
+    }
+
+    void setIndex(std::size_t slot, std::size_t index) {
+        unsigned char *at = table.data() + slot * indexBytes;
+        switch (indexBytes) {
+        case 1: *at = static_cast<unsigned char>(index); break;
+        case 2: { std::uint16_t narrow = static_cast<std::uint16_t>(index); std::memcpy(at, &narrow, 2); break; }
+        case 4: { std::uint32_t narrow = static_cast<std::uint32_t>(index); std::memcpy(at, &narrow, 4); break; }
+        default: { std::uint64_t wide = index; std::memcpy(at, &wide, 8); break; }
+        }
+    }
+
+    // slot holding the key's index, or NOT_FOUND
+    std::size_t slotOf(const key_type& key, std::size_t hash) const {
+        if (table.empty()) return NOT_FOUND;
+        for (std::size_t slot = hash & mask;; slot = (slot + 1) & mask) {
+            std::size_t index = indexAt(slot);
+            if (index == empty()) return NOT_FOUND;
+            if (index != dummy() && hashes[index] == hash && items[index].first == key) return slot;
+        }
+    }
+
+    std::size_t indexOf(const key_type& key, std::size_t hash) const {
+        std::size_t slot = slotOf(key, hash);
+        return slot == NOT_FOUND ? NOT_FOUND : indexAt(slot);
+    }
+
+    std::size_t nextLive(std::size_t index) const {
+        while (index < items.size() && hashes[index] == REMOVED) ++index;
+        return index;
+    }
+
+    // Compacts the items and rebuilds the table with room for twice the
+    // needed items, in the narrowest index width that fits.
+    void rebuild(std::size_t needed) {
+        std::size_t slots = MIN_SLOTS;
+        while (usableFor(slots) < 2 * needed) slots *= 2;
+        unsigned bytes = 1;
+        while (bytes < sizeof(std::uint64_t) && slots >= (std::uint64_t(1) << 8 * bytes) - 2) bytes *= 2;
+
+        if (items.size() != size) {
+            std::vector<value_type> live;
+            std::vector<std::size_t> liveHashes;
+            live.reserve(usableFor(slots));
+            liveHashes.reserve(usableFor(slots));
+            for (std::size_t i = 0; i < items.size(); ++i)
+                if (hashes[i] != REMOVED) {
+                    live.push_back(std::move(items[i]));
+                    liveHashes.push_back(hashes[i]);
+                }
+            items.swap(live);
+            hashes.swap(liveHashes);
+        } else {
+            items.reserve(usableFor(slots));
+            hashes.reserve(usableFor(slots));
+        }
+
+        std::vector<unsigned char>(slots * bytes, 0xFF).swap(table);
+        indexBytes = bytes;
+        mask = slots - 1;
+        usable = usableFor(slots);
+        for (std::size_t i = 0; i < items.size(); ++i) {
+            std::size_t slot = hashes[i] & mask;
+            while (indexAt(slot) != empty()) slot = (slot + 1) & mask;
+            setIndex(slot, i);
+        }
+    }
+};
+
+template<typename KeyType, typename ValueType>
+constexpr std::size_t CompactHashMap<KeyType, ValueType>::REMOVED;
+
+template<typename KeyType, typename ValueType>
+constexpr std::size_t CompactHashMap<KeyType, ValueType>::NOT_FOUND;
+
+template<typename KeyType, typename ValueType>
+constexpr std::size_t CompactHashMap<KeyType, ValueType>::MIN_SLOTS;
+
+template<typename KeyType, typename ValueType>
+class CompactHashMap<KeyType, ValueType>::ConstIterator {
+    friend class CompactHashMap;
+    const CompactHashMap *map;
+    std::size_t index; // items.size() at end
+
+    ConstIterator(const CompactHashMap *m, std::size_t i)
+        : map(m), index(i)
+    { }
+public:
+    using reference = typename CompactHashMap::const_reference;
+    using iterator_category = std::bidirectional_iterator_tag;
+    using value_type = typename CompactHashMap::value_type;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const typename CompactHashMap::value_type*;
+
+    ConstIterator& operator++() {
+        if (index == map->items.size()) throw std::out_of_range("increment of end()");
+        index = map->nextLive(index + 1);
+        return *this;
+    }
+
+    ConstIterator operator++(int) {
+        ConstIterator result(*this);
+        operator++();
+        return result;
+    }
+
+    ConstIterator& operator--() {
+        std::size_t previous = index;
+        do {
+            if (!previous) throw std::out_of_range("decrement of begin()");
+            --previous;
+        } while (map->hashes[previous] == REMOVED);
+        index = previous;
+        return *this;
+    }
+
+    ConstIterator operator--(int) {
+        ConstIterator result(*this);
+        operator--();
+        return result;
+    }
+
+    reference operator*() const {
+        if (index == map->items.size()) throw std::out_of_range("dereference of end()");
+        return map->items[index];
+    }
+
+    pointer operator->() const {
+        return &this->operator*();
+    }
+
+    bool operator==(const ConstIterator& other) const {
+        return map == other.map && index == other.index;
+    }
+
+    bool operator!=(const ConstIterator& other) const {
+        return !(*this == other);
+    }
+};
+
+template<typename KeyType, typename ValueType>
+class CompactHashMap<KeyType, ValueType>::Iterator : public CompactHashMap<KeyType, ValueType>::ConstIterator {
+public:
+    using reference = typename CompactHashMap::reference;
+    using pointer = typename CompactHashMap::value_type*;
+
+    Iterator(const ConstIterator& other)
+        : ConstIterator(other)
+    { }
+
+    Iterator& operator++() {
+        ConstIterator::operator++();
+        return *this;
+    }
+
+    Iterator operator++(int) {
+        auto result = *this;
+        ConstIterator::operator++();
+        return result;
+    }
+
+    Iterator& operator--() {
+        ConstIterator::operator--();
+        return *this;
+    }
+
+    Iterator operator--(int) {
+        auto result = *this;
+        ConstIterator::operator--();
+        return result;
+    }
+
+    pointer operator->() const {
+        return &this->operator*();
+    }
+
+    reference operator*() const {
+        // ugly cast, yet reduces code duplication.
+        return const_cast<reference>(ConstIterator::operator*());
+    }
+};
+
+}
+
+#endif /* AISDI_MAPS_COMPACTHASHMAP_H */
@@ -0,0 +1,503 @@
+#ifndef AISDI_MAPS_COMPACTTREEMAP_H
+#define AISDI_MAPS_COMPACTTREEMAP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "bst.h"
+
+namespace aisdi {
+
+// TreeMap for many small items: nodes live in an arena and link to each
+// other through 32-bit indices, with no parent links - with int keys and
+// values a node takes 16 bytes, where a BST node takes 32 plus the
+// allocator's overhead. Iterators keep their path from the root instead.
+//
+// The arena grows by chunks, each twice as large as the one before, so items
+// never move: references stay valid until the item is removed. Freed nodes
+// are reused. Holds fewer than 2^32 - 1 items.
+template<typename KeyType, typename ValueType, typename Compare = std::less<KeyType>>
+class CompactTreeMap : private CompareHolder<Compare> {
+public:
+    using key_type = KeyType;
+    using mapped_type = ValueType;
+    using key_compare = Compare;
+    using value_type = std::pair<const key_type, mapped_type>;
+    using size_type = std::size_t;
+    using reference = value_type&;
+    using const_reference = const value_type&;
+
+    class ConstIterator;
+
+    class Iterator;
+
+    using iterator = Iterator;
+    using const_iterator = ConstIterator;
+
+private:
+    using Index = std::uint32_t;
+    static constexpr Index NIL = ~Index(0);
+    static constexpr Index FREE = NIL - 1; // in right of a freed node
+    static constexpr unsigned FIRST_CHUNK_BITS = 4;
+
+    struct Node {
+        typename std::aligned_storage<sizeof(value_type), alignof(value_type)>::type storage;
+        Index left, right;
+
+        value_type& value() {
+            return *reinterpret_cast<value_type*>(&storage);
+        }
+    };
+
+    std::vector<std::unique_ptr<Node[]>> chunks;
+    Index root = NIL;
+    Index used = 0;      // nodes ever handed out, live or freed
+    Index freed = NIL;   // list of freed nodes, through left
+    std::size_t size = 0;
+
+public:
+    static constexpr std::size_t NODE_BYTES = sizeof(Node);
+
+    CompactTreeMap()
+        : CompareHolder<Compare>(Compare())
+    { }
+
+    explicit CompactTreeMap(const Compare& comp)
+        : CompareHolder<Compare>(comp)
+    { }
+
+    CompactTreeMap(std::initializer_list<value_type> list, const Compare& comp = Compare())
+        : CompareHolder<Compare>(comp)
+    {
+        for (auto&& pair : list)
+            (*this)[std::move(pair.first)] = std::move(pair.second);
+    }
+
+    // Copies the arena node by node, so the copy has the same shape.
+    CompactTreeMap(const CompactTreeMap& other)
+        : CompareHolder<Compare>(other.keyComp())
+    {
+        chunks.reserve(other.chunks.size());
+        for (std::size_t chunk = 0; chunk < other.chunks.size(); ++chunk)
+            chunks.emplace_back(new Node[chunkSize(chunk)]);
+        try {
+            for (; used < other.used; ++used) {
+                Node& source = other.at(used);
+                Node& copy = at(used);
+                copy.left = source.left;
+                copy.right = source.right;
+                if (source.right != FREE) ::new (&copy.storage) value_type(source.value());
+            }
+        } catch (...) {
+            destroyAll();
+            throw;
+        }
+        root = other.root;
+        freed = other.freed;
+        size = other.size;
+    }
+
+    CompactTreeMap(CompactTreeMap&& other) noexcept(std::is_nothrow_copy_constructible<Compare>::value)
+        : CompareHolder<Compare>(other.keyComp())
+    {
+        steal(other);
+    }
+
+    ~CompactTreeMap() {
+        destroyAll();
+    }
+
+    CompactTreeMap& operator=(const CompactTreeMap& other) {
+        if (this == &other) return *this;
+        CompactTreeMap copy(other);
+        return *this = std::move(copy);
+    }
+
+    CompactTreeMap& operator=(CompactTreeMap&& other) noexcept(std::is_nothrow_copy_assignable<Compare>::value) {
+        if (this == &other) return *this;
+        destroyAll();
+        static_cast<CompareHolder<Compare>&>(*this) = other;
+        steal(other);
+        return *this;
+    }
+
+    bool isEmpty() const {
+        return !size;
+    }
+
+    template <typename Kk>
+    mapped_type& operator[](Kk&& key) {
+        // converted once, so that e.g. a const char* isn't turned into a string per node
+        const KeyType& searched = key;
+        Index *hook = &root;
+        while (*hook != NIL) {
+            Node& node = at(*hook);
+            int cmp = compareKeys(searched, node.value().first);
+            if (!cmp) return node.value().second;
+            hook = cmp < 0 ? &node.left : &node.right;
+        }
+        // chunks don't move, so hook survives the allocation
+        Index added = allocate(std::forward<Kk>(key), mapped_type());
+        *hook = added;
+        ++size;
+        return at(added).value().second;
+    }
+
+    const mapped_type& valueOf(const key_type& key) const {
+        Index index = findIndex(key);
+        if (index == NIL) throw std::out_of_range("item doesn't exist");
+        return at(index).value().second;
+    }
+
+    mapped_type& valueOf(const key_type& key) {
+        return const_cast<mapped_type&>(static_cast<const CompactTreeMap&>(*this).valueOf(key));
+    }
+
+    const_iterator find(const key_type& key) const {
+        ConstIterator it(this);
+        Index index = root;
+        while (index != NIL) {
+            it.path.push_back(index);
+            Node& node = at(index);
+            int cmp = compareKeys(key, node.value().first);
+            if (!cmp) return it;
+            index = cmp < 0 ? node.left : node.right;
+        }
+        return cend();
+    }
+
+    iterator find(const key_type& key) {
+        return static_cast<const CompactTreeMap&>(*this).find(key);
+    }
+
+    void remove(const key_type& key) {
+        Index *hook = &root;
+        while (*hook != NIL) {
+            int cmp = compareKeys(key, at(*hook).value().first);
+            if (!cmp) break;
+            hook = cmp < 0 ? &at(*hook).left : &at(*hook).right;
+        }
+        if (*hook == NIL) throw std::out_of_range("delete unexisting item");
+
+        Index removed = *hook;
+        Node& node = at(removed);
+        if (node.left == NIL) {
+            *hook = node.right;
+        } else if (node.right == NIL) {
+            *hook = node.left;
+        } else {
+            // successor takes the node's place
+            Index *successorHook = &node.right;
+            while (at(*successorHook).left != NIL) successorHook = &at(*successorHook).left;
+            Index successor = *successorHook;
+            *successorHook = at(successor).right;
+            at(successor).left = node.left;
+            at(successor).right = node.right;
+            *hook = successor;
+        }
+        release(removed);
+        --size;
+    }
+
+    void remove(const const_iterator& it) {
+        if (it == cend()) throw std::out_of_range("delete unexisting item");
+        remove(it->first);
+    }
+
+    size_type getSize() const {
+        return size;
+    }
+
+    bool operator==(const CompactTreeMap& other) const {
+        if (size != other.size) return false;
+        for (auto it = begin(), otherIt = other.begin(); it != end(); ++it, ++otherIt)
+            if (*it != *otherIt) return false;
+        return true;
+    }
+
+    bool operator!=(const CompactTreeMap& other) const {
+        return !(*this == other);
+    }
+
+    void clear() {
+        destroyAll();
+        chunks.clear();
+        root = NIL;
+        used = 0;
+        freed = NIL;
+        size = 0;
+    }
+
+    const Compare& keyComp() const {
+        return CompareHolder<Compare>::getComparator();
+    }
+
+    iterator begin() {
+        return cbegin();
+    }
+
+    iterator end() {
+        return cend();
+    }
+
+    const_iterator cbegin() const {
+        ConstIterator it(this);
+        if (root != NIL) it.descend(root, &Node::left);
+        return it;
+    }
+
+    const_iterator cend() const {
+        return ConstIterator(this);
+    }
+
+    const_iterator begin() const {
+        return cbegin();
+    }
+
+    const_iterator end() const {
+        return cend();
+    }
+
+private:
+    static std::size_t chunkSize(std::size_t chunk) {
+        return std::size_t(1) << (chunk + FIRST_CHUNK_BITS);
+    }
+
+    static unsigned highestBit(std::uint64_t x) {
+#if defined(__GNUC__) || defined(__clang__)
+        return 63 - __builtin_clzll(x);
+#else
+        unsigned bit = 0;
+        while (x >>= 1) ++bit;
+        return bit;
+#endif
+    }
+
+    // Chunk c holds 2^(c + FIRST_CHUNK_BITS) nodes, starting at index
+    // 2^FIRST_CHUNK_BITS * (2^c - 1).
+    Node& at(Index index) const {
+        std::uint64_t shifted = std::uint64_t(index) + (std::uint64_t(1) << FIRST_CHUNK_BITS);
+        unsigned chunk = highestBit(shifted) - FIRST_CHUNK_BITS;
+        return chunks[chunk][shifted - chunkSize(chunk)];
+    }
+
+    int compareKeys(const KeyType& a, const KeyType& b) const {
+        return ThreeWayCompare<KeyType, Compare>::compare(keyComp(), a, b);
+    }
+
+    Index findIndex(const key_type& key) const {
+        Index index = root;
+        while (index != NIL) {
+            Node& node = at(index);
+            int cmp = compareKeys(key, node.value().first);
+            if (!cmp) return index;
+            index = cmp < 0 ? node.left : node.right;
+        }
+        return NIL;
+    }
+
+    template <typename... Args>
+    Index allocate(Args&&... args) {
+        Index index = freed;
+        if (index == NIL) {
+            if (used == FREE) throw std::length_error("CompactTreeMap is full");
+            index = used;
+            std::uint64_t capacity = (std::uint64_t(1) << FIRST_CHUNK_BITS) * ((std::uint64_t(1) << chunks.size()) - 1);
+            if (index == capacity) {
+                std::unique_ptr<Node[]> chunk(new Node[chunkSize(chunks.size())]);
+                chunks.push_back(std::move(chunk));
+            }
+        }
+        Node& node = at(index);
+        ::new (&node.storage) value_type(std::forward<Args>(args)...);
+        if (index == freed) freed = node.left;
+        else ++used;
+        node.left = node.right = NIL;
+        return index;
+    }
+
+    void release(Index index) {
+        Node& node = at(index);
+        node.value().~value_type();
+        node.left = freed;
+        node.right = FREE;
+        freed = index;
+    }
+
+    // destroys the items, keeping the arena
+    void destroyAll() {
+        if (!std::is_trivially_destructible<value_type>::value)
+            for (Index index = 0; index < used; ++index)
+                if (at(index).right != FREE) at(index).value().~value_type();
+    }
+
+    void steal(CompactTreeMap& other) {
+        chunks = std::move(other.chunks);
+        root = other.root;
+        used = other.used;
+        freed = other.freed;
+        size = other.size;
+        other.chunks.clear();
+        other.root = NIL;
+        other.used = 0;
+        other.freed = NIL;
+        other.size = 0;
+    }
+};
+
+template<typename KeyType, typename ValueType, typename Compare>
+constexpr std::size_t CompactTreeMap<KeyType, ValueType, Compare>::NODE_BYTES;
+
+template<typename KeyType, typename ValueType, typename Compare>
+constexpr typename CompactTreeMap<KeyType, ValueType, Compare>::Index CompactTreeMap<KeyType, ValueType, Compare>::NIL;
+
+template<typename KeyType, typename ValueType, typename Compare>
+constexpr typename CompactTreeMap<KeyType, ValueType, Compare>::Index CompactTreeMap<KeyType, ValueType, Compare>::FREE;
+
+// Keeps the path from the root to its node; empty at end.
+template<typename KeyType, typename ValueType, typename Compare>
+class CompactTreeMap<KeyType, ValueType, Compare>::ConstIterator {
+    friend class CompactTreeMap;
+    const CompactTreeMap *map;
+    std::vector<Index> path;
+
+    explicit ConstIterator(const CompactTreeMap *m)
+        : map(m)
+    { }
+
+    // pushes index and its descendants down the link (left or right) side
+    void descend(Index index, Index Node::*link) {
+        while (index != NIL) {
+            path.push_back(index);
+            index = map->at(index).*link;
+        }
+    }
+public:
+    using reference = typename CompactTreeMap::const_reference;
+    using iterator_category = std::bidirectional_iterator_tag;
+    using value_type = typename CompactTreeMap::value_type;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const typename CompactTreeMap::value_type*;
+
+    ConstIterator& operator++() {
+        if (path.empty()) throw std::out_of_range("increment of end()");
+        Index right = map->at(path.back()).right;
+        if (right != NIL) {
+            descend(right, &Node::left);
+            return *this;
+        }
+        // up to the first ancestor reached from its left
+        Index child = path.back();
+        path.pop_back();
+        while (!path.empty() && map->at(path.back()).right == child) {
+            child = path.back();
+            path.pop_back();
+        }
+        return *this;
+    }
+
+    ConstIterator operator++(int) {
+        ConstIterator result(*this);
+        operator++();
+        return result;
+    }
+
+    ConstIterator& operator--() {
+        if (path.empty()) {
+            if (map->root == NIL) throw std::out_of_range("decrement of begin()");
+            descend(map->root, &Node::right);
+            return *this;
+        }
+        Index left = map->at(path.back()).left;
+        if (left != NIL) {
+            descend(left, &Node::right);
+            return *this;
+        }
+        // up to the first ancestor reached from its right, if any
+        for (std::size_t i = path.size() - 1; i > 0; --i)
+            if (map->at(path[i - 1]).right == path[i]) {
+                path.resize(i);
+                return *this;
+            }
+        throw std::out_of_range("decrement of begin()");
+    }
+
+    ConstIterator operator--(int) {
+        ConstIterator result(*this);
+        operator--();
+        return result;
+    }
+
+    reference operator*() const {
+        if (path.empty()) throw std::out_of_range("dereference of end()");
+        return map->at(path.back()).value();
+    }
+
+    pointer operator->() const {
+        return &this->operator*();
+    }
+
+    bool operator==(const ConstIterator& other) const {
+        return map == other.map && path.empty() == other.path.empty()
+               && (path.empty() || path.back() == other.path.back());
+    }
+
+    bool operator!=(const ConstIterator& other) const {
+        return !(*this == other);
+    }
+};
+
+template<typename KeyType, typename ValueType, typename Compare>
+class CompactTreeMap<KeyType, ValueType, Compare>::Iterator : public CompactTreeMap<KeyType, ValueType, Compare>::ConstIterator {
+public:
+    using reference = typename CompactTreeMap::reference;
+    using pointer = typename CompactTreeMap::value_type*;
+
+    Iterator(const ConstIterator& other)
+        : ConstIterator(other)
+    { }
+
+    Iterator& operator++() {
+        ConstIterator::operator++();
+        return *this;
+    }
+
+    Iterator operator++(int) {
+        auto result = *this;
+        ConstIterator::operator++();
+        return result;
+    }
+
+    Iterator& operator--() {
+        ConstIterator::operator--();
+        return *this;
+    }
+
+    Iterator operator--(int) {
+        auto result = *this;
+        ConstIterator::operator--();
+        return result;
+    }
+
+    pointer operator->() const {
+        return &this->operator*();
+    }
+
+    reference operator*() const {
+        // ugly cast, yet reduces code duplication.
+        return const_cast<reference>(ConstIterator::operator*());
+    }
+};
+
+}
+
+#endif /* AISDI_MAPS_COMPACTTREEMAP_H */
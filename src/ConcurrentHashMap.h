@@ -0,0 +1,254 @@
+#ifndef AISDI_MAPS_CONCURRENTHASHMAP_H
+#define AISDI_MAPS_CONCURRENTHASHMAP_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <new>
+#include <mutex>
+#include <shared_mutex>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "bst.h"
+
+namespace aisdi {
+
+    // Locking policies for ConcurrentHashMap. A policy provides a Lock type with
+    // lock()/unlock() for writers and lock_shared()/unlock_shared() for readers.
+
+    // Readers share a stripe, writers take it exclusively.
+    struct ReaderWriterLocking {
+        using Lock = std::shared_timed_mutex;
+    };
+
+    // Test-and-test-and-set spin lock; readers are exclusive too, which pays off
+    // when critical sections are a few loads long.
+    struct SpinLocking {
+        class Lock {
+            std::atomic<bool> locked{false};
+        public:
+            void lock() {
+                for (;;) {
+                    if (!locked.exchange(true, std::memory_order_acquire))
+                        return;
+                    while (locked.load(std::memory_order_relaxed))
+                        std::this_thread::yield();
+                }
+            }
+
+            void unlock() {
+                locked.store(false, std::memory_order_release);
+            }
+
+            void lock_shared() { lock(); }
+            void unlock_shared() { unlock(); }
+        };
+    };
+
+    // Hash map safe for concurrent use. Buckets are split into independently
+    // locked stripes, each a contiguous range of the table, so operations on
+    // keys from different stripes never contend - they share a cache line of
+    // buckets only at the two ends of a range. References into the map are
+    // never handed out - values are returned by copy or shown to a visitor
+    // while the stripe is locked.
+    template<typename KeyType, typename ValueType, typename LockPolicy = ReaderWriterLocking>
+    class ConcurrentHashMap {
+        using Bucket = BST<KeyType, ValueType>;
+        using Lock = typename LockPolicy::Lock;
+
+        static constexpr std::size_t CACHE_LINE = 64;
+
+        // own cache line per stripe, so that neighbouring locks don't false-share
+        struct alignas(CACHE_LINE) Stripe {
+            mutable Lock lock;
+            std::size_t size = 0;
+        };
+
+        const std::size_t bucketsNumber;
+        std::vector<Bucket> hashTable;
+        // std::allocator honours alignas only from C++17 on, so the stripes
+        // are placed in storage aligned by hand
+        std::size_t stripesCount;
+        std::size_t bucketsPerStripe;
+        std::unique_ptr<unsigned char[]> stripeStorage;
+        Stripe *stripes;
+    public:
+        using key_type = KeyType;
+        using mapped_type = ValueType;
+        using value_type = std::pair<const key_type, mapped_type>;
+        using size_type = std::size_t;
+
+        static constexpr std::size_t DEFAULT_STRIPES = 64;
+        static constexpr std::size_t DEFAULT_BUCKETS = 15693;
+
+        explicit ConcurrentHashMap(std::size_t stripesNumber = DEFAULT_STRIPES,
+                                   std::size_t buckets = DEFAULT_BUCKETS)
+            : bucketsNumber(buckets), hashTable(buckets),
+              stripesCount(stripesNumber < buckets ? stripesNumber : buckets),
+              bucketsPerStripe(stripesCount ? (buckets + stripesCount - 1) / stripesCount : 0)
+        {
+            if (!stripesNumber || !buckets)
+                throw std::invalid_argument("stripes and buckets number must be positive");
+            std::size_t space = stripesCount * sizeof(Stripe) + CACHE_LINE;
+            stripeStorage.reset(new unsigned char[space]);
+            void *aligned = stripeStorage.get();
+            std::align(CACHE_LINE, stripesCount * sizeof(Stripe), aligned, space);
+            stripes = static_cast<Stripe*>(aligned);
+            std::size_t constructed = 0;
+            try {
+                for (; constructed < stripesCount; ++constructed)
+                    new (&stripes[constructed]) Stripe();
+            } catch (...) {
+                while (constructed) stripes[--constructed].~Stripe();
+                throw;
+            }
+        }
+
+        ~ConcurrentHashMap() {
+            for (std::size_t s = 0; s < stripesCount; ++s)
+                stripes[s].~Stripe();
+        }
+
+        ConcurrentHashMap(const ConcurrentHashMap&) = delete;
+        ConcurrentHashMap& operator=(const ConcurrentHashMap&) = delete;
+
+        // Inserts the pair if the key is absent. Returns false if it was present.
+        template <typename Kk, typename Vv>
+        bool insert(Kk&& key, Vv&& value) {
+            std::size_t idx = bucketOf(key);
+            Stripe& stripe = stripeOf(idx);
+            std::lock_guard<Lock> guard(stripe.lock);
+            std::size_t before = hashTable[idx].getSize();
+            hashTable[idx].insert(std::forward<Kk>(key), std::forward<Vv>(value));
+            if (hashTable[idx].getSize() == before)
+                return false;
+            ++stripe.size;
+            return true;
+        }
+
+        // Equivalent of HashMap's map[key] = value.
+        template <typename Kk, typename Vv>
+        void assign(Kk&& key, Vv&& value) {
+            std::size_t idx = bucketOf(key);
+            Stripe& stripe = stripeOf(idx);
+            std::lock_guard<Lock> guard(stripe.lock);
+            std::size_t before = hashTable[idx].getSize();
+            auto node = hashTable[idx].insert(std::forward<Kk>(key));
+            if (hashTable[idx].getSize() != before)
+                ++stripe.size;
+            node->value.second = std::forward<Vv>(value);
+        }
+
+        // Copies the value of key into out. Returns false if key is absent.
+        bool find(const key_type& key, mapped_type& out) const {
+            return visit(key, [&out](const mapped_type& value) { out = value; });
+        }
+
+        // Calls fn(const mapped_type&) with the stripe held for reading.
+        // fn must not call back into the map.
+        template <typename Fn>
+        bool visit(const key_type& key, Fn&& fn) const {
+            std::size_t idx = bucketOf(key);
+            const Stripe& stripe = stripeOf(idx);
+            std::shared_lock<Lock> guard(stripe.lock);
+            auto node = hashTable[idx].findNodeWithKey(key);
+            if (!node) return false;
+            fn(static_cast<const mapped_type&>(node->value.second));
+            return true;
+        }
+
+        mapped_type valueOf(const key_type& key) const {
+            mapped_type result;
+            if (!find(key, result)) throw std::out_of_range("el doesn't exist");
+            return result;
+        }
+
+        bool contains(const key_type& key) const {
+            return visit(key, [](const mapped_type&) { });
+        }
+
+        // Returns false if key was absent.
+        bool remove(const key_type& key) {
+            std::size_t idx = bucketOf(key);
+            Stripe& stripe = stripeOf(idx);
+            std::lock_guard<Lock> guard(stripe.lock);
+            if (!hashTable[idx].deleteKey(key))
+                return false;
+            --stripe.size;
+            return true;
+        }
+
+        // Returns the value of key, inserting factory() first if key is absent.
+        // factory runs at most once per absent key, under the stripe lock.
+        template <typename Kk, typename Fn>
+        mapped_type computeIfAbsent(Kk&& key, Fn&& factory) {
+            std::size_t idx = bucketOf(key);
+            Stripe& stripe = stripeOf(idx);
+            {
+                std::shared_lock<Lock> guard(stripe.lock);
+                auto node = hashTable[idx].findNodeWithKey(key);
+                if (node) return node->value.second;
+            }
+            std::lock_guard<Lock> guard(stripe.lock);
+            auto node = hashTable[idx].findNodeWithKey(key);
+            if (!node) {
+                node = hashTable[idx].insert(std::forward<Kk>(key), factory());
+                ++stripe.size;
+            }
+            return node->value.second;
+        }
+
+        // Exact when no writer runs concurrently, a snapshot-ish sum otherwise.
+        size_type getSize() const {
+            size_type result = 0;
+            for (std::size_t s = 0; s < stripesCount; ++s) {
+                std::shared_lock<Lock> guard(stripes[s].lock);
+                result += stripes[s].size;
+            }
+            return result;
+        }
+
+        bool isEmpty() const {
+            return !getSize();
+        }
+
+        void clear() {
+            for (std::size_t s = 0; s < stripesCount; ++s) {
+                std::lock_guard<Lock> guard(stripes[s].lock);
+                std::size_t end = std::min(bucketsNumber, (s + 1) * bucketsPerStripe);
+                for (std::size_t idx = s * bucketsPerStripe; idx < end; ++idx)
+                    hashTable[idx].clear();
+                stripes[s].size = 0;
+            }
+        }
+
+    private:
+        std::size_t bucketOf(const key_type& key) const {
+            return std::hash<KeyType>()(key) % bucketsNumber;
+        }
+
+        Stripe& stripeOf(std::size_t bucket) {
+            return stripes[bucket / bucketsPerStripe];
+        }
+
+        const Stripe& stripeOf(std::size_t bucket) const {
+            return stripes[bucket / bucketsPerStripe];
+        }
+    };
+
+    template<typename KeyType, typename ValueType, typename LockPolicy>
+    constexpr std::size_t ConcurrentHashMap<KeyType, ValueType, LockPolicy>::CACHE_LINE;
+
+    template<typename KeyType, typename ValueType, typename LockPolicy>
+    constexpr std::size_t ConcurrentHashMap<KeyType, ValueType, LockPolicy>::DEFAULT_STRIPES;
+
+    template<typename KeyType, typename ValueType, typename LockPolicy>
+    constexpr std::size_t ConcurrentHashMap<KeyType, ValueType, LockPolicy>::DEFAULT_BUCKETS;
+
+}
+
+#endif /* AISDI_MAPS_CONCURRENTHASHMAP_H */
@@ -0,0 +1,558 @@
+#ifndef AISDI_MAPS_CUCKOOHASHMAP_H
+#define AISDI_MAPS_CUCKOOHASHMAP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "Prefetch.h"
+
+namespace aisdi {
+
+// HashMap with worst-case O(1) lookups: bucketized cuckoo hashing. An item
+// lives in one of SLOTS slots of one of its two buckets, so a lookup looks at
+// two buckets and nothing else. Buckets are cache line aligned; with items of
+// up to 12 bytes each bucket is one line.
+//
+// The second bucket is the first XOR a hash of the key's 8-bit tag (partial
+// key cuckoo hashing), so an item's other bucket is known from the tag alone,
+// without hashing its key again. The tags are also compared before the keys.
+//
+// An insert into two full buckets moves items to their other buckets along
+// the shortest path found by a breadth-first search, and doubles the table
+// if there's none. Items move on inserts, so inserting invalidates references
+// and iterators; removing invalidates only those of the removed item.
+template<typename KeyType, typename ValueType>
+class CuckooHashMap {
+public:
+    using key_type = KeyType;
+    using mapped_type = ValueType;
+    using value_type = std::pair<const key_type, mapped_type>;
+    using size_type = std::size_t;
+    using reference = value_type&;
+    using const_reference = const value_type&;
+
+    class ConstIterator;
+
+    class Iterator;
+
+    using iterator = Iterator;
+    using const_iterator = ConstIterator;
+
+    static constexpr unsigned SLOTS = 4;
+    static constexpr std::size_t CACHE_LINE = 64;
+    static constexpr std::size_t MIN_BUCKETS = 16;
+    static constexpr unsigned MAX_PATH = 5;         // displacements of one insert
+    static constexpr std::size_t MAX_SEARCHED = 256; // buckets searched for a path
+
+private:
+    struct alignas(CACHE_LINE) Bucket {
+        std::uint8_t tags[SLOTS]; // 0 in free slots
+        typename std::aligned_storage<sizeof(value_type), alignof(value_type)>::type slots[SLOTS];
+
+        value_type& at(unsigned slot) {
+            return *reinterpret_cast<value_type*>(&slots[slot]);
+        }
+
+        const value_type& at(unsigned slot) const {
+            return *reinterpret_cast<const value_type*>(&slots[slot]);
+        }
+    };
+
+    struct Position {
+        std::size_t bucket;
+        unsigned slot;
+    };
+
+    std::unique_ptr<unsigned char[]> storage;
+    Bucket *buckets = nullptr; // storage aligned to CACHE_LINE; null until first insert
+    std::size_t mask = 0;      // buckets number - 1
+    std::size_t size = 0;
+
+public:
+    CuckooHashMap() { }
+
+    CuckooHashMap(std::initializer_list<value_type> list)
+        : CuckooHashMap()
+    {
+        for (auto&& pair : list)
+            (*this)[std::move(pair.first)] = std::move(pair.second);
+    }
+
+    CuckooHashMap(const CuckooHashMap& other)
+        : CuckooHashMap()
+    {
+        if (!other.buckets) return;
+        allocate(other.mask + 1);
+        try {
+            for (std::size_t bucket = 0; bucket <= mask; ++bucket)
+                for (unsigned slot = 0; slot < SLOTS; ++slot)
+                    if (std::uint8_t tag = other.buckets[bucket].tags[slot]) {
+                        new (&buckets[bucket].slots[slot]) value_type(other.buckets[bucket].at(slot));
+                        buckets[bucket].tags[slot] = tag;
+                        ++size;
+                    }
+        } catch (...) {
+            destroyItems();
+            throw;
+        }
+    }
+
+    CuckooHashMap(CuckooHashMap&& other) noexcept
+        : CuckooHashMap()
+    {
+        swap(other);
+    }
+
+    ~CuckooHashMap() {
+        destroyItems();
+    }
+
+    CuckooHashMap& operator=(const CuckooHashMap& other) {
+        if (this == &other) return *this;
+        CuckooHashMap copy(other);
+        swap(copy);
+        return *this;
+    }
+
+    CuckooHashMap& operator=(CuckooHashMap&& other) noexcept {
+        if (this == &other) return *this;
+        CuckooHashMap moved(std::move(other));
+        swap(moved);
+        return *this;
+    }
+
+    void swap(CuckooHashMap& other) noexcept {
+        using std::swap;
+        swap(storage, other.storage);
+        swap(buckets, other.buckets);
+        swap(mask, other.mask);
+        swap(size, other.size);
+    }
+
+    bool isEmpty() const {
+        return !size;
+    }
+
+    template <typename Kk>
+    mapped_type& operator[](Kk&& key) {
+        const KeyType& searched = key;
+        std::size_t hash = hashOf(searched);
+        Position found;
+        if (locate(searched, hash, found)) return buckets[found.bucket].at(found.slot).second;
+        Position placed = place(hash, std::forward<Kk>(key), mapped_type());
+        return buckets[placed.bucket].at(placed.slot).second;
+    }
+
+    const mapped_type& valueOf(const key_type& key) const {
+        Position found;
+        if (!locate(key, hashOf(key), found)) throw std::out_of_range("item doesn't exist");
+        return buckets[found.bucket].at(found.slot).second;
+    }
+
+    mapped_type& valueOf(const key_type& key) {
+        return const_cast<mapped_type&>(static_cast<const CuckooHashMap&>(*this).valueOf(key));
+    }
+
+    const_iterator find(const key_type& key) const {
+        Position found;
+        if (!locate(key, hashOf(key), found)) return cend();
+        return ConstIterator(this, found.bucket, found.slot);
+    }
+
+    iterator find(const key_type& key) {
+        return static_cast<const CuckooHashMap&>(*this).find(key);
+    }
+
+    void remove(const key_type& key) {
+        Position found;
+        if (!locate(key, hashOf(key), found)) throw std::out_of_range("delete unexisting item");
+        Bucket& bucket = buckets[found.bucket];
+        bucket.at(found.slot).~value_type();
+        bucket.tags[found.slot] = 0;
+        --size;
+    }
+
+    void remove(const const_iterator& it) {
+        if (it == cend()) throw std::out_of_range("delete unexisting item");
+        remove(it->first);
+    }
+
+    size_type getSize() const {
+        return size;
+    }
+
+    // Items per slot.
+    double getLoadFactor() const {
+        return buckets ? double(size) / ((mask + 1) * SLOTS) : 0.0;
+    }
+
+    bool operator==(const CuckooHashMap& other) const {
+        if (size != other.size) return false;
+        for (const auto& item : *this) {
+            Position found;
+            if (!other.locate(item.first, hashOf(item.first), found)
+                || other.buckets[found.bucket].at(found.slot).second != item.second)
+                return false;
+        }
+        return true;
+    }
+
+    bool operator!=(const CuckooHashMap& other) const {
+        return !(*this == other);
+    }
+
+    // Keeps the buckets for reuse.
+    void clear() {
+        destroyItems();
+    }
+
+    iterator begin() {
+        return cbegin();
+    }
+
+    iterator end() {
+        return cend();
+    }
+
+    const_iterator cbegin() const {
+        return ConstIterator(this, 0, 0).skipFree();
+    }
+
+    const_iterator cend() const {
+        return ConstIterator(this, bucketsNumber(), 0);
+    }
+
+    const_iterator begin() const {
+        return cbegin();
+    }
+
+    const_iterator end() const {
+        return cend();
+    }
+
+private:
+    // std::hash of integers is the identity, while buckets are picked by the
+    // low bits and tags by the high ones.
+    static std::size_t hashOf(const key_type& key) {
+        std::uint64_t hash = std::hash<KeyType>()(key);
+        hash ^= hash >> 33;
+        hash *= 0xff51afd7ed558ccdull;
+        hash ^= hash >> 33;
+        return static_cast<std::size_t>(hash);
+    }
+
+    static std::uint8_t tagOf(std::size_t hash) {
+        std::uint8_t tag = static_cast<std::uint8_t>(hash >> (8 * sizeof(std::size_t) - 8));
+        return tag ? tag : 1;
+    }
+
+    std::size_t bucketsNumber() const {
+        return buckets ? mask + 1 : 0;
+    }
+
+    // The other bucket of an item with tag in bucket; both ways round.
+    std::size_t alternate(std::size_t bucket, std::uint8_t tag) const {
+        return (bucket ^ (tag * std::size_t(0x5bd1e995))) & mask;
+    }
+
+    bool locate(const key_type& key, std::size_t hash, Position& found) const {
+        if (!buckets) return false;
+        std::uint8_t tag = tagOf(hash);
+        std::size_t first = hash & mask;
+        std::size_t second = alternate(first, tag);
+        AISDI_PREFETCH(&buckets[second]);
+        for (std::size_t bucket : { first, second })
+            for (unsigned slot = 0; slot < SLOTS; ++slot)
+                if (buckets[bucket].tags[slot] == tag && buckets[bucket].at(slot).first == key) {
+                    found = Position{ bucket, slot };
+                    return true;
+                }
+        return false;
+    }
+
+    bool freeSlot(std::size_t bucket, unsigned& slot) const {
+        for (slot = 0; slot < SLOTS; ++slot)
+            if (!buckets[bucket].tags[slot]) return true;
+        return false;
+    }
+
+    // Constructs a new item from args in a free slot of one of the hash's
+    // buckets, making room if needed.
+    template<typename... Args>
+    Position place(std::size_t hash, Args&&... args) {
+        if (!buckets) allocate(MIN_BUCKETS);
+        std::uint8_t tag = tagOf(hash);
+        Position free;
+        while (!makeRoom(hash & mask, alternate(hash & mask, tag), free))
+            rehash(2 * (mask + 1));
+        new (&buckets[free.bucket].slots[free.slot]) value_type(std::forward<Args>(args)...);
+        buckets[free.bucket].tags[free.slot] = tag;
+        ++size;
+        return free;
+    }
+
+    // Finds a free slot in first or second, moving items to their other
+    // buckets along a path found by a breadth-first search of at most
+    // MAX_SEARCHED buckets, and of at most MAX_PATH moves.
+    bool makeRoom(std::size_t first, std::size_t second, Position& free) {
+        for (std::size_t bucket : { first, second })
+            if (freeSlot(bucket, free.slot)) {
+                free.bucket = bucket;
+                return true;
+            }
+
+        struct Step {
+            std::size_t bucket;
+            std::size_t parent; // step whose item moves into bucket; none at depth 0
+            unsigned parentSlot;
+            unsigned depth;
+        };
+        std::vector<Step> steps;
+        steps.reserve(MAX_SEARCHED);
+        steps.push_back(Step{ first, 0, 0, 0 });
+        steps.push_back(Step{ second, 0, 0, 0 });
+
+        for (std::size_t current = 0; current < steps.size(); ++current) {
+            const Step step = steps[current];
+            for (unsigned from = 0; from < SLOTS; ++from) {
+                std::size_t next = alternate(step.bucket, buckets[step.bucket].tags[from]);
+                unsigned to;
+                if (freeSlot(next, to))
+                    return displace(steps, current, from, Position{ next, to }, free);
+                if (step.depth + 1 < MAX_PATH && steps.size() < MAX_SEARCHED)
+                    steps.push_back(Step{ next, current, from, step.depth + 1 });
+            }
+        }
+        return false;
+    }
+
+    // Moves the item in slot from of the last step to the free slot, then the
+    // item of each step before into the slot just left. The slot left by the
+    // first step is the new free one.
+    template<typename Steps>
+    bool displace(const Steps& steps, std::size_t last, unsigned from, Position to, Position& free) {
+        std::vector<Position> path;
+        for (std::size_t step = last;; step = steps[step].parent) {
+            path.push_back(Position{ steps[step].bucket, from });
+            if (steps[step].depth == 0) break;
+            from = steps[step].parentSlot;
+        }
+        // a path through one slot twice would move the wrong item
+        for (std::size_t i = 0; i < path.size(); ++i)
+            for (std::size_t j = i + 1; j < path.size(); ++j)
+                if (path[i].bucket == path[j].bucket && path[i].slot == path[j].slot) return false;
+
+        for (const Position& source : path) {
+            move(source, to);
+            to = source;
+        }
+        free = to;
+        return true;
+    }
+
+    void move(Position from, Position to) {
+        Bucket& source = buckets[from.bucket];
+        new (&buckets[to.bucket].slots[to.slot]) value_type(std::move_if_noexcept(source.at(from.slot)));
+        buckets[to.bucket].tags[to.slot] = source.tags[from.slot];
+        source.at(from.slot).~value_type();
+        source.tags[from.slot] = 0;
+    }
+
+    void allocate(std::size_t number) {
+        std::unique_ptr<unsigned char[]> raw(new unsigned char[number * sizeof(Bucket) + CACHE_LINE]);
+        void *aligned = raw.get();
+        std::size_t space = number * sizeof(Bucket) + CACHE_LINE;
+        std::align(CACHE_LINE, number * sizeof(Bucket), aligned, space);
+        Bucket *allocated = static_cast<Bucket*>(aligned);
+        for (std::size_t bucket = 0; bucket < number; ++bucket)
+            for (unsigned slot = 0; slot < SLOTS; ++slot)
+                allocated[bucket].tags[slot] = 0;
+        storage = std::move(raw);
+        buckets = allocated;
+        mask = number - 1;
+    }
+
+    // Moves the items to a table of number buckets; it grows further if they
+    // don't fit there.
+    void rehash(std::size_t number) {
+        CuckooHashMap bigger;
+        bigger.allocate(number);
+        for (std::size_t bucket = 0; bucket <= mask; ++bucket)
+            for (unsigned slot = 0; slot < SLOTS; ++slot)
+                if (buckets[bucket].tags[slot]) {
+                    value_type& item = buckets[bucket].at(slot);
+                    bigger.place(hashOf(item.first), std::move_if_noexcept(item));
+                }
+        swap(bigger);
+    }
+
+    void destroyItems() {
+        if (buckets)
+            for (std::size_t bucket = 0; bucket <= mask; ++bucket)
+                for (unsigned slot = 0; slot < SLOTS; ++slot)
+                    if (buckets[bucket].tags[slot]) {
+                        buckets[bucket].at(slot).~value_type();
+                        buckets[bucket].tags[slot] = 0;
+                    }
+        size = 0;
+    }
+};
+
+template<typename KeyType, typename ValueType>
+constexpr unsigned CuckooHashMap<KeyType, ValueType>::SLOTS;
+
+template<typename KeyType, typename ValueType>
+constexpr std::size_t CuckooHashMap<KeyType, ValueType>::CACHE_LINE;
+
+template<typename KeyType, typename ValueType>
+constexpr std::size_t CuckooHashMap<KeyType, ValueType>::MIN_BUCKETS;
+
+template<typename KeyType, typename ValueType>
+constexpr unsigned CuckooHashMap<KeyType, ValueType>::MAX_PATH;
+
+template<typename KeyType, typename ValueType>
+constexpr std::size_t CuckooHashMap<KeyType, ValueType>::MAX_SEARCHED;
+
+template<typename KeyType, typename ValueType>
+class CuckooHashMap<KeyType, ValueType>::ConstIterator {
+    friend class CuckooHashMap;
+    const CuckooHashMap *map;
+    std::size_t bucket; // buckets number at end
+    unsigned slot;
+
+    ConstIterator(const CuckooHashMap *m, std::size_t b, unsigned s)
+        : map(m), bucket(b), slot(s)
+    { }
+
+    bool isEnd() const {
+        return bucket == map->bucketsNumber();
+    }
+
+    bool isFree() const {
+        return !map->buckets[bucket].tags[slot];
+    }
+
+    ConstIterator& skipFree() {
+        while (!isEnd() && isFree())
+            if (++slot == SLOTS) {
+                slot = 0;
+                ++bucket;
+            }
+        return *this;
+    }
+public:
+    using reference = typename CuckooHashMap::const_reference;
+    using iterator_category = std::bidirectional_iterator_tag;
+    using value_type = typename CuckooHashMap::value_type;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const typename CuckooHashMap::value_type*;
+
+    ConstIterator& operator++() {
+        if (isEnd()) throw std::out_of_range("increment of end()");
+        if (++slot == SLOTS) {
+            slot = 0;
+            ++bucket;
+        }
+        return skipFree();
+    }
+
+    ConstIterator operator++(int) {
+        ConstIterator result(*this);
+        operator++();
+        return result;
+    }
+
+    ConstIterator& operator--() {
+        std::size_t previousBucket = bucket;
+        unsigned previousSlot = slot;
+        do {
+            if (!previousSlot) {
+                if (!previousBucket) throw std::out_of_range("decrement of begin()");
+                --previousBucket;
+                previousSlot = SLOTS;
+            }
+            --previousSlot;
+        } while (!map->buckets[previousBucket].tags[previousSlot]);
+        bucket = previousBucket;
+        slot = previousSlot;
+        return *this;
+    }
+
+    ConstIterator operator--(int) {
+        ConstIterator result(*this);
+        operator--();
+        return result;
+    }
+
+    reference operator*() const {
+        if (isEnd()) throw std::out_of_range("dereference of end()");
+        return map->buckets[bucket].at(slot);
+    }
+
+    pointer operator->() const {
+        return &this->operator*();
+    }
+
+    bool operator==(const ConstIterator& other) const {
+        return map == other.map && bucket == other.bucket && slot == other.slot;
+    }
+
+    bool operator!=(const ConstIterator& other) const {
+        return !(*this == other);
+    }
+};
+
+template<typename KeyType, typename ValueType>
+class CuckooHashMap<KeyType, ValueType>::Iterator : public CuckooHashMap<KeyType, ValueType>::ConstIterator {
+public:
+    using reference = typename CuckooHashMap::reference;
+    using pointer = typename CuckooHashMap::value_type*;
+
+    Iterator(const ConstIterator& other)
+        : ConstIterator(other)
+    { }
+
+    Iterator& operator++() {
+        ConstIterator::operator++();
+        return *this;
+    }
+
+    Iterator operator++(int) {
+        auto result = *this;
+        ConstIterator::operator++();
+        return result;
+    }
+
+    Iterator& operator--() {
+        ConstIterator::operator--();
+        return *this;
+    }
+
+    Iterator operator--(int) {
+        auto result = *this;
+        ConstIterator::operator--();
+        return result;
+    }
+
+    pointer operator->() const {
+        return &this->operator*();
+    }
+
+    reference operator*() const {
+        // ugly cast, yet reduces code duplication.
+        return const_cast<reference>(ConstIterator::operator*());
+    }
+};
+
+}
+
+#endif /* AISDI_MAPS_CUCKOOHASHMAP_H */
@@ -0,0 +1,218 @@
+#ifndef AISDI_MAPS_EPOCHRECLAMATION_H
+#define AISDI_MAPS_EPOCHRECLAMATION_H
+
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <vector>
+
+namespace aisdi {
+
+    // Epoch-based memory reclamation shared by the lock-free containers.
+    //
+    // A reader pins the current global epoch for as long as it may hold raw
+    // pointers into a container. A writer that unlinks a node retires it instead
+    // of deleting it; a node retired in epoch e is freed once the global epoch
+    // reaches e + 2, which can only happen after every thread pinned at e or
+    // earlier has unpinned.
+    //
+    // Pinning writes only to the calling thread's own record (a separate cache
+    // line), so readers never write to memory shared with other threads.
+    class EpochDomain {
+        static constexpr std::uint64_t INACTIVE = std::numeric_limits<std::uint64_t>::max();
+        static constexpr std::size_t COLLECT_THRESHOLD = 64;
+
+        struct Retired {
+            void *pointer;
+            void (*deleter)(void*);
+            std::uint64_t epoch;
+        };
+
+        struct ThreadRecord {
+            char paddingBefore[64];
+            std::atomic<std::uint64_t> epoch{INACTIVE};
+            std::atomic<bool> inUse{true};
+            ThreadRecord *next = nullptr;
+            // owner-only state below
+            unsigned nesting = 0;
+            std::vector<Retired> retired;
+            char paddingAfter[64];
+        };
+
+        // Returns the calling thread's record to the domain when the thread exits.
+        class RecordOwner {
+        public:
+            EpochDomain *domain = nullptr;
+            ThreadRecord *record = nullptr;
+
+            ~RecordOwner() {
+                if (record) domain->release(record);
+            }
+        };
+
+        std::atomic<std::uint64_t> globalEpoch{0};
+        std::atomic<ThreadRecord*> records{nullptr};
+        std::mutex orphansLock;
+        std::vector<Retired> orphans;
+
+    public:
+        // Keeps the calling thread pinned while alive. Guards nest.
+        class Guard {
+            EpochDomain *domain;
+        public:
+            explicit Guard(EpochDomain& d) : domain(&d) { domain->pin(); }
+            Guard(const Guard& other) : domain(other.domain) { domain->pin(); }
+            Guard& operator=(const Guard& other) {
+                other.domain->pin();
+                domain->unpin();
+                domain = other.domain;
+                return *this;
+            }
+            ~Guard() { domain->unpin(); }
+        };
+
+        EpochDomain(const EpochDomain&) = delete;
+        EpochDomain& operator=(const EpochDomain&) = delete;
+
+        ~EpochDomain() {
+            // no thread may be pinned any more
+            for (ThreadRecord *r = records.load(); r;) {
+                ThreadRecord *next = r->next;
+                freeAll(r->retired);
+                delete r;
+                r = next;
+            }
+            freeAll(orphans);
+        }
+
+        static EpochDomain& global() {
+            static EpochDomain domain;
+            return domain;
+        }
+
+        Guard pinGuard() {
+            return Guard(*this);
+        }
+
+        void pin() {
+            ThreadRecord *record = localRecord();
+            if (record->nesting++) return;
+            // acquire: the unlinks of nodes retired before the epoch began are
+            // seen, see retire()
+            std::uint64_t epoch = globalEpoch.load(std::memory_order_acquire);
+            // a seq_cst read-modify-write rather than a store and a fence,
+            // which ThreadSanitizer doesn't model: the loads of the
+            // structure can't move above the announcement
+            record->epoch.exchange(epoch, std::memory_order_seq_cst);
+        }
+
+        void unpin() {
+            ThreadRecord *record = localRecord();
+            if (--record->nesting) return;
+            record->epoch.store(INACTIVE, std::memory_order_release);
+        }
+
+        // p must already be unreachable for threads that pin from now on, and
+        // the caller pinned since before it unlinked p.
+        //
+        // The stamp is read with a read-modify-write, so it is the latest
+        // epoch: a later one is written by tryAdvance() reading this one,
+        // after the unlink, and threads pinning in it see the unlink. And the
+        // caller being pinned keeps the epoch from passing stamp + 1 until it
+        // unpins, after the unlink too.
+        void retire(void *p, void (*deleter)(void*)) {
+            ThreadRecord *record = localRecord();
+            std::uint64_t epoch = globalEpoch.fetch_add(0, std::memory_order_acq_rel);
+            record->retired.push_back({p, deleter, epoch});
+            if (record->retired.size() >= COLLECT_THRESHOLD)
+                collect();
+        }
+
+        template <typename T>
+        void retire(T *p) {
+            retire(p, [](void *q) { delete static_cast<T*>(q); });
+        }
+
+        // Frees whatever the calling thread retired that is already safe to free.
+        void collect() {
+            collect(localRecord()->retired);
+            std::lock_guard<std::mutex> guard(orphansLock);
+            collect(orphans);
+        }
+
+    private:
+        // single process-wide domain - the per-thread record is a thread_local
+        EpochDomain() = default;
+
+        ThreadRecord* localRecord() {
+            static thread_local RecordOwner owner;
+            if (!owner.record) {
+                owner.domain = this;
+                owner.record = acquire();
+            }
+            return owner.record;
+        }
+
+        ThreadRecord* acquire() {
+            for (ThreadRecord *r = records.load(std::memory_order_acquire); r; r = r->next) {
+                bool expected = false;
+                if (!r->inUse.load(std::memory_order_relaxed)
+                    && r->inUse.compare_exchange_strong(expected, true, std::memory_order_acquire))
+                    return r;
+            }
+            ThreadRecord *record = new ThreadRecord;
+            record->next = records.load(std::memory_order_relaxed);
+            while (!records.compare_exchange_weak(record->next, record,
+                                                  std::memory_order_release, std::memory_order_relaxed)) { }
+            return record;
+        }
+
+        void release(ThreadRecord *record) {
+            collect(record->retired);
+            if (!record->retired.empty()) {
+                std::lock_guard<std::mutex> guard(orphansLock);
+                orphans.insert(orphans.end(), record->retired.begin(), record->retired.end());
+                record->retired.clear();
+            }
+            record->nesting = 0;
+            record->epoch.store(INACTIVE, std::memory_order_release);
+            record->inUse.store(false, std::memory_order_release);
+        }
+
+        void collect(std::vector<Retired>& retired) {
+            tryAdvance();
+            std::uint64_t epoch = globalEpoch.load(std::memory_order_acquire);
+            std::size_t kept = 0;
+            for (std::size_t i = 0; i < retired.size(); ++i) {
+                if (retired[i].epoch + 2 <= epoch)
+                    retired[i].deleter(retired[i].pointer);
+                else
+                    retired[kept++] = retired[i];
+            }
+            retired.resize(kept);
+        }
+
+        // Moves the global epoch forward if every pinned thread has seen it.
+        void tryAdvance() {
+            // pairs with the exchange in pin(), as a read-modify-write for
+            // the same reason
+            std::uint64_t epoch = globalEpoch.fetch_add(0, std::memory_order_seq_cst);
+            for (ThreadRecord *r = records.load(std::memory_order_acquire); r; r = r->next) {
+                std::uint64_t pinned = r->epoch.load(std::memory_order_seq_cst);
+                if (pinned != INACTIVE && pinned != epoch)
+                    return;
+            }
+            globalEpoch.compare_exchange_strong(epoch, epoch + 1, std::memory_order_acq_rel);
+        }
+
+        static void freeAll(std::vector<Retired>& retired) {
+            for (auto& r : retired)
+                r.deleter(r.pointer);
+            retired.clear();
+        }
+    };
+
+}
+
+#endif /* AISDI_MAPS_EPOCHRECLAMATION_H */
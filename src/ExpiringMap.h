@@ -0,0 +1,230 @@
+#ifndef AISDI_MAPS_EXPIRINGMAP_H
+#define AISDI_MAPS_EXPIRINGMAP_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+
+#include "HashMap.h"
+#include "RecencyList.h"
+
+namespace aisdi {
+
+// Value of an ExpiringMap item, with its deadline and links in a timer slot.
+template<typename KeyType, typename ValueType, typename TimePoint>
+struct TimedEntry {
+    using Item = std::pair<const KeyType, TimedEntry>;
+
+    ValueType value;
+    TimePoint deadline;
+    Item *prev = nullptr;
+    Item *next = nullptr;
+    std::uint16_t slot = 0; // level * WHEEL_SLOTS + slot within the level
+};
+
+// HashMap whose items live until their deadlines. Items are hidden from
+// lookups as soon as their deadline passes, and removed by expire() - which
+// put() runs as well - at an amortized O(1) cost per item: they wait in a
+// hierarchical timer wheel, cascading down its levels as the deadline nears,
+// so no sweep ever scans the map.
+//
+// Clock is anything with now() returning time_points of a std::chrono clock -
+// std::chrono::steady_clock, or a clock driven by tests.
+template<typename KeyType, typename ValueType, typename Clock = std::chrono::steady_clock>
+class ExpiringMap {
+public:
+    using key_type = KeyType;
+    using mapped_type = ValueType;
+    using size_type = std::size_t;
+    using time_point = typename Clock::time_point;
+    using duration = typename Clock::duration;
+
+    // 4 levels of 64 slots cover 2^24 ticks; later deadlines wait in the top
+    // level and go around again.
+    static constexpr unsigned WHEEL_LEVELS = 4;
+    static constexpr unsigned WHEEL_SLOT_BITS = 6;
+    static constexpr unsigned WHEEL_SLOTS = 1u << WHEEL_SLOT_BITS;
+
+private:
+    using Entry = TimedEntry<KeyType, ValueType, time_point>;
+    using Item = typename Entry::Item;
+
+    HashMap<KeyType, Entry> map;
+    RecencyList<Item> wheel[WHEEL_LEVELS * WHEEL_SLOTS];
+    const Clock clock;
+    const duration tick;
+    const time_point origin;
+    std::uint64_t currentTick = 0; // wheel slots up to this one were expired
+
+public:
+    // Deadlines are rounded up to whole ticks for expire(), never for lookups.
+    explicit ExpiringMap(duration tickLength = std::chrono::milliseconds(1), const Clock& c = Clock())
+        : clock(c), tick(tickLength), origin(clock.now())
+    {
+        if (tick <= duration::zero()) throw std::invalid_argument("non-positive tick");
+    }
+
+    // The wheel points into the map's nodes.
+    ExpiringMap(const ExpiringMap&) = delete;
+    ExpiringMap& operator=(const ExpiringMap&) = delete;
+
+    // map[key] = value, until now + ttl
+    template <typename Kk, typename Vv>
+    void put(Kk&& key, Vv&& value, duration ttl) {
+        putUntil(std::forward<Kk>(key), std::forward<Vv>(value), clock.now() + ttl);
+    }
+
+    template <typename Kk, typename Vv>
+    void putUntil(Kk&& key, Vv&& value, time_point deadline) {
+        expire();
+        auto found = map.findOrInsert(std::forward<Kk>(key));
+        Item *item = found.first;
+        if (!found.second) {
+            item->second.value = std::forward<Vv>(value);
+            unschedule(item);
+        } else {
+            try {
+                item->second.value = std::forward<Vv>(value);
+            } catch (...) {
+                map.remove(item->first);
+                throw;
+            }
+        }
+        item->second.deadline = deadline;
+        schedule(item, std::max(tickOf(deadline), currentTick + 1));
+    }
+
+    // Moves the deadline of a live item to now + ttl. Returns false if there's
+    // no such item.
+    bool renew(const key_type& key, duration ttl) {
+        time_point now = clock.now();
+        Item *item = map.findItem(key);
+        if (!item || item->second.deadline <= now) return false;
+        unschedule(item);
+        item->second.deadline = now + ttl;
+        schedule(item, std::max(tickOf(item->second.deadline), currentTick + 1));
+        return true;
+    }
+
+    // Pointer to the value of a live item, or nullptr.
+    const mapped_type* find(const key_type& key) const {
+        const Item *item = map.findItem(key);
+        if (!item || item->second.deadline <= clock.now()) return nullptr;
+        return &item->second.value;
+    }
+
+    mapped_type* find(const key_type& key) {
+        return const_cast<mapped_type*>(static_cast<const ExpiringMap&>(*this).find(key));
+    }
+
+    bool contains(const key_type& key) const {
+        return find(key) != nullptr;
+    }
+
+    const mapped_type& valueOf(const key_type& key) const {
+        const mapped_type *value = find(key);
+        if (!value) throw std::out_of_range("item doesn't exist");
+        return *value;
+    }
+
+    mapped_type& valueOf(const key_type& key) {
+        return const_cast<mapped_type&>(static_cast<const ExpiringMap&>(*this).valueOf(key));
+    }
+
+    // Returns false if there was no live item with key.
+    bool remove(const key_type& key) {
+        Item *item = map.findItem(key);
+        if (!item) return false;
+        bool live = item->second.deadline > clock.now();
+        unschedule(item);
+        map.remove(item->first);
+        return live;
+    }
+
+    // Removes the items whose deadline passed, up to the last whole tick.
+    // Returns how many.
+    size_type expire() {
+        std::uint64_t target = ticksSinceOrigin(clock.now());
+        size_type before = map.getSize();
+        if (!before) currentTick = std::max(currentTick, target);
+        while (currentTick < target) {
+            ++currentTick;
+            for (unsigned level = WHEEL_LEVELS - 1; level > 0; --level)
+                if (!(currentTick & ((std::uint64_t(1) << level * WHEEL_SLOT_BITS) - 1)))
+                    cascade(level);
+            RecencyList<Item>& due = wheel[currentTick & (WHEEL_SLOTS - 1)];
+            while (Item *item = due.front()) {
+                due.unlink(item);
+                map.remove(item->first);
+            }
+            if (map.isEmpty()) currentTick = target;
+        }
+        return before - map.getSize();
+    }
+
+    // Items held, including those past their deadline but not yet expired.
+    size_type getSize() const {
+        return map.getSize();
+    }
+
+    bool isEmpty() const {
+        return map.isEmpty();
+    }
+
+private:
+    std::uint64_t ticksSinceOrigin(time_point t) const {
+        return t <= origin ? 0 : static_cast<std::uint64_t>((t - origin) / tick);
+    }
+
+    // first tick at or after t
+    std::uint64_t tickOf(time_point t) const {
+        std::uint64_t ticks = ticksSinceOrigin(t);
+        return origin + static_cast<typename duration::rep>(ticks) * tick < t ? ticks + 1 : ticks;
+    }
+
+    // Files the item under the lowest level whose slots reach its tick: level
+    // l slots span 64^l ticks each and are cascaded one level down when their
+    // span begins. Tick is never behind currentTick.
+    void schedule(Item *item, std::uint64_t itemTick) {
+        std::uint64_t delta = itemTick - currentTick;
+        unsigned level = 0;
+        while (level + 1 < WHEEL_LEVELS && delta >> (level + 1) * WHEEL_SLOT_BITS) ++level;
+        std::uint64_t position = itemTick >> level * WHEEL_SLOT_BITS;
+        if (delta >> WHEEL_LEVELS * WHEEL_SLOT_BITS) {
+            // beyond the wheel: the top slot cascaded last, to be filed again
+            position = (currentTick >> level * WHEEL_SLOT_BITS) - 1;
+        }
+        std::uint16_t slot = level * WHEEL_SLOTS + (position & (WHEEL_SLOTS - 1));
+        item->second.slot = slot;
+        wheel[slot].pushBack(item);
+    }
+
+    void unschedule(Item *item) {
+        wheel[item->second.slot].unlink(item);
+    }
+
+    void cascade(unsigned level) {
+        std::uint64_t position = currentTick >> level * WHEEL_SLOT_BITS;
+        RecencyList<Item>& slot = wheel[level * WHEEL_SLOTS + (position & (WHEEL_SLOTS - 1))];
+        while (Item *item = slot.front()) {
+            slot.unlink(item);
+            schedule(item, std::max(tickOf(item->second.deadline), currentTick));
+        }
+    }
+};
+
+template<typename KeyType, typename ValueType, typename Clock>
+constexpr unsigned ExpiringMap<KeyType, ValueType, Clock>::WHEEL_LEVELS;
+
+template<typename KeyType, typename ValueType, typename Clock>
+constexpr unsigned ExpiringMap<KeyType, ValueType, Clock>::WHEEL_SLOT_BITS;
+
+template<typename KeyType, typename ValueType, typename Clock>
+constexpr unsigned ExpiringMap<KeyType, ValueType, Clock>::WHEEL_SLOTS;
+
+}
+
+#endif /* AISDI_MAPS_EXPIRINGMAP_H */
@@ -0,0 +1,268 @@
+#ifndef AISDI_MAPS_HASHBUCKET_H
+#define AISDI_MAPS_HASHBUCKET_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <new>
+#include <stdexcept>
+#include <utility>
+
+#include "bst.h"
+
+namespace aisdi {
+
+// Bucket of a HashMap. Up to INLINE_CAPACITY items are pointed to from an
+// array, next to a byte of each item's hash, so a lookup compares the tags
+// and then the key of a match only. Past that the items go to a scapegoat
+// BST, keeping flooded buckets O(log k), and back to the array once they
+// drop to INLINE_CAPACITY - 1. Items are relinked, never moved.
+//
+// Hashes passed in are std::hash of the key; the tree hashes the keys again
+// when it's turned back into the array.
+template<typename KeyType, typename ValueType>
+class HashBucket {
+public:
+    using Tree = BST<KeyType, ValueType>;
+    using node = typename Tree::BSTNode;
+
+    static constexpr unsigned INLINE_CAPACITY = 3;
+
+private:
+    static constexpr std::uint8_t TREE = 0xFF;
+
+    std::uint8_t count = 0; // items in the array, TREE if they're in the tree
+    std::uint8_t tags[INLINE_CAPACITY];
+    union {
+        node *items[INLINE_CAPACITY];
+        Tree tree;
+    };
+
+public:
+    HashBucket() { }
+
+    HashBucket(const HashBucket& other) {
+        if (other.isTree()) {
+            new (&tree) Tree(other.tree);
+            count = TREE;
+            return;
+        }
+        try {
+            for (; count < other.count; ++count) {
+                items[count] = new node(nullptr, other.items[count]->value.first, other.items[count]->value.second);
+                tags[count] = other.tags[count];
+            }
+        } catch (...) {
+            clear();
+            throw;
+        }
+    }
+
+    HashBucket(HashBucket&& other) noexcept {
+        if (other.isTree()) {
+            new (&tree) Tree(std::move(other.tree));
+            count = TREE;
+            other.tree.~Tree();
+            other.count = 0;
+            return;
+        }
+        for (; count < other.count; ++count) {
+            items[count] = other.items[count];
+            tags[count] = other.tags[count];
+        }
+        other.count = 0;
+    }
+
+    HashBucket& operator=(const HashBucket&) = delete;
+    HashBucket& operator=(HashBucket&&) = delete;
+
+    ~HashBucket() {
+        clear();
+    }
+
+    bool isEmpty() const {
+        return !getSize();
+    }
+
+    std::size_t getSize() const {
+        return isTree() ? tree.getSize() : count;
+    }
+
+    node* findNodeWithKey(const KeyType& key, std::size_t hash) const {
+        if (isTree()) return tree.findNodeWithKey(key);
+        std::uint8_t tag = tagOf(hash);
+        for (unsigned i = 0; i < count; ++i)
+            if (tags[i] == tag && items[i]->value.first == key) return items[i];
+        return nullptr;
+    }
+
+    // Like BST::insert(): the node with key, inserted if absent.
+    template <typename Kk>
+    node* insert(Kk&& key, std::size_t hash) {
+        if (node *n = findNodeWithKey(key, hash)) return n;
+        if (count < INLINE_CAPACITY) {
+            items[count] = new node(nullptr, std::forward<Kk>(key), ValueType());
+            tags[count] = tagOf(hash);
+            return items[count++];
+        }
+        if (!isTree()) toTree();
+        return tree.insertBalanced(std::forward<Kk>(key));
+    }
+
+    // Links in a node with no links whose key isn't in the bucket yet.
+    void adoptNode(node *n, std::size_t hash) {
+        if (count < INLINE_CAPACITY) {
+            items[count] = n;
+            tags[count++] = tagOf(hash);
+            return;
+        }
+        if (!isTree()) toTree();
+        tree.adoptBalanced(n);
+    }
+
+    bool deleteKey(const KeyType& key, std::size_t hash) {
+        node *n = extractKey(key, hash);
+        if (!n) return false;
+        delete n;
+        return true;
+    }
+
+    // Unlinks the node with key and hands it over, with no links, for
+    // adoptNode(); nullptr if there's none.
+    node* extractKey(const KeyType& key, std::size_t hash) {
+        if (isTree()) {
+            node *n = tree.findNodeWithKey(key);
+            if (!n) return nullptr;
+            tree.extractNode(n);
+            if (tree.getSize() < INLINE_CAPACITY) toArray();
+            return n;
+        }
+        std::uint8_t tag = tagOf(hash);
+        for (unsigned i = 0; i < count; ++i)
+            if (tags[i] == tag && items[i]->value.first == key) {
+                node *n = items[i];
+                for (--count; i < count; ++i) {
+                    items[i] = items[i + 1];
+                    tags[i] = tags[i + 1];
+                }
+                return n;
+            }
+        return nullptr;
+    }
+
+    void clear() {
+        if (isTree()) {
+            tree.~Tree();
+        } else {
+            for (unsigned i = 0; i < count; ++i)
+                delete items[i];
+        }
+        count = 0;
+    }
+
+    // The node a lookup reads first, for prefetching.
+    node* getRoot() const {
+        if (isTree()) return tree.getRoot();
+        return count ? items[0] : nullptr;
+    }
+
+    // Iteration runs in array order, or in key order in the tree; the next
+    // and previous nodes of the last and first ones throw std::out_of_range,
+    // as in BST.
+    node* getFirstNode() const {
+        if (isTree()) return tree.getFirstNode();
+        return count ? items[0] : nullptr;
+    }
+
+    node* getLastNode() const {
+        if (isTree()) return tree.getLastNode();
+        return count ? items[count - 1] : nullptr;
+    }
+
+    node* getNextNode(node *n) const {
+        if (isTree()) return tree.getNextNode(n);
+        unsigned i = positionOf(n);
+        if (i + 1 >= count) throw std::out_of_range("end of bucket");
+        return items[i + 1];
+    }
+
+    node* getPreviousNode(node *n) const {
+        if (isTree()) return tree.getPreviousNode(n);
+        unsigned i = positionOf(n);
+        if (!i || i >= count) throw std::out_of_range("end of bucket");
+        return items[i - 1];
+    }
+
+    template <typename Fn>
+    void forEachNode(Fn fn) const {
+        if (isTree()) {
+            tree.forEachNode(fn);
+            return;
+        }
+        for (unsigned i = 0; i < count; ++i)
+            fn(items[i]);
+    }
+
+    // As BST::releaseNodes(): empties the bucket, handing each node over to fn.
+    template <typename Fn>
+    void releaseNodes(Fn fn) {
+        if (isTree()) {
+            tree.releaseNodes(fn);
+            tree.~Tree();
+            count = 0;
+            return;
+        }
+        std::uint8_t released = count;
+        count = 0;
+        for (unsigned i = 0; i < released; ++i)
+            fn(items[i]);
+    }
+
+    bool isTree() const {
+        return count == TREE;
+    }
+
+private:
+    // std::hash of integers is the identity, so the tag comes from a mix of
+    // all the hash's bits
+    static std::uint8_t tagOf(std::size_t hash) {
+        return static_cast<std::uint8_t>((static_cast<std::uint64_t>(hash) * 0x9E3779B97F4A7C15ull) >> 56);
+    }
+
+    unsigned positionOf(node *n) const {
+        unsigned i = 0;
+        while (i < count && items[i] != n) ++i;
+        return i;
+    }
+
+    void toTree() {
+        node *inlined[INLINE_CAPACITY];
+        for (unsigned i = 0; i < count; ++i)
+            inlined[i] = items[i];
+        new (&tree) Tree();
+        count = TREE;
+        for (node *n : inlined)
+            tree.adoptBalanced(n);
+    }
+
+    void toArray() {
+        node *released[INLINE_CAPACITY];
+        std::uint8_t number = 0;
+        tree.releaseNodes([&](node *n) { released[number++] = n; });
+        tree.~Tree();
+        for (count = 0; count < number; ++count) {
+            items[count] = released[count];
+            tags[count] = tagOf(std::hash<KeyType>()(released[count]->value.first));
+        }
+    }
+};
+
+template<typename KeyType, typename ValueType>
+constexpr unsigned HashBucket<KeyType, ValueType>::INLINE_CAPACITY;
+
+template<typename KeyType, typename ValueType>
+constexpr std::uint8_t HashBucket<KeyType, ValueType>::TREE;
+
+}
+
+#endif /* AISDI_MAPS_HASHBUCKET_H */
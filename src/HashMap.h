@@ -1,22 +1,73 @@
 #ifndef AISDI_MAPS_HASHMAP_H
 #define AISDI_MAPS_HASHMAP_H
 
+#include <algorithm>
 #include <cstddef>
+#include <cstdlib>
 #include <initializer_list>
 #include <stdexcept>
 #include <utility>
 #include <vector>
 #include <list>
 #include <functional>
+#include <iterator>
+#include <type_traits>
 #include "bst.h"
+#include "HashBucket.h"
+#include "NodeHandle.h"
+#include "Parallel.h"
+#include "Prefetch.h"
+#include "Serialization.h"
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
 
 namespace aisdi {
 
     template<typename KeyType, typename ValueType>
     class HashMap {
-        using node = typename BST<KeyType, ValueType>::BSTNode;
-        const std::size_t BUCKETS_NUMBER = 15693; // prime number closest to 1024
-        std::vector<BST<KeyType, ValueType>> hashTable;
+        using Bucket = HashBucket<KeyType, ValueType>;
+        using node = typename Bucket::node;
+    public:
+        // Buckets of the first table, allocated once the map outgrows
+        // SMALL_CAPACITY; kept small, as most maps stay small, and grown from
+        // there like any other table.
+        static constexpr std::size_t BUCKETS_NUMBER = 17;
+        // Up to this many items are kept in a flat array, searched linearly,
+        // before the buckets are allocated.
+        static constexpr std::size_t SMALL_CAPACITY = 8;
+        // Past this many items per bucket the table grows to 2n + 1 buckets,
+        // never all at once: every insert or remove first constructs
+        // PREPARE_STEP buckets of the new table, then, once it's complete,
+        // relinks the nodes of MIGRATION_STEP old buckets into it. Iterators
+        // don't survive that, though pointers and references to items do.
+        // Shrinking, if enabled with setMinLoadFactor(), goes the same way.
+        static constexpr std::size_t MAX_LOAD_FACTOR = 2;
+        static constexpr std::size_t PREPARE_STEP = 64;
+        static constexpr std::size_t MIGRATION_STEP = 8;
+
+        // Bytes held by the map, as getMemoryUsage() counts them, before and
+        // after shrinkToFit().
+        struct MemoryReport {
+            std::size_t before;
+            std::size_t after;
+        };
+    private:
+        // empty while the map is small
+        std::vector<Bucket> hashTable;
+        // while the table grows, the previous one; its buckets below migrated
+        // were moved to hashTable already
+        std::vector<Bucket> oldTable;
+        std::size_t migrated;
+        // the table to resize to, while it's being constructed, and its final
+        // size; 0 if there's none
+        std::vector<Bucket> nextTable;
+        std::size_t targetBuckets;
+        // the table shrinks once the items per bucket drop below it; 0 never
+        double minLoadFactor;
+        // items of a small map, in insertion order; the nodes are handed over
+        // to the buckets as they are, so items never move
+        node *smallItems[SMALL_CAPACITY];
         std::size_t size;
     public:
         using key_type = KeyType;
@@ -25,6 +76,7 @@ namespace aisdi {
         using size_type = std::size_t;
         using reference = value_type&;
         using const_reference = const value_type&;
+        using node_type = NodeHandle<KeyType, ValueType>;
 
         class ConstIterator;
 
@@ -34,7 +86,7 @@ namespace aisdi {
         using const_iterator = ConstIterator;
 
         HashMap()
-            : hashTable(BUCKETS_NUMBER), size(0)
+            : migrated(0), targetBuckets(0), minLoadFactor(0), smallItems(), size(0)
         { }
 
         HashMap(std::initializer_list<value_type> list)
@@ -44,89 +96,173 @@ namespace aisdi {
                 (*this)[std::move(pair.first)] = std::move(pair.second);
         }
 
+        // A table being constructed isn't copied; the copy starts over.
         HashMap(const HashMap& other)
-            : hashTable(other.hashTable), size(other.size)
-        { }
+            : hashTable(other.hashTable), oldTable(other.oldTable), migrated(other.migrated),
+              targetBuckets(0), minLoadFactor(other.minLoadFactor), smallItems(), size(0)
+        {
+            if (other.isSmall()) {
+                try {
+                    for (; size < other.size; ++size)
+                        smallItems[size] = new node(nullptr, other.smallItems[size]->value.first,
+                                                    other.smallItems[size]->value.second);
+                } catch (...) {
+                    clearSmall();
+                    throw;
+                }
+            }
+            size = other.size;
+        }
 
-        HashMap(HashMap&& other)
-            : hashTable(std::move(other.hashTable)), size(other.size)
+        // Moves take the source's table and leave it an empty small map.
+        HashMap(HashMap&& other) noexcept
+            : HashMap()
         {
-            other.clear();
+            swap(other);
+        }
+
+        ~HashMap() {
+            clearSmall();
         }
 
         HashMap& operator=(const HashMap& other) {
             if (this == &other) return *this;
-            hashTable = other.hashTable;
-            size = other.size;
+            HashMap copy(other);
+            swap(copy);
             return *this;
         }
 
-        HashMap& operator=(HashMap&& other) {
+        HashMap& operator=(HashMap&& other) noexcept {
             if (this == &other) return *this;
-            hashTable = std::move(other.hashTable);
-            size = other.size;
-            other.clear();
+            HashMap moved(std::move(other));
+            swap(moved);
             return *this;
         }
 
+        // Builds a map of the pairs of [first, last) as if they were assigned
+        // one by one, so the last of equal keys wins. Every thread owns a
+        // contiguous range of buckets and fills only those, without locking;
+        // the items are routed to their owners in parallel beforehand.
+        template <typename RandomIt>
+        static HashMap buildParallel(RandomIt first, RandomIt last,
+                                     unsigned threads = defaultThreadsNumber()) {
+            HashMap result;
+            std::size_t n = last - first;
+            if (n <= SMALL_CAPACITY) {
+                for (; first != last; ++first) result[first->first] = first->second;
+                return result;
+            }
+            result.hashTable.resize(bucketsFor(n));
+            unsigned workers = workersFor(n, threads);
+            // routes[chunk][owner] - (bucket, position) of the chunk's items, in input order
+            using Route = std::pair<std::size_t, std::size_t>;
+            std::vector<std::vector<std::vector<Route>>> routes(workers, std::vector<std::vector<Route>>(workers));
+            runWorkers(workers, [&](unsigned chunk) {
+                for (std::size_t i = n * chunk / workers; i < n * (chunk + 1) / workers; ++i) {
+                    std::size_t idx = result.bucketOf(hashOf(first[i].first));
+                    routes[chunk][idx * workers / result.hashTable.size()].emplace_back(idx, i);
+                }
+            });
+
+            std::vector<std::size_t> inserted(workers);
+            runWorkers(workers, [&](unsigned owner) {
+                std::size_t count = 0;
+                for (auto& chunk : routes)
+                    for (auto& route : chunk[owner]) {
+                        auto& bucket = result.hashTable[route.first];
+                        std::size_t before = bucket.getSize();
+                        const KeyType& key = first[route.second].first;
+                        bucket.insert(key, hashOf(key))->value.second = first[route.second].second;
+                        count += bucket.getSize() - before;
+                    }
+                inserted[owner] = count;
+            });
+            for (std::size_t count : inserted)
+                result.size += count;
+            return result;
+        }
+
         bool isEmpty() const {
             return !getSize();
         }
 
         template <typename Kk>
         mapped_type& operator[](Kk&& key) {
-            std::size_t idx = std::hash<KeyType>()(key) % BUCKETS_NUMBER;
-            auto t = hashTable[idx].findNodeWithKey((key));
+            return findOrInsert(std::forward<Kk>(key)).first->second;
+        }
+
+        // Item with key, inserted with a default-constructed value if absent;
+        // second tells whether it was. Items stay where they are until removed.
+        template <typename Kk>
+        std::pair<value_type*, bool> findOrInsert(Kk&& key) {
+            if (isSmall()) {
+                if (node *n = findSmall(key)) return { &n->value, false };
+                if (size < SMALL_CAPACITY) {
+                    smallItems[size] = new node(nullptr, std::forward<Kk>(key), ValueType());
+                    return { &smallItems[size++]->value, true };
+                }
+                growToBuckets();
+            }
+            migrate();
+            std::size_t hash = hashOf(key);
+            auto& bucket = bucketAt(positionOf(hash));
+            auto t = bucket.findNodeWithKey(key, hash);
             if (!t) {
+                t = bucket.insert(std::forward<Kk>(key), hash);
                 ++size;
-                return hashTable[idx].insert(std::forward<Kk>(key))->value.second;
+                growIfFull();
+                return { &t->value, true };
             }
-            return t->value.second;
+            return { &t->value, false };
+        }
+
+        // Pointer to the item with key, or nullptr - a lookup without the
+        // iterators, whose end() scans the buckets.
+        const value_type* findItem(const key_type& key) const {
+            node *n = findNode(key);
+            return n ? &n->value : nullptr;
+        }
+
+        value_type* findItem(const key_type& key) {
+            node *n = findNode(key);
+            return n ? &n->value : nullptr;
         }
 
         const mapped_type& valueOf(const key_type& key) const {
-            std::size_t idx = std::hash<KeyType>()(key) % BUCKETS_NUMBER;
-            node *n = hashTable[idx].findNodeWithKey(key);
+            node *n = findNode(key);
             if (!n) throw std::out_of_range("el doesn't exist");
             return n->value.second;
         }
 
         mapped_type& valueOf(const key_type& key) {
-            std::size_t idx = std::hash<KeyType>()(key) % BUCKETS_NUMBER;
-            node *n = hashTable[idx].findNodeWithKey(key);
+            node *n = findNode(key);
             if (!n) throw std::out_of_range("el doesn't exist");
             return n->value.second;
         }
 
         const_iterator find(const key_type& key) const {
-            std::size_t idx = std::hash<KeyType>()(key) % BUCKETS_NUMBER;
-            node *n = hashTable[idx].findNodeWithKey(key);
+            if (isSmall()) {
+                std::size_t position = smallPositionOf(key);
+                if (position == size) return cend();
+                return ConstIterator(*this, 0, smallItems[position], false);
+            }
+            std::size_t hash = hashOf(key);
+            std::size_t bucket = positionOf(hash);
+            node *n = bucketAt(bucket).findNodeWithKey(key, hash);
             if (!n) return cend();
-            auto it = hashTable.cbegin() + idx;
             return ConstIterator(*this,
-                            it, // iterator for hashTable
-                            &(*it), // pointer to the tree under it
+                            bucket, // position of the bucket
                             n, // node with key
                             false); // isEnd
         }
 
         iterator find(const key_type& key) {
-            std::size_t idx = std::hash<KeyType>()(key) % BUCKETS_NUMBER;
-            node *n = hashTable[idx].findNodeWithKey(key);
-            if (!n) return cend();
-            auto it = hashTable.cbegin() + idx;
-            return Iterator(*this,
-                            it, // iterator for hashTable
-                            &(*it), // pointer to the tree under it
-                            n, // node with key
-                            false); // isEnd
+            return static_cast<const HashMap&>(*this).find(key);
         }
 
         void remove(const key_type& key) {
-            std::size_t idx = std::hash<KeyType>()(key) % BUCKETS_NUMBER;
-            if (!hashTable[idx].deleteKey(key))
+            if (extract(key).isEmpty())
                 throw std::out_of_range("delete unexisting item");
-            --size;
         }
 
         void remove(const const_iterator& it) {
@@ -135,14 +271,83 @@ namespace aisdi {
             remove(it->first);
         }
 
+        // Takes the item with key out of the map without freeing it; the
+        // handle is empty if there's no such item. As remove() does, it takes
+        // a step of resizing.
+        node_type extract(const key_type& key) {
+            if (isSmall()) {
+                std::size_t position = smallPositionOf(key);
+                if (position == size) return node_type();
+                node *n = smallItems[position];
+                std::move(smallItems + position + 1, smallItems + size, smallItems + position);
+                --size;
+                return node_type(n);
+            }
+            migrate();
+            std::size_t hash = hashOf(key);
+            node *n = bucketAt(positionOf(hash)).extractKey(key, hash);
+            if (!n) return node_type();
+            --size;
+            shrinkIfSparse();
+            return node_type(n);
+        }
+
+        node_type extract(const const_iterator& it) {
+            if (it == cend())
+                throw std::out_of_range("extract unexisting item");
+            return extract(it->first);
+        }
+
+        // Links in the node of handle, which may come from a TreeMap as well,
+        // unless its key is here already - then the handle keeps it. Returns
+        // the item with the key and whether it's the handle's; nullptr and
+        // false for an empty handle.
+        std::pair<value_type*, bool> insert(node_type&& handle) {
+            if (handle.isEmpty()) return { nullptr, false };
+            if (node *n = findNode(handle.key())) return { &n->value, false };
+            node *n = handle.release();
+            adopt(n);
+            return { &n->value, true };
+        }
+
+        // Relinks every item of other whose key isn't in this map, leaving
+        // other the rest; none is copied or reallocated.
+        void merge(HashMap& other) {
+            if (&other == this) return;
+            if (other.isSmall()) {
+                std::size_t kept = 0;
+                for (std::size_t i = 0; i < other.size; ++i) {
+                    if (findNode(other.smallItems[i]->value.first))
+                        other.smallItems[kept++] = other.smallItems[i];
+                    else
+                        adopt(other.smallItems[i]);
+                }
+                other.size = kept;
+                return;
+            }
+            std::vector<node*> kept;
+            for (std::size_t position = 0; position < other.bucketsSpan(); ++position)
+                other.bucketAt(position).releaseNodes([this, &kept](node *n) {
+                    if (findNode(n->value.first))
+                        kept.push_back(n);
+                    else
+                        adopt(n);
+                });
+            other.size = 0;
+            for (node *n : kept)
+                other.adopt(n);
+            other.shrinkIfSparse();
+        }
+
         size_type getSize() const {
             return size;
         }
 
         bool operator==(const HashMap& other) const {
             if (size != other.size) return false;
-            for (auto i = 0u; i < BUCKETS_NUMBER; ++i) {
-                if (hashTable[i] != other.hashTable[i])
+            for (const auto& item : *this) {
+                node *n = other.findNode(item.first);
+                if (!n || n->value.second != item.second)
                     return false;
             }
             return true;
@@ -152,63 +357,90 @@ namespace aisdi {
             return !(*this == other);
         }
 
+        // Frees the items but keeps the table, if any, for reuse.
         void clear() {
-            hashTable = std::vector<BST<KeyType, ValueType>>(BUCKETS_NUMBER);
+            clearSmall();
+            if (size)
+                for (auto& bucket : hashTable)
+                    if (!bucket.isEmpty()) bucket.clear();
+            std::vector<Bucket>().swap(oldTable);
+            std::vector<Bucket>().swap(nextTable);
+            targetBuckets = 0;
+            migrated = 0;
             size = 0;
         }
 
+        // Rehashes the items into the smallest table that holds them, or
+        // back into the flat array if they fit, finishing any resizing on
+        // the way; nodes are relinked, so pointers and references to items
+        // stay valid. Then hands the freed memory back to the OS where the
+        // allocator allows it.
+        MemoryReport shrinkToFit() {
+            MemoryReport report;
+            report.before = getMemoryUsage();
+            if (!isSmall()) {
+                if (size <= SMALL_CAPACITY)
+                    shrinkToSmall();
+                else
+                    rehashInto(bucketsFor(size));
+            }
+            releaseFreeMemory();
+            report.after = getMemoryUsage();
+            return report;
+        }
+
+        // Enables shrinking as items are removed: once there are fewer than
+        // minLoadFactor items per bucket, the table starts shrinking,
+        // incrementally, to half its maximum load. Throws
+        // std::invalid_argument unless 0 <= minLoadFactor < 1; 0 disables it.
+        void setMinLoadFactor(double factor) {
+            if (!(factor >= 0 && factor < 1))
+                throw std::invalid_argument("min load factor out of [0, 1)");
+            minLoadFactor = factor;
+        }
+
+        double getMinLoadFactor() const {
+            return minLoadFactor;
+        }
+
+        // Bytes allocated for the tables and the nodes, without the
+        // allocator's own overhead.
+        std::size_t getMemoryUsage() const {
+            std::size_t tables = hashTable.capacity() + oldTable.capacity() + nextTable.capacity();
+            return sizeof(*this) + tables * sizeof(Bucket) + size * sizeof(node);
+        }
+
         iterator begin() {
-            auto it = hashTable.begin();
-            for (; it != hashTable.end(); ++it)
-                if (!it->isEmpty()) break;
-            if (it != hashTable.end())
-                return Iterator(*this,
-                                it, // iterator for hashTable
-                                &(*it), // pointer to the tree under it
-                                it->getFirstNode(), // first node in tree
-                                false); // isEnd
-            return Iterator(*this,
-                            it, // iterator for hashTable
-                            &(*--it), // pointer to the tree under last position in hashTable
-                            nullptr, // because any node in the tree doesn't exist
-                            true); // isEnd
+            return cbegin();
         }
 
         iterator end() {
-            auto it = --hashTable.end();
-            for (; it != hashTable.begin(); --it)
-                if (!it->isEmpty()) break;
-            return Iterator(*this,
-                            it, // iterator for hashTable
-                            &(*it), // pointer to the tree under last position in hashTable
-                            nullptr, // because any node in the tree doesn't exist
-                            true); // isEnd
+            return cend();
         }
 
         const_iterator cbegin() const {
-            auto it = hashTable.begin();
-            for (; it != hashTable.end(); ++it)
-                if (!it->isEmpty()) break;
-            if (it != hashTable.end())
+            if (isSmall())
+                return ConstIterator(*this, 0, size ? smallItems[0] : nullptr, !size);
+            std::size_t span = bucketsSpan(), bucket = 0;
+            while (bucket != span && bucketAt(bucket).isEmpty()) ++bucket;
+            if (bucket != span)
                 return ConstIterator(*this,
-                                     it, // iterator for hashTable
-                                     &(*it), // pointer to the tree under it
-                                     it->getFirstNode(), // first node in tree
+                                     bucket, // position of the bucket
+                                     bucketAt(bucket).getFirstNode(), // first node in tree
                                      false); // isEnd
             return ConstIterator(*this,
-                                 it, // iterator for hashTable
-                                 &(*--it), // pointer to the tree under last position in hashTable
+                                 span - 1, // last bucket
                                  nullptr, // because any node in the tree doesn't exist
                                  true); // isEnd
         }
 
         const_iterator cend() const {
-            auto it = --hashTable.end();
-            for (; it != hashTable.begin(); --it)
-                if (!it->isEmpty()) break;
+            if (isSmall())
+                return ConstIterator(*this, 0, nullptr, true);
+            std::size_t bucket = bucketsSpan() - 1;
+            while (bucket && bucketAt(bucket).isEmpty()) --bucket;
             return ConstIterator(*this,
-                                 it, // iterator for hashTable
-                                 &(*it), // pointer to the tree under last position in hashTable
+                                 bucket, // last non-empty bucket
                                  nullptr, // because any node in the tree doesn't exist
                                  true); // isEnd
         }
@@ -221,50 +453,426 @@ namespace aisdi {
             return cend();
         }
 
+        // Looks up every key of [keysFirst, keysLast) and writes a pointer to
+        // its item, or nullptr if missing, to out. The batch is hashed first and
+        // bucket slots, then first nodes are prefetched before any key is
+        // resolved, so the cache misses of many lookups overlap.
+        template <typename ForwardIt, typename OutputIt>
+        OutputIt findBatch(ForwardIt keysFirst, ForwardIt keysLast, OutputIt out) const {
+            return findBatchHelper(keysFirst, keysLast, out,
+                                   [](node *n) -> const value_type* { return n ? &n->value : nullptr; });
+        }
+
+        template <typename ForwardIt, typename OutputIt>
+        OutputIt findBatch(ForwardIt keysFirst, ForwardIt keysLast, OutputIt out) {
+            return findBatchHelper(keysFirst, keysLast, out,
+                                   [](node *n) -> value_type* { return n ? &n->value : nullptr; });
+        }
+
+        // map[item.first] = item.second for every pair of [first, last), with
+        // the batch hashed and prefetched as in findBatch().
+        template <typename ForwardIt>
+        void insertBatch(ForwardIt first, ForwardIt last) {
+            for (; first != last && isSmall(); ++first)
+                (*this)[first->first] = first->second;
+            std::size_t idx[BATCH_WINDOW], hashes[BATCH_WINDOW];
+            ForwardIt items[BATCH_WINDOW];
+            while (first != last) {
+                std::size_t n = 0;
+                for (; n < BATCH_WINDOW && first != last; ++n, ++first) {
+                    items[n] = first;
+                    hashes[n] = hashOf(first->first);
+                    idx[n] = positionOf(hashes[n]);
+                    AISDI_PREFETCH(&bucketAt(idx[n]));
+                }
+                for (std::size_t i = 0; i < n; ++i)
+                    AISDI_PREFETCH(bucketAt(idx[i]).getRoot());
+                for (std::size_t i = 0; i < n; ++i) {
+                    auto& bucket = bucketAt(idx[i]);
+                    std::size_t before = bucket.getSize();
+                    bucket.insert(items[i]->first, hashes[i])->value.second = items[i]->second;
+                    size += bucket.getSize() - before;
+                }
+                // as much migration as n inserts would do; positions stay
+                // valid within a window
+                migrate(n * MIGRATION_STEP);
+                growIfFull();
+            }
+        }
+
+        // Calls fn(value_type&) for every item, on up to threads threads that
+        // each take a contiguous range of buckets. fn must be safe to call
+        // concurrently and must not add or remove items.
+        template <typename Fn>
+        void forEachParallel(Fn fn, unsigned threads = defaultThreadsNumber()) {
+            foldBucketRanges(NoResult(), [&fn](NoResult&, node *n) { fn(n->value); }, threads);
+        }
+
+        template <typename Fn>
+        void forEachParallel(Fn fn, unsigned threads = defaultThreadsNumber()) const {
+            foldBucketRanges(NoResult(), [&fn](NoResult&, node *n) { fn(const_cast<const value_type&>(n->value)); },
+                             threads);
+        }
+
+        // Folds mapFn(item) of every item with reduceFn, on up to threads
+        // threads. Ranges are folded from identity and their results combined
+        // in bucket order, so for an associative reduceFn with identity as its
+        // neutral element the result equals that of a sequential fold in
+        // iteration order, whatever the number of threads.
+        template <typename Acc, typename MapFn, typename ReduceFn>
+        Acc reduceParallel(Acc identity, MapFn mapFn, ReduceFn reduceFn,
+                           unsigned threads = defaultThreadsNumber()) const {
+            auto partials = foldBucketRanges(identity, [&](Acc& acc, node *n) {
+                acc = reduceFn(std::move(acc), mapFn(const_cast<const value_type&>(n->value)));
+            }, threads);
+            Acc result = std::move(identity);
+            for (auto& partial : partials)
+                result = reduceFn(std::move(result), std::move(partial));
+            return result;
+        }
+
+        // Writes a binary snapshot of the map (see Serialization.h).
+        // Throws SnapshotError if the stream fails.
+        void save(std::ostream& out) const {
+            writeSnapshot<KeyType, ValueType>(out, size, 0, [this](const auto& emit) {
+                for (std::size_t i = 0; i < this->smallSize(); ++i)
+                    emit(smallItems[i]->value);
+                for (std::size_t bucket = 0; bucket < this->bucketsSpan(); ++bucket)
+                    this->bucketAt(bucket).forEachNode([&emit](node *n) { emit(n->value); });
+            });
+        }
+
+        void swap(HashMap& other) noexcept {
+            using std::swap;
+            swap(hashTable, other.hashTable);
+            swap(oldTable, other.oldTable);
+            swap(migrated, other.migrated);
+            swap(nextTable, other.nextTable);
+            swap(targetBuckets, other.targetBuckets);
+            swap(minLoadFactor, other.minLoadFactor);
+            swap(smallItems, other.smallItems);
+            swap(size, other.size);
+        }
+
+        // Replaces the contents with a snapshot written by save() of either
+        // map. Throws SnapshotError, leaving the map untouched, if the
+        // snapshot is damaged or holds other types.
+        void load(std::istream& in) {
+            SnapshotReader<KeyType, ValueType> reader(in);
+            HashMap loaded;
+            std::vector<KeyType> keys;
+            std::vector<ValueType> values;
+            while (reader.nextBlock(keys, values))
+                for (std::size_t i = 0; i < keys.size(); ++i)
+                    loaded[std::move(keys[i])] = std::move(values[i]);
+            *this = std::move(loaded);
+        }
+
+    private:
+        static constexpr std::size_t BATCH_WINDOW = 128;
+
+        // fold(acc, node) over contiguous bucket ranges, one per worker;
+        // returns the ranges' accumulators in bucket order
+        template <typename Acc, typename Fold>
+        std::vector<Acc> foldBucketRanges(const Acc& identity, Fold fold, unsigned threads) const {
+            if (isSmall()) {
+                std::vector<Acc> partials(1, identity);
+                for (std::size_t i = 0; i < size; ++i) fold(partials[0], smallItems[i]);
+                return partials;
+            }
+            unsigned workers = workersFor(size, threads);
+            std::vector<Acc> partials(workers, identity);
+            std::size_t span = bucketsSpan();
+            runWorkers(workers, [&](unsigned worker) {
+                Acc acc = identity; // not in partials, which share cache lines
+                for (std::size_t idx = span * worker / workers; idx < span * (worker + 1) / workers; ++idx)
+                    bucketAt(idx).forEachNode([&](node *n) { fold(acc, n); });
+                partials[worker] = std::move(acc);
+            });
+            return partials;
+        }
+
+        static std::size_t hashOf(const key_type& key) {
+            return std::hash<KeyType>()(key);
+        }
+
+        std::size_t bucketOf(std::size_t hash) const {
+            return hash % hashTable.size();
+        }
+
+        // Buckets are iterated over - and numbered by positionOf() - in this
+        // order: those of the old table not migrated yet, then hashTable's.
+        std::size_t bucketsSpan() const {
+            return oldTable.size() - migrated + hashTable.size();
+        }
+
+        // position of the bucket holding keys with hash: the old table's one
+        // until it's migrated
+        std::size_t positionOf(std::size_t hash) const {
+            std::size_t pending = oldTable.size() - migrated;
+            if (pending) {
+                std::size_t idx = hash % oldTable.size();
+                if (idx >= migrated) return idx - migrated;
+            }
+            return pending + hash % hashTable.size();
+        }
+
+        const Bucket& bucketAt(std::size_t position) const {
+            std::size_t pending = oldTable.size() - migrated;
+            return position < pending ? oldTable[migrated + position] : hashTable[position - pending];
+        }
+
+        Bucket& bucketAt(std::size_t position) {
+            return const_cast<Bucket&>(static_cast<const HashMap&>(*this).bucketAt(position));
+        }
+
+        // First table size that holds n items, as insertions would grow it
+        // from BUCKETS_NUMBER; so shrinking goes down to tables that small.
+        static std::size_t bucketsFor(std::size_t n) {
+            std::size_t buckets = BUCKETS_NUMBER;
+            while (n > MAX_LOAD_FACTOR * buckets) buckets = 2 * buckets + 1;
+            return buckets;
+        }
+
+        bool isResizing() const {
+            return targetBuckets || !oldTable.empty();
+        }
+
+        // Starts resizing to buckets. Reserving doesn't touch the memory, so
+        // it costs no more than a small malloc.
+        void startResizing(std::size_t buckets) {
+            nextTable.reserve(buckets);
+            targetBuckets = buckets;
+        }
+
+        void growIfFull() {
+            if (isResizing() || size <= MAX_LOAD_FACTOR * hashTable.size()) return;
+            startResizing(2 * hashTable.size() + 1);
+        }
+
+        // Shrinks to the smallest table where the items make at most half the
+        // maximum load, so that a few inserts don't grow it right back.
+        void shrinkIfSparse() {
+            if (isResizing() || size >= minLoadFactor * hashTable.size()) return;
+            std::size_t buckets = bucketsFor(2 * size);
+            if (buckets < hashTable.size()) startResizing(buckets);
+        }
+
+        // Does the resizing work of buckets / MIGRATION_STEP operations:
+        // constructs buckets of the new table, then relinks nodes of the old
+        // ones.
+        void migrate(std::size_t buckets = MIGRATION_STEP) {
+            if (targetBuckets) {
+                std::size_t stop = std::min(targetBuckets, nextTable.size() + buckets / MIGRATION_STEP * PREPARE_STEP);
+                while (nextTable.size() < stop) nextTable.emplace_back(); // within the reserved capacity
+                if (nextTable.size() == targetBuckets) {
+                    targetBuckets = 0;
+                    oldTable.swap(hashTable);
+                    hashTable.swap(nextTable); // leaving nextTable the empty old table
+                    migrated = 0;
+                }
+                return;
+            }
+            if (oldTable.empty()) return;
+            std::size_t stop = std::min(migrated + buckets, oldTable.size());
+            for (; migrated < stop; ++migrated)
+                oldTable[migrated].releaseNodes([this](node *n) {
+                    std::size_t hash = hashOf(n->value.first);
+                    hashTable[bucketOf(hash)].adoptNode(n, hash);
+                });
+            if (migrated == oldTable.size()) {
+                std::vector<Bucket>().swap(oldTable);
+                migrated = 0;
+            }
+        }
+
+        bool isSmall() const {
+            return hashTable.empty();
+        }
+
+        std::size_t smallSize() const {
+            return isSmall() ? size : 0;
+        }
+
+        // position of key in smallItems, or size if absent
+        std::size_t smallPositionOf(const key_type& key) const {
+            std::size_t position = 0;
+            while (position < size && !(smallItems[position]->value.first == key)) ++position;
+            return position;
+        }
+
+        node* findSmall(const key_type& key) const {
+            std::size_t position = smallPositionOf(key);
+            return position < size ? smallItems[position] : nullptr;
+        }
+
+        node* findNode(const key_type& key) const {
+            if (isSmall()) return findSmall(key);
+            std::size_t hash = hashOf(key);
+            return bucketAt(positionOf(hash)).findNodeWithKey(key, hash);
+        }
+
+        // Links in a node with no links whose key isn't here yet, as
+        // findOrInsert() would insert it.
+        void adopt(node *n) {
+            if (isSmall()) {
+                if (size < SMALL_CAPACITY) {
+                    smallItems[size++] = n;
+                    return;
+                }
+                growToBuckets();
+            }
+            migrate();
+            std::size_t hash = hashOf(n->value.first);
+            bucketAt(positionOf(hash)).adoptNode(n, hash);
+            ++size;
+            growIfFull();
+        }
+
+        void growToBuckets() {
+            hashTable.resize(BUCKETS_NUMBER);
+            for (std::size_t i = 0; i < size; ++i) {
+                std::size_t hash = hashOf(smallItems[i]->value.first);
+                hashTable[bucketOf(hash)].adoptNode(smallItems[i], hash);
+            }
+        }
+
+        // Relinks every node into a new table of buckets at once, dropping the
+        // tables of any resizing.
+        void rehashInto(std::size_t buckets) {
+            std::vector<Bucket> table(buckets);
+            for (std::size_t position = 0; position < bucketsSpan(); ++position)
+                bucketAt(position).releaseNodes([&table, buckets](node *n) {
+                    std::size_t hash = hashOf(n->value.first);
+                    table[hash % buckets].adoptNode(n, hash);
+                });
+            hashTable.swap(table);
+            std::vector<Bucket>().swap(oldTable);
+            std::vector<Bucket>().swap(nextTable);
+            targetBuckets = 0;
+            migrated = 0;
+        }
+
+        void shrinkToSmall() {
+            std::size_t count = 0;
+            for (std::size_t position = 0; position < bucketsSpan(); ++position)
+                bucketAt(position).releaseNodes([this, &count](node *n) { smallItems[count++] = n; });
+            std::vector<Bucket>().swap(hashTable);
+            std::vector<Bucket>().swap(oldTable);
+            std::vector<Bucket>().swap(nextTable);
+            targetBuckets = 0;
+            migrated = 0;
+        }
+
+        // Asks the allocator to return free pages to the OS; a no-op unless
+        // it's glibc's.
+        static void releaseFreeMemory() {
+#ifdef __GLIBC__
+            malloc_trim(0);
+#endif
+        }
+
+        void clearSmall() {
+            for (std::size_t i = 0; i < smallSize(); ++i)
+                delete smallItems[i];
+        }
+
+        template <typename ForwardIt, typename OutputIt, typename Result>
+        OutputIt findBatchHelper(ForwardIt keysFirst, ForwardIt keysLast, OutputIt out, Result result) const {
+            if (isSmall()) {
+                for (; keysFirst != keysLast; ++keysFirst)
+                    *out++ = result(findSmall(*keysFirst));
+                return out;
+            }
+            std::size_t idx[BATCH_WINDOW], hashes[BATCH_WINDOW];
+            ForwardIt keys[BATCH_WINDOW];
+            while (keysFirst != keysLast) {
+                std::size_t n = 0;
+                for (; n < BATCH_WINDOW && keysFirst != keysLast; ++n, ++keysFirst) {
+                    keys[n] = keysFirst;
+                    hashes[n] = hashOf(*keysFirst);
+                    idx[n] = positionOf(hashes[n]);
+                    AISDI_PREFETCH(&bucketAt(idx[n]));
+                }
+                for (std::size_t i = 0; i < n; ++i)
+                    AISDI_PREFETCH(bucketAt(idx[i]).getRoot());
+                for (std::size_t i = 0; i < n; ++i)
+                    *out++ = result(bucketAt(idx[i]).findNodeWithKey(*keys[i], hashes[i]));
+            }
+            return out;
+        }
 
     };
 
+    template<typename KeyType, typename ValueType>
+    constexpr std::size_t HashMap<KeyType, ValueType>::BUCKETS_NUMBER;
+
+    template<typename KeyType, typename ValueType>
+    constexpr std::size_t HashMap<KeyType, ValueType>::SMALL_CAPACITY;
+
+    template<typename KeyType, typename ValueType>
+    constexpr std::size_t HashMap<KeyType, ValueType>::MAX_LOAD_FACTOR;
+
+    template<typename KeyType, typename ValueType>
+    constexpr std::size_t HashMap<KeyType, ValueType>::PREPARE_STEP;
+
+    template<typename KeyType, typename ValueType>
+    constexpr std::size_t HashMap<KeyType, ValueType>::MIGRATION_STEP;
+
     template<typename KeyType, typename ValueType>
     class HashMap<KeyType, ValueType>::ConstIterator {
         friend class HashMap<KeyType, ValueType>;
 
         using BSTNode = HashMap<KeyType, ValueType>::node;
         const HashMap<KeyType, ValueType>& map;
-        typename std::vector<BST<KeyType, ValueType>>::const_iterator vecIt;
-        const BST<KeyType, ValueType> *tree;
+        std::size_t bucket; // position of the node's bucket, see positionOf()
         BSTNode *node;
         bool end;
+
+        // Position of the node in a small map, or its size at the end. Looked
+        // up, not kept, as removing an item shifts the ones after it down.
+        std::size_t smallPosition() const {
+            std::size_t position = 0;
+            while (position < map.size && map.smallItems[position] != node) ++position;
+            return position;
+        }
     public:
         using reference = typename HashMap::const_reference;
         using iterator_category = std::bidirectional_iterator_tag;
         using value_type = typename HashMap::value_type;
+        using difference_type = std::ptrdiff_t;
         using pointer = const typename HashMap::value_type*;
 
         explicit ConstIterator(const HashMap<KeyType, ValueType>& m,
-                               typename std::vector<BST<KeyType, ValueType>>::const_iterator v,
-                               const BST<KeyType, ValueType> *t,
+                               std::size_t b,
                                BSTNode *n,
                                bool e)
-            : map(m), vecIt(v), tree(t), node(n), end(e)
+            : map(m), bucket(b), node(n), end(e)
         { }
 
         ConstIterator(const ConstIterator& other)
-            : map(other.map), vecIt(other.vecIt), tree(other.tree), node(other.node), end(other.end)
+            : map(other.map), bucket(other.bucket), node(other.node), end(other.end)
         { }
 
         ConstIterator& operator++() {
             if (end) throw std::out_of_range("");
+            if (map.isSmall()) {
+                std::size_t next = smallPosition() + 1;
+                end = next >= map.size;
+                node = end ? nullptr : map.smallItems[next];
+                return *this;
+            }
             try {
-                node = tree->getNextNode(node);
+                node = map.bucketAt(bucket).getNextNode(node);
             } catch (std::out_of_range& e) {
-                ++vecIt;
-                while (vecIt != map.hashTable.end() && vecIt->isEmpty()) ++vecIt;
-                if (vecIt == map.hashTable.end()) {
-                    --vecIt;
+                std::size_t span = map.bucketsSpan();
+                ++bucket;
+                while (bucket != span && map.bucketAt(bucket).isEmpty()) ++bucket;
+                if (bucket == span) {
+                    --bucket;
                     end = true;
                 }
-                tree = &*vecIt;
-                node = tree->getFirstNode();
+                node = end ? nullptr : map.bucketAt(bucket).getFirstNode();
             }
             return *this;
         }
@@ -276,15 +884,26 @@ namespace aisdi {
         }
 
         ConstIterator& operator--() {
+            if (map.isSmall()) {
+                std::size_t position = end ? map.size : smallPosition();
+                if (!position) throw std::out_of_range("");
+                node = map.smallItems[position - 1];
+                end = false;
+                return *this;
+            }
             try {
-                if (end || !tree) throw std::out_of_range("");
-                node = tree->getPreviousNode(node);
+                if (end) throw std::out_of_range("");
+                node = map.bucketAt(bucket).getPreviousNode(node);
             } catch (std::out_of_range&) {
-                if (!end) --vecIt; // because if it was end, we are already at proper position
-                while (vecIt != map.hashTable.begin() && vecIt->isEmpty()) --vecIt;
-                tree = &*vecIt;
-                node = tree->getLastNode();
-                if (vecIt == map.hashTable.begin() && vecIt->isEmpty()) throw;
+                std::size_t previous = bucket;
+                if (!end) { // if it was end, we are already at proper position
+                    if (!previous) throw;
+                    --previous;
+                }
+                while (previous && map.bucketAt(previous).isEmpty()) --previous;
+                if (map.bucketAt(previous).isEmpty()) throw;
+                bucket = previous;
+                node = map.bucketAt(bucket).getLastNode();
             }
             end = false;
             return *this;
@@ -321,11 +940,10 @@ namespace aisdi {
         using pointer = typename HashMap::value_type*;
 
         explicit Iterator(const HashMap<KeyType, ValueType>& m,
-                          typename std::vector<BST<KeyType, ValueType>>::const_iterator v,
-                          const BST<KeyType, ValueType> *t,
+                          std::size_t b,
                           node *n,
                           bool e)
-            : ConstIterator(m, v, t, n, e)
+            : ConstIterator(m, b, n, e)
         { }
 
         Iterator(const ConstIterator& other)
@@ -0,0 +1,433 @@
+#ifndef AISDI_MAPS_JOURNAL_H
+#define AISDI_MAPS_JOURNAL_H
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Serialization.h"
+
+namespace aisdi {
+
+struct JournalOptions {
+    // Every record is written to the file as it comes, so it survives the
+    // process crashing. Group commit: records are fsync'ed together, to
+    // survive the machine crashing too, by the first record coming this long
+    // after the last sync, or once bufferBytes were written since it. Zero
+    // syncs every record. Nothing syncs on a timer: after the last record of
+    // a burst, call sync() (or close the journal) for it to be durable.
+    std::chrono::milliseconds syncInterval{10};
+    std::size_t bufferBytes = 1 << 20;
+    // JournaledMap compacts into a snapshot when the journal outgrows this.
+    std::uint64_t compactAfterBytes = std::uint64_t(256) << 20;
+};
+
+// Operation read back from a journal; first/second as in a map's items, so a
+// run of assignments can go straight to a batch insert.
+template <typename KeyType, typename ValueType>
+struct JournalRecord {
+    KeyType first;
+    ValueType second;
+    bool removal;
+};
+
+// Append-only log of assignments and removals, for recovering a map after a
+// crash. Record layout, native byte order:
+//   payload bytes u32 | kind u8 | key [| value] | checksum u64 of all before it
+// A record cut short or failing its checksum ends the journal - it's the torn
+// tail of an interrupted write and is cut off by replay().
+//
+// replay() must be called once before anything is recorded.
+template <typename KeyType, typename ValueType>
+class Journal {
+    static constexpr char MAGIC[8] = { 'A', 'I', 'S', 'D', 'I', 'J', 'N', 'L' };
+    static constexpr std::uint32_t VERSION = 1;
+    static constexpr std::size_t HEADER_BYTES = sizeof(MAGIC) + 3 * sizeof(std::uint32_t);
+    static constexpr std::size_t RECORD_OVERHEAD = sizeof(std::uint32_t) + 1 + sizeof(std::uint64_t);
+    static constexpr unsigned char ASSIGNMENT = 1, REMOVAL = 2;
+
+    const std::string path;
+    const JournalOptions options;
+    int fd = -1;
+    std::vector<char> encoded; // record being appended
+    std::uint64_t bytes = 0; // in the file
+    std::uint64_t unsynced = 0; // written since the last sync
+    bool replayed = false;
+    std::chrono::steady_clock::time_point lastSync;
+
+public:
+    using Record = JournalRecord<KeyType, ValueType>;
+
+    // Opens the journal at path, creating it if missing. Throws
+    // std::system_error on I/O errors and SnapshotError if the file is not a
+    // journal of these types.
+    explicit Journal(const std::string& journalPath, JournalOptions journalOptions = JournalOptions())
+        : path(journalPath), options(journalOptions), lastSync(std::chrono::steady_clock::now())
+    {
+        fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (fd < 0) fail("open");
+        try {
+            struct stat status;
+            if (::fstat(fd, &status) < 0) fail("stat");
+            if (status.st_size == 0) {
+                std::vector<char> header;
+                header.insert(header.end(), MAGIC, MAGIC + sizeof(MAGIC));
+                Serializer<std::uint32_t>::write(header, VERSION);
+                Serializer<std::uint32_t>::write(header, Serializer<KeyType>::FIXED_SIZE);
+                Serializer<std::uint32_t>::write(header, Serializer<ValueType>::FIXED_SIZE);
+                writeAll(header.data(), header.size());
+                if (::fsync(fd) < 0) fail("fsync");
+            }
+            bytes = status.st_size ? status.st_size : HEADER_BYTES;
+        } catch (...) {
+            ::close(fd);
+            throw;
+        }
+    }
+
+    Journal(const Journal&) = delete;
+    Journal& operator=(const Journal&) = delete;
+
+    // Syncs what was written since the last sync; errors can't be reported
+    // from here, so call sync() first where they matter.
+    ~Journal() {
+        try {
+            sync();
+        } catch (...) { }
+        if (fd >= 0) ::close(fd);
+    }
+
+    // Calls apply(const std::vector<Record>&) with the journal's records in
+    // order, a batch per megabyte of the file. Cuts off a torn tail.
+    // Returns the number of records.
+    template <typename Apply>
+    std::uint64_t replay(Apply apply) {
+        const std::size_t CHUNK = 1 << 20;
+        std::vector<char> buffer;
+        std::vector<Record> batch;
+        std::uint64_t records = 0, valid = HEADER_BYTES, offset = 0;
+        std::size_t parsed = 0;
+        bool end = false, headerChecked = false;
+        while (!end) {
+            // keep the unparsed rest, add a chunk
+            buffer.erase(buffer.begin(), buffer.begin() + parsed);
+            parsed = 0;
+            std::size_t kept = buffer.size();
+            buffer.resize(kept + CHUNK);
+            ssize_t got = ::pread(fd, buffer.data() + kept, CHUNK, offset);
+            if (got < 0) fail("read");
+            buffer.resize(kept + got);
+            offset += got;
+            end = got == 0;
+
+            if (!headerChecked) {
+                if (buffer.size() < HEADER_BYTES) {
+                    if (end) throw SnapshotError("journal header truncated: " + path);
+                    continue;
+                }
+                checkHeader(buffer.data());
+                parsed = HEADER_BYTES;
+                headerChecked = true;
+            }
+            batch.clear();
+            std::size_t length;
+            while ((length = parseRecord(buffer.data() + parsed, buffer.data() + buffer.size(), batch))) {
+                parsed += length;
+                valid += length;
+            }
+            if (!batch.empty()) {
+                records += batch.size();
+                apply(batch);
+            }
+            // an unparsable record before the end of the file can't complete any more
+            if (buffer.size() - parsed >= RECORD_OVERHEAD && !recordMayComplete(buffer.data() + parsed,
+                                                                                buffer.size() - parsed))
+                end = true;
+        }
+        if (valid < offset) {
+            if (::ftruncate(fd, valid) < 0) fail("truncate");
+            if (::fsync(fd) < 0) fail("fsync");
+        }
+        bytes = valid;
+        replayed = true;
+        return records;
+    }
+
+    void recordAssignment(const KeyType& key, const ValueType& value) {
+        append(ASSIGNMENT, [&]() {
+            Serializer<KeyType>::write(encoded, key);
+            Serializer<ValueType>::write(encoded, value);
+        });
+    }
+
+    void recordRemoval(const KeyType& key) {
+        append(REMOVAL, [&]() {
+            Serializer<KeyType>::write(encoded, key);
+        });
+    }
+
+    // Fsyncs the records written since the last sync; they are durable once
+    // it returns.
+    void sync() {
+        if (unsynced) {
+            if (::fdatasync(fd) < 0) fail("fsync");
+            unsynced = 0;
+        }
+        lastSync = std::chrono::steady_clock::now();
+    }
+
+    // Drops every record, e.g. once a snapshot holds their effect.
+    void reset() {
+        if (::ftruncate(fd, HEADER_BYTES) < 0) fail("truncate");
+        if (::fsync(fd) < 0) fail("fsync");
+        bytes = HEADER_BYTES;
+        unsynced = 0;
+    }
+
+    // size of the journal, records not synced yet included
+    std::uint64_t getBytes() const {
+        return bytes;
+    }
+
+private:
+    [[noreturn]] void fail(const char *operation) const {
+        throw std::system_error(errno, std::generic_category(), std::string(operation) + " " + path);
+    }
+
+    void writeAll(const char *data, std::size_t n) {
+        while (n) {
+            ssize_t written = ::write(fd, data, n);
+            if (written < 0) {
+                if (errno == EINTR) continue;
+                fail("write");
+            }
+            data += written;
+            n -= written;
+        }
+    }
+
+    void checkHeader(const char *header) const {
+        if (!std::equal(MAGIC, MAGIC + sizeof(MAGIC), header))
+            throw SnapshotError("not a journal: " + path);
+        std::uint32_t fields[3];
+        std::memcpy(fields, header + sizeof(MAGIC), sizeof(fields));
+        if (fields[0] != VERSION) throw SnapshotError("unsupported journal version: " + path);
+        if (fields[1] != Serializer<KeyType>::FIXED_SIZE || fields[2] != Serializer<ValueType>::FIXED_SIZE)
+            throw SnapshotError("journal of different key or value type: " + path);
+    }
+
+    template <typename WritePayload>
+    void append(unsigned char kind, WritePayload writePayload) {
+        if (!replayed) throw std::logic_error("journal recorded to before replay");
+        encoded.clear();
+        Serializer<std::uint32_t>::write(encoded, 0); // patched below
+        encoded.push_back(static_cast<char>(kind));
+        writePayload();
+        std::uint32_t payload = encoded.size() - sizeof(std::uint32_t) - 1;
+        std::memcpy(encoded.data(), &payload, sizeof(payload));
+        Checksum checksum;
+        checksum.update(encoded.data(), encoded.size());
+        Serializer<std::uint64_t>::write(encoded, checksum.value());
+        // a write cut short leaves a torn tail, which replay() cuts off
+        writeAll(encoded.data(), encoded.size());
+        bytes += encoded.size();
+        unsynced += encoded.size();
+
+        if (options.syncInterval.count() == 0 || unsynced >= options.bufferBytes
+            || std::chrono::steady_clock::now() - lastSync >= options.syncInterval)
+            sync();
+    }
+
+    // whether the bytes could be the start of a record not fully read yet
+    static bool recordMayComplete(const char *data, std::size_t available) {
+        std::uint32_t payload;
+        std::memcpy(&payload, data, sizeof(payload));
+        return available < RECORD_OVERHEAD + payload;
+    }
+
+    // Decodes the record at data into batch; returns its length, or 0 if
+    // there is no whole valid record there.
+    static std::size_t parseRecord(const char *data, const char *end, std::vector<Record>& batch) {
+        if (static_cast<std::size_t>(end - data) < RECORD_OVERHEAD) return 0;
+        std::uint32_t payload;
+        std::memcpy(&payload, data, sizeof(payload));
+        std::size_t length = RECORD_OVERHEAD + payload;
+        if (static_cast<std::size_t>(end - data) < length) return 0;
+        Checksum checksum;
+        checksum.update(data, length - sizeof(std::uint64_t));
+        std::uint64_t stored;
+        std::memcpy(&stored, data + length - sizeof(stored), sizeof(stored));
+        if (stored != checksum.value()) return 0;
+
+        unsigned char kind = data[sizeof(std::uint32_t)];
+        const char *position = data + sizeof(std::uint32_t) + 1;
+        const char *payloadEnd = data + length - sizeof(std::uint64_t);
+        batch.emplace_back();
+        Record& record = batch.back();
+        try {
+            position = Serializer<KeyType>::readRun(position, payloadEnd, &record.first, 1);
+            if (kind == ASSIGNMENT)
+                position = Serializer<ValueType>::readRun(position, payloadEnd, &record.second, 1);
+            else if (kind != REMOVAL)
+                throw SnapshotError("unknown journal record");
+            if (position != payloadEnd) throw SnapshotError("journal record damaged");
+        } catch (SnapshotError&) {
+            batch.pop_back();
+            return 0;
+        }
+        record.removal = kind == REMOVAL;
+        return length;
+    }
+};
+
+template <typename KeyType, typename ValueType>
+constexpr char Journal<KeyType, ValueType>::MAGIC[8];
+
+template <typename KeyType, typename ValueType>
+constexpr std::uint32_t Journal<KeyType, ValueType>::VERSION;
+
+template <typename KeyType, typename ValueType>
+constexpr std::size_t Journal<KeyType, ValueType>::HEADER_BYTES;
+
+template <typename KeyType, typename ValueType>
+constexpr std::size_t Journal<KeyType, ValueType>::RECORD_OVERHEAD;
+
+template <typename KeyType, typename ValueType>
+constexpr unsigned char Journal<KeyType, ValueType>::ASSIGNMENT;
+
+template <typename KeyType, typename ValueType>
+constexpr unsigned char Journal<KeyType, ValueType>::REMOVAL;
+
+// Map (HashMap or TreeMap) kept durable by a snapshot plus a journal of the
+// changes made since. Opening recovers the map from both; compact() - also
+// run when the journal grows past JournalOptions::compactAfterBytes - saves a
+// fresh snapshot and empties the journal.
+//
+// Replaying a journal over a snapshot that already holds some of its records
+// gives the same map, so a crash between the two steps of compaction is safe.
+template <typename Map>
+class JournaledMap {
+    using KeyType = typename Map::key_type;
+    using ValueType = typename Map::mapped_type;
+
+    const std::string snapshotPath;
+    const JournalOptions options;
+    Map map;
+    Journal<KeyType, ValueType> journal;
+
+public:
+    JournaledMap(const std::string& snapshot, const std::string& journalPath,
+                 JournalOptions journalOptions = JournalOptions())
+        : snapshotPath(snapshot), options(journalOptions), journal(journalPath, journalOptions)
+    {
+        std::ifstream in(snapshotPath, std::ios::binary);
+        if (in) map.load(in);
+        journal.replay([this](const std::vector<JournalRecord<KeyType, ValueType>>& batch) {
+            applyBatch(batch);
+        });
+    }
+
+    const Map& getMap() const {
+        return map;
+    }
+
+    template <typename Kk, typename Vv>
+    void assign(Kk&& key, Vv&& value) {
+        journal.recordAssignment(key, value);
+        map[std::forward<Kk>(key)] = std::forward<Vv>(value);
+        compactIfDue();
+    }
+
+    // Throws std::out_of_range, recording nothing, if the key is absent.
+    void remove(const KeyType& key) {
+        if (map.find(key) == map.end()) throw std::out_of_range("delete unexistent item");
+        journal.recordRemoval(key);
+        map.remove(key);
+        compactIfDue();
+    }
+
+    void sync() {
+        journal.sync();
+    }
+
+    // Writes the snapshot next to the old one, syncs it, renames it over and
+    // empties the journal.
+    void compact() {
+        journal.sync();
+        std::string temporary = snapshotPath + ".tmp";
+        {
+            std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+            map.save(out);
+            out.close();
+            if (!out) throw SnapshotError("snapshot write failed: " + temporary);
+        }
+        syncPath(temporary);
+        if (std::rename(temporary.c_str(), snapshotPath.c_str()) < 0)
+            throw std::system_error(errno, std::generic_category(), "rename " + temporary);
+        std::string::size_type slash = snapshotPath.rfind('/');
+        syncPath(slash == std::string::npos ? "." : snapshotPath.substr(0, slash + 1));
+        journal.reset();
+    }
+
+private:
+    void compactIfDue() {
+        if (journal.getBytes() > options.compactAfterBytes) compact();
+    }
+
+    static void syncPath(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0 || ::fsync(fd) < 0) {
+            int error = errno;
+            if (fd >= 0) ::close(fd);
+            throw std::system_error(error, std::generic_category(), "fsync " + path);
+        }
+        ::close(fd);
+    }
+
+    template <typename M, typename ForwardIt>
+    static auto assignRun(M& m, ForwardIt first, ForwardIt last, int)
+        -> decltype(m.insertBatch(first, last), void()) {
+        m.insertBatch(first, last);
+    }
+
+    template <typename M, typename ForwardIt>
+    static void assignRun(M& m, ForwardIt first, ForwardIt last, long) {
+        for (; first != last; ++first)
+            m[first->first] = first->second;
+    }
+
+    // runs of assignments go in as a batch where the map has batch inserts
+    void applyBatch(const std::vector<JournalRecord<KeyType, ValueType>>& batch) {
+        auto run = batch.begin();
+        while (run != batch.end()) {
+            if (run->removal) {
+                // already gone if the snapshot is newer than the record
+                if (map.find(run->first) != map.end()) map.remove(run->first);
+                ++run;
+                continue;
+            }
+            auto runEnd = std::find_if(run, batch.end(),
+                                       [](const JournalRecord<KeyType, ValueType>& r) { return r.removal; });
+            assignRun(map, run, runEnd, 0);
+            run = runEnd;
+        }
+    }
+};
+
+}
+
+#endif /* AISDI_MAPS_JOURNAL_H */
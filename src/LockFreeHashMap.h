@@ -0,0 +1,238 @@
+#ifndef AISDI_MAPS_LOCKFREEHASHMAP_H
+#define AISDI_MAPS_LOCKFREEHASHMAP_H
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#include "EpochReclamation.h"
+
+namespace aisdi {
+
+    // Hash map with a lock-free read path, for read-mostly sharing between threads.
+    //
+    // Every bucket is a singly linked list of immutable nodes. Readers pin an
+    // epoch and walk the list with acquire loads - no locks, no writes to shared
+    // memory. Writers serialize per stripe of buckets, build a complete node and
+    // publish it with a single release store; an overwritten or removed node is
+    // retired to the EpochDomain, pinned like a reader, and freed once no reader
+    // can still see it.
+    //
+    // Values are handed out by copy (or to a visitor) as with ConcurrentHashMap;
+    // valueOf()/find() otherwise follow HashMap - valueOf() throws
+    // std::out_of_range for a missing key.
+    template<typename KeyType, typename ValueType>
+    class LockFreeHashMap {
+    public:
+        using key_type = KeyType;
+        using mapped_type = ValueType;
+        using value_type = std::pair<const key_type, mapped_type>;
+        using size_type = std::size_t;
+
+    private:
+        struct Node {
+            const value_type value;
+            std::atomic<Node*> next;
+
+            template <typename Kk, typename Vv>
+            Node(Kk&& k, Vv&& v, Node *n)
+                : value(std::forward<Kk>(k), std::forward<Vv>(v)), next(n)
+            { }
+        };
+
+        struct WriterStripe {
+            char paddingBefore[64];
+            std::mutex lock;
+            std::atomic<std::size_t> size{0};
+            char paddingAfter[64];
+        };
+
+        const std::size_t bucketsNumber;
+        std::unique_ptr<std::atomic<Node*>[]> buckets;
+        std::unique_ptr<WriterStripe[]> stripes;
+        const std::size_t stripesNumber;
+        EpochDomain& epochs;
+
+    public:
+        static constexpr std::size_t DEFAULT_STRIPES = 64;
+        static constexpr std::size_t DEFAULT_BUCKETS = 15693;
+
+        explicit LockFreeHashMap(std::size_t stripesCount = DEFAULT_STRIPES,
+                                 std::size_t bucketsCount = DEFAULT_BUCKETS)
+            : bucketsNumber(bucketsCount),
+              buckets(new std::atomic<Node*>[bucketsCount]),
+              stripes(new WriterStripe[stripesCount < bucketsCount ? stripesCount : bucketsCount]),
+              stripesNumber(stripesCount < bucketsCount ? stripesCount : bucketsCount),
+              epochs(EpochDomain::global())
+        {
+            if (!stripesCount || !bucketsCount)
+                throw std::invalid_argument("stripes and buckets number must be positive");
+            for (std::size_t i = 0; i < bucketsNumber; ++i)
+                buckets[i].store(nullptr, std::memory_order_relaxed);
+        }
+
+        LockFreeHashMap(const LockFreeHashMap&) = delete;
+        LockFreeHashMap& operator=(const LockFreeHashMap&) = delete;
+
+        // No thread may use the map concurrently with its destruction.
+        ~LockFreeHashMap() {
+            for (std::size_t i = 0; i < bucketsNumber; ++i)
+                deleteChain(buckets[i].load(std::memory_order_relaxed));
+        }
+
+        // Calls fn(const mapped_type&) while the node is guaranteed alive.
+        template <typename Fn>
+        bool visit(const key_type& key, Fn&& fn) const {
+            EpochDomain::Guard guard(epochs);
+            const Node *n = findNode(key);
+            if (!n) return false;
+            fn(n->value.second);
+            return true;
+        }
+
+        bool find(const key_type& key, mapped_type& out) const {
+            return visit(key, [&out](const mapped_type& value) { out = value; });
+        }
+
+        bool contains(const key_type& key) const {
+            return visit(key, [](const mapped_type&) { });
+        }
+
+        mapped_type valueOf(const key_type& key) const {
+            EpochDomain::Guard guard(epochs);
+            const Node *n = findNode(key);
+            if (!n) throw std::out_of_range("el doesn't exist");
+            return n->value.second;
+        }
+
+        // Inserts the pair if the key is absent. Returns false if it was present.
+        template <typename Kk, typename Vv>
+        bool insert(Kk&& key, Vv&& value) {
+            std::size_t idx = bucketOf(key);
+            WriterStripe& stripe = stripeOf(idx);
+            std::lock_guard<std::mutex> lock(stripe.lock);
+            std::atomic<Node*> *link = findLink(idx, key);
+            if (link->load(std::memory_order_relaxed))
+                return false;
+            Node *head = buckets[idx].load(std::memory_order_relaxed);
+            buckets[idx].store(new Node(std::forward<Kk>(key), std::forward<Vv>(value), head),
+                               std::memory_order_release);
+            stripe.size.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+
+        // Equivalent of HashMap's map[key] = value. The old node is replaced,
+        // not modified, so readers see either the old or the new value.
+        template <typename Kk, typename Vv>
+        void assign(Kk&& key, Vv&& value) {
+            EpochDomain::Guard guard(epochs); // for retire()
+            std::size_t idx = bucketOf(key);
+            WriterStripe& stripe = stripeOf(idx);
+            std::lock_guard<std::mutex> lock(stripe.lock);
+            std::atomic<Node*> *link = findLink(idx, key);
+            Node *old = link->load(std::memory_order_relaxed);
+            if (!old) {
+                Node *head = buckets[idx].load(std::memory_order_relaxed);
+                buckets[idx].store(new Node(std::forward<Kk>(key), std::forward<Vv>(value), head),
+                                   std::memory_order_release);
+                stripe.size.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            Node *replacement = new Node(std::forward<Kk>(key), std::forward<Vv>(value),
+                                         old->next.load(std::memory_order_relaxed));
+            link->store(replacement, std::memory_order_release);
+            epochs.retire(old);
+        }
+
+        // Returns false if key was absent.
+        bool remove(const key_type& key) {
+            EpochDomain::Guard guard(epochs); // for retire()
+            std::size_t idx = bucketOf(key);
+            WriterStripe& stripe = stripeOf(idx);
+            std::lock_guard<std::mutex> lock(stripe.lock);
+            std::atomic<Node*> *link = findLink(idx, key);
+            Node *old = link->load(std::memory_order_relaxed);
+            if (!old) return false;
+            link->store(old->next.load(std::memory_order_relaxed), std::memory_order_release);
+            stripe.size.fetch_sub(1, std::memory_order_relaxed);
+            epochs.retire(old);
+            return true;
+        }
+
+        void clear() {
+            EpochDomain::Guard guard(epochs); // for retire()
+            for (std::size_t s = 0; s < stripesNumber; ++s) {
+                std::lock_guard<std::mutex> lock(stripes[s].lock);
+                for (std::size_t idx = s; idx < bucketsNumber; idx += stripesNumber) {
+                    Node *n = buckets[idx].exchange(nullptr, std::memory_order_acq_rel);
+                    while (n) {
+                        Node *next = n->next.load(std::memory_order_relaxed);
+                        epochs.retire(n);
+                        n = next;
+                    }
+                }
+                stripes[s].size.store(0, std::memory_order_relaxed);
+            }
+        }
+
+        size_type getSize() const {
+            size_type result = 0;
+            for (std::size_t s = 0; s < stripesNumber; ++s)
+                result += stripes[s].size.load(std::memory_order_relaxed);
+            return result;
+        }
+
+        bool isEmpty() const {
+            return !getSize();
+        }
+
+    private:
+        std::size_t bucketOf(const key_type& key) const {
+            return std::hash<KeyType>()(key) % bucketsNumber;
+        }
+
+        WriterStripe& stripeOf(std::size_t bucket) {
+            return stripes[bucket % stripesNumber];
+        }
+
+        // caller must be pinned
+        const Node* findNode(const key_type& key) const {
+            const Node *n = buckets[bucketOf(key)].load(std::memory_order_acquire);
+            while (n && !(n->value.first == key))
+                n = n->next.load(std::memory_order_acquire);
+            return n;
+        }
+
+        // Link pointing at the node with key, or the terminating null link.
+        // Caller holds the bucket's writer stripe.
+        std::atomic<Node*>* findLink(std::size_t idx, const key_type& key) {
+            std::atomic<Node*> *link = &buckets[idx];
+            for (Node *n = link->load(std::memory_order_relaxed); n; n = link->load(std::memory_order_relaxed)) {
+                if (n->value.first == key) break;
+                link = &n->next;
+            }
+            return link;
+        }
+
+        static void deleteChain(Node *n) {
+            while (n) {
+                Node *next = n->next.load(std::memory_order_relaxed);
+                delete n;
+                n = next;
+            }
+        }
+    };
+
+    template<typename KeyType, typename ValueType>
+    constexpr std::size_t LockFreeHashMap<KeyType, ValueType>::DEFAULT_STRIPES;
+
+    template<typename KeyType, typename ValueType>
+    constexpr std::size_t LockFreeHashMap<KeyType, ValueType>::DEFAULT_BUCKETS;
+
+}
+
+#endif /* AISDI_MAPS_LOCKFREEHASHMAP_H */
@@ -0,0 +1,250 @@
+#ifndef AISDI_MAPS_LRUCACHE_H
+#define AISDI_MAPS_LRUCACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+
+#include "HashMap.h"
+#include "RecencyList.h"
+
+namespace aisdi {
+
+// Eviction policies of LruCache.
+struct LruEviction { };          // least recently used goes first
+struct ClockEviction { };        // second chance: a hit only sets a bit, no relinking
+struct SegmentedLruEviction { }; // LRU with a probation segment, resisting scans
+
+struct CacheStats {
+    std::uint64_t hits = 0;
+    std::uint64_t misses = 0;
+    std::uint64_t evictions = 0;
+
+    double hitRate() const {
+        return hits + misses ? double(hits) / (hits + misses) : 0.0;
+    }
+};
+
+// Value of a cached item, with its links in the eviction order - the order
+// lives in the HashMap's own nodes, so it costs no allocation of its own.
+template<typename KeyType, typename ValueType>
+struct CacheEntry {
+    using Item = std::pair<const KeyType, CacheEntry>;
+
+    ValueType value;
+    Item *prev = nullptr;
+    Item *next = nullptr;
+    bool mark = false; // CLOCK: referenced, SLRU: in the protected segment
+};
+
+// Order in which a policy evicts: insert() links a new item, touch() records
+// a hit, unlink() forgets an item and victim() unlinks the next one to go.
+template<typename Policy, typename Item>
+class EvictionOrder;
+
+template<typename Item>
+class EvictionOrder<LruEviction, Item> {
+    RecencyList<Item> list;
+public:
+    explicit EvictionOrder(std::size_t) { }
+
+    void insert(Item *item) {
+        list.pushFront(item);
+    }
+
+    void touch(Item *item) {
+        if (list.front() == item) return;
+        list.unlink(item);
+        list.pushFront(item);
+    }
+
+    void unlink(Item *item) {
+        list.unlink(item);
+    }
+
+    Item* victim() {
+        Item *item = list.back();
+        list.unlink(item);
+        return item;
+    }
+};
+
+// The list runs in the order of the clock hand, starting at it: passing a
+// referenced item clears its bit and moves it behind the hand.
+template<typename Item>
+class EvictionOrder<ClockEviction, Item> {
+    RecencyList<Item> list;
+public:
+    explicit EvictionOrder(std::size_t) { }
+
+    void insert(Item *item) {
+        item->second.mark = false;
+        list.pushBack(item);
+    }
+
+    void touch(Item *item) {
+        item->second.mark = true;
+    }
+
+    void unlink(Item *item) {
+        list.unlink(item);
+    }
+
+    Item* victim() {
+        Item *item = list.front();
+        while (item->second.mark) {
+            item->second.mark = false;
+            list.unlink(item);
+            list.pushBack(item);
+            item = list.front();
+        }
+        list.unlink(item);
+        return item;
+    }
+};
+
+// New items are on probation; a hit there promotes them to the protected
+// segment (4/5 of the capacity), whose least recent are demoted back. A scan
+// of one-off keys thus only churns the probation segment.
+template<typename Item>
+class EvictionOrder<SegmentedLruEviction, Item> {
+    RecencyList<Item> probation;
+    RecencyList<Item> protectedSegment;
+    const std::size_t protectedCapacity;
+public:
+    explicit EvictionOrder(std::size_t capacity)
+        : protectedCapacity(capacity - capacity / 5)
+    { }
+
+    void insert(Item *item) {
+        item->second.mark = false;
+        probation.pushFront(item);
+    }
+
+    void touch(Item *item) {
+        if (!item->second.mark) {
+            probation.unlink(item);
+            item->second.mark = true;
+            protectedSegment.pushFront(item);
+            if (protectedSegment.getSize() > protectedCapacity) {
+                Item *demoted = protectedSegment.back();
+                protectedSegment.unlink(demoted);
+                demoted->second.mark = false;
+                probation.pushFront(demoted);
+            }
+        } else if (protectedSegment.front() != item) {
+            protectedSegment.unlink(item);
+            protectedSegment.pushFront(item);
+        }
+    }
+
+    void unlink(Item *item) {
+        (item->second.mark ? protectedSegment : probation).unlink(item);
+    }
+
+    Item* victim() {
+        RecencyList<Item>& from = probation.getSize() ? probation : protectedSegment;
+        Item *item = from.back();
+        from.unlink(item);
+        return item;
+    }
+};
+
+// HashMap of at most capacity items; a put beyond it evicts one item, chosen
+// by Policy. get() and put() are O(1) and allocate nothing besides the
+// HashMap's node of a new item.
+template<typename KeyType, typename ValueType, typename Policy = LruEviction>
+class LruCache {
+    using Entry = CacheEntry<KeyType, ValueType>;
+    using Item = typename Entry::Item;
+
+    HashMap<KeyType, Entry> map;
+    EvictionOrder<Policy, Item> order;
+    const std::size_t capacity;
+    CacheStats stats;
+public:
+    using key_type = KeyType;
+    using mapped_type = ValueType;
+    using size_type = std::size_t;
+
+    explicit LruCache(std::size_t maxItems)
+        : order(maxItems), capacity(maxItems)
+    {
+        if (!maxItems) throw std::invalid_argument("cache of no items");
+    }
+
+    // The order points into the map's nodes.
+    LruCache(const LruCache&) = delete;
+    LruCache& operator=(const LruCache&) = delete;
+
+    // Pointer to the cached value, or nullptr; counts as a use of the item.
+    // Valid until the item is evicted or removed.
+    mapped_type* get(const key_type& key) {
+        Item *item = map.findItem(key);
+        if (!item) {
+            ++stats.misses;
+            return nullptr;
+        }
+        ++stats.hits;
+        order.touch(item);
+        return &item->second.value;
+    }
+
+    // Doesn't count as a use.
+    bool contains(const key_type& key) const {
+        return map.findItem(key) != nullptr;
+    }
+
+    template <typename Kk, typename Vv>
+    void put(Kk&& key, Vv&& value) {
+        auto found = map.findOrInsert(std::forward<Kk>(key));
+        Item *item = found.first;
+        if (!found.second) {
+            item->second.value = std::forward<Vv>(value);
+            order.touch(item);
+            return;
+        }
+        try {
+            item->second.value = std::forward<Vv>(value);
+        } catch (...) {
+            map.remove(item->first);
+            throw;
+        }
+        // the new item isn't in the order yet, so it can't be the victim
+        if (map.getSize() > capacity) {
+            map.remove(order.victim()->first);
+            ++stats.evictions;
+        }
+        order.insert(item);
+    }
+
+    // Returns false if key wasn't cached.
+    bool remove(const key_type& key) {
+        Item *item = map.findItem(key);
+        if (!item) return false;
+        order.unlink(item);
+        map.remove(item->first);
+        return true;
+    }
+
+    size_type getSize() const {
+        return map.getSize();
+    }
+
+    size_type getCapacity() const {
+        return capacity;
+    }
+
+    bool isEmpty() const {
+        return map.isEmpty();
+    }
+
+    const CacheStats& getStats() const {
+        return stats;
+    }
+};
+
+}
+
+#endif /* AISDI_MAPS_LRUCACHE_H */
@@ -0,0 +1,509 @@
+#ifndef AISDI_MAPS_MAPPEDMAP_H
+#define AISDI_MAPS_MAPPEDMAP_H
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "bst.h"
+#include "Serialization.h"
+
+namespace aisdi {
+
+// Characters of a string stored in a mapped file; valid while the file is mapped.
+class MappedString {
+    const char *chars;
+    std::size_t length;
+public:
+    MappedString(const char *c, std::size_t l)
+        : chars(c), length(l)
+    { }
+
+    const char* data() const {
+        return chars;
+    }
+
+    std::size_t size() const {
+        return length;
+    }
+
+    std::string str() const {
+        return std::string(chars, length);
+    }
+
+    int compare(const char *other, std::size_t otherLength) const {
+        int cmp = std::char_traits<char>::compare(chars, other, std::min(length, otherLength));
+        if (cmp) return cmp;
+        return (length > otherLength) - (length < otherLength);
+    }
+
+    friend bool operator==(const MappedString& a, const std::string& b) {
+        return !a.compare(b.data(), b.size());
+    }
+
+    friend bool operator==(const std::string& a, const MappedString& b) {
+        return b == a;
+    }
+
+    friend bool operator!=(const MappedString& a, const std::string& b) {
+        return !(a == b);
+    }
+
+    friend std::ostream& operator<<(std::ostream& out, const MappedString& s) {
+        return out.write(s.chars, s.length);
+    }
+};
+
+// FNV-1a - stable across processes and builds, unlike std::hash.
+inline std::uint64_t mappedHash(const char *bytes, std::size_t n) {
+    std::uint64_t hash = 0xCBF29CE484222325ull;
+    for (std::size_t i = 0; i < n; ++i) {
+        hash ^= static_cast<unsigned char>(bytes[i]);
+        hash *= 0x100000001B3ull;
+    }
+    return hash;
+}
+
+// How a key or value is laid out in a mapped file. Trivially copyable types
+// (without padding, as their bytes are hashed) are stored in place; strings
+// as an (offset, length) reference into the string heap.
+template <typename T, typename = void>
+struct MappedField {
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "no mapped layout for this type - specialize aisdi::MappedField");
+    using Stored = T;
+    using View = const T&;
+    static constexpr std::uint32_t FIXED_SIZE = sizeof(T);
+
+    static Stored store(const T& item, std::vector<char>&) {
+        return item;
+    }
+
+    static View view(const Stored& stored, const char*, std::uint64_t) {
+        return stored;
+    }
+
+    static std::uint64_t hash(const T& item) {
+        return mappedHash(reinterpret_cast<const char*>(&item), sizeof(T));
+    }
+
+    static bool less(const T& a, const T& b) {
+        return std::less<T>()(a, b);
+    }
+
+    static int compare(const Stored& stored, const char*, std::uint64_t, const T& key) {
+        return ThreeWayCompare<T, std::less<T>>::compare(std::less<T>(), stored, key);
+    }
+};
+
+template <typename T, typename Tag>
+constexpr std::uint32_t MappedField<T, Tag>::FIXED_SIZE;
+
+template <>
+struct MappedField<std::string> {
+    struct Stored {
+        std::uint64_t offset;
+        std::uint64_t length;
+    };
+    using View = MappedString;
+    static constexpr std::uint32_t FIXED_SIZE = 0;
+
+    static Stored store(const std::string& item, std::vector<char>& heap) {
+        Stored stored{heap.size(), item.size()};
+        heap.insert(heap.end(), item.begin(), item.end());
+        return stored;
+    }
+
+    // checked here rather than on opening, which mustn't touch every entry
+    static View view(const Stored& stored, const char *heap, std::uint64_t heapBytes) {
+        if (stored.offset > heapBytes || stored.length > heapBytes - stored.offset)
+            throw SnapshotError("mapped string out of heap");
+        return MappedString(heap + stored.offset, stored.length);
+    }
+
+    static std::uint64_t hash(const std::string& item) {
+        return mappedHash(item.data(), item.size());
+    }
+
+    static bool less(const std::string& a, const std::string& b) {
+        return a < b;
+    }
+
+    static int compare(const Stored& stored, const char *heap, std::uint64_t heapBytes, const std::string& key) {
+        return view(stored, heap, heapBytes).compare(key.data(), key.size());
+    }
+};
+
+// Read-only map queried in place in a memory-mapped file, so opening it costs
+// a few system calls whatever its size, and processes mapping the same file
+// share its pages through the page cache.
+//
+// File layout, native byte order, sections 64-byte aligned:
+//   header  - magic, version, item layouts, section offsets, checksum
+//   index   - open-addressing hash table (linear probing) of u32 entry
+//             numbers + 1, 0 for an empty slot; at most half full
+//   entries - (key, value) records sorted by key
+//   heap    - characters of string keys and values
+// Everything is addressed by offsets, so nothing is fixed up on opening.
+// Files are written by MappedMap::write() from a HashMap or TreeMap.
+template <typename KeyType, typename ValueType>
+class MappedMap {
+    using KeyField = MappedField<KeyType>;
+    using ValueField = MappedField<ValueType>;
+
+    struct Entry {
+        typename KeyField::Stored key;
+        typename ValueField::Stored value;
+    };
+
+    struct Header {
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t keySize;
+        std::uint32_t valueSize;
+        std::uint32_t entrySize;
+        std::uint64_t count;
+        std::uint64_t slots;
+        std::uint64_t indexOffset;
+        std::uint64_t entriesOffset;
+        std::uint64_t heapOffset;
+        std::uint64_t heapBytes;
+        std::uint64_t fileBytes;
+        std::uint64_t checksum; // of everything behind the header
+    };
+
+    static constexpr char MAGIC[8] = { 'A', 'I', 'S', 'D', 'I', 'M', 'M', 'F' };
+    static constexpr std::uint32_t VERSION = 1;
+    static constexpr std::uint64_t ALIGNMENT = 64;
+
+    const char *base = nullptr;
+    std::size_t mappedBytes = 0;
+    const std::uint32_t *index = nullptr;
+    const Entry *entries = nullptr;
+    const char *heap = nullptr;
+    std::uint64_t count = 0, slots = 0, heapBytes = 0;
+
+public:
+    using key_type = KeyType;
+    using mapped_type = ValueType;
+    using key_view = typename KeyField::View;
+    using mapped_view = typename ValueField::View;
+    using value_type = std::pair<key_view, mapped_view>;
+    using size_type = std::size_t;
+
+    class ConstIterator;
+    using const_iterator = ConstIterator;
+
+    // Maps the file; throws std::system_error if it can't be opened and
+    // SnapshotError if it isn't a map of these types.
+    explicit MappedMap(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) throw std::system_error(errno, std::generic_category(), "open " + path);
+        struct stat status;
+        if (::fstat(fd, &status) < 0) {
+            int error = errno;
+            ::close(fd);
+            throw std::system_error(error, std::generic_category(), "stat " + path);
+        }
+        mappedBytes = status.st_size;
+        if (mappedBytes < sizeof(Header)) {
+            ::close(fd);
+            throw SnapshotError("not a mapped map: " + path);
+        }
+        void *memory = ::mmap(nullptr, mappedBytes, PROT_READ, MAP_SHARED, fd, 0);
+        int error = errno;
+        ::close(fd); // the mapping keeps the file
+        if (memory == MAP_FAILED) throw std::system_error(error, std::generic_category(), "mmap " + path);
+        base = static_cast<const char*>(memory);
+        try {
+            attach(path);
+        } catch (...) {
+            unmap();
+            throw;
+        }
+    }
+
+    MappedMap(const MappedMap&) = delete;
+    MappedMap& operator=(const MappedMap&) = delete;
+
+    MappedMap(MappedMap&& other) noexcept {
+        swap(other);
+    }
+
+    MappedMap& operator=(MappedMap&& other) noexcept {
+        MappedMap(std::move(other)).swap(*this);
+        return *this;
+    }
+
+    ~MappedMap() {
+        unmap();
+    }
+
+    // Writes the items of map - any map iterable over (key, value) pairs -
+    // to path in the mapped format.
+    template <typename Map>
+    static void write(const std::string& path, const Map& map) {
+        std::vector<const std::pair<const KeyType, ValueType>*> items;
+        for (const auto& item : map)
+            items.push_back(&item);
+        auto byKey = [](const std::pair<const KeyType, ValueType> *a, const std::pair<const KeyType, ValueType> *b) {
+            return KeyField::less(a->first, b->first);
+        };
+        if (!std::is_sorted(items.begin(), items.end(), byKey))
+            std::sort(items.begin(), items.end(), byKey);
+        if (items.size() >= UINT32_MAX) throw std::length_error("too many items for a mapped map");
+
+        std::vector<char> stringHeap;
+        std::vector<Entry> records;
+        records.reserve(items.size());
+        std::uint64_t tableSlots = 1;
+        while (tableSlots < 2 * items.size()) tableSlots <<= 1;
+        std::vector<std::uint32_t> table(tableSlots, 0);
+        for (std::size_t i = 0; i < items.size(); ++i) {
+            Entry entry;
+            std::memset(&entry, 0, sizeof(entry)); // padding too, so files are reproducible
+            entry.key = KeyField::store(items[i]->first, stringHeap);
+            entry.value = ValueField::store(items[i]->second, stringHeap);
+            records.push_back(entry);
+            std::uint64_t slot = KeyField::hash(items[i]->first) & (tableSlots - 1);
+            while (table[slot]) slot = (slot + 1) & (tableSlots - 1);
+            table[slot] = static_cast<std::uint32_t>(i + 1);
+        }
+
+        Header header{};
+        std::copy(MAGIC, MAGIC + sizeof(MAGIC), header.magic);
+        header.version = VERSION;
+        header.keySize = KeyField::FIXED_SIZE;
+        header.valueSize = ValueField::FIXED_SIZE;
+        header.entrySize = sizeof(Entry);
+        header.count = items.size();
+        header.slots = tableSlots;
+        header.indexOffset = align(sizeof(Header));
+        header.entriesOffset = align(header.indexOffset + tableSlots * sizeof(std::uint32_t));
+        header.heapOffset = align(header.entriesOffset + records.size() * sizeof(Entry));
+        header.heapBytes = stringHeap.size();
+        header.fileBytes = header.heapOffset + header.heapBytes;
+
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        if (!out) throw std::system_error(errno, std::generic_category(), "open " + path);
+        Checksum checksum;
+        std::uint64_t position = sizeof(Header);
+        auto section = [&](std::uint64_t offset, const void *data, std::uint64_t bytes) {
+            static const char padding[ALIGNMENT] = {};
+            checksum.update(padding, offset - position);
+            checksum.update(static_cast<const char*>(data), bytes);
+            out.write(padding, offset - position);
+            out.write(static_cast<const char*>(data), bytes);
+            position = offset + bytes;
+        };
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header)); // checksum comes later
+        section(header.indexOffset, table.data(), table.size() * sizeof(std::uint32_t));
+        section(header.entriesOffset, records.data(), records.size() * sizeof(Entry));
+        section(header.heapOffset, stringHeap.data(), stringHeap.size());
+        header.checksum = checksum.value();
+        out.seekp(0);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.close();
+        if (!out) throw SnapshotError("mapped map write failed: " + path);
+    }
+
+    bool isEmpty() const {
+        return !count;
+    }
+
+    size_type getSize() const {
+        return count;
+    }
+
+    const_iterator find(const key_type& key) const {
+        std::uint64_t slot = KeyField::hash(key) & (slots - 1);
+        for (std::uint64_t probes = 0; probes < slots; ++probes, slot = (slot + 1) & (slots - 1)) {
+            std::uint32_t number = index[slot];
+            if (!number) break;
+            if (number > count) throw SnapshotError("mapped index damaged");
+            if (!KeyField::compare(entries[number - 1].key, heap, heapBytes, key))
+                return ConstIterator(this, number - 1);
+        }
+        return cend();
+    }
+
+    bool contains(const key_type& key) const {
+        return find(key) != cend();
+    }
+
+    mapped_view valueOf(const key_type& key) const {
+        auto it = find(key);
+        if (it == cend()) throw std::out_of_range("item doesn't exist");
+        return it->second;
+    }
+
+    // First item with key not less than the given one - a binary search of
+    // the sorted entries.
+    const_iterator lowerBound(const key_type& key) const {
+        std::uint64_t low = 0, high = count;
+        while (low < high) {
+            std::uint64_t middle = low + (high - low) / 2;
+            if (KeyField::compare(entries[middle].key, heap, heapBytes, key) < 0) low = middle + 1;
+            else high = middle;
+        }
+        return ConstIterator(this, low);
+    }
+
+    // Verifies the checksum - reads the whole file, so it's not done on opening.
+    bool verify() const {
+        const Header& header = *reinterpret_cast<const Header*>(base);
+        Checksum checksum;
+        checksum.update(base + sizeof(Header), header.fileBytes - sizeof(Header));
+        return checksum.value() == header.checksum;
+    }
+
+    const_iterator begin() const {
+        return cbegin();
+    }
+
+    const_iterator end() const {
+        return cend();
+    }
+
+    const_iterator cbegin() const {
+        return ConstIterator(this, 0);
+    }
+
+    const_iterator cend() const {
+        return ConstIterator(this, count);
+    }
+
+private:
+    static std::uint64_t align(std::uint64_t offset) {
+        return (offset + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+    }
+
+    void attach(const std::string& path) {
+        const Header& header = *reinterpret_cast<const Header*>(base);
+        if (!std::equal(MAGIC, MAGIC + sizeof(MAGIC), header.magic))
+            throw SnapshotError("not a mapped map: " + path);
+        if (header.version != VERSION)
+            throw SnapshotError("unsupported mapped map version: " + path);
+        if (header.keySize != KeyField::FIXED_SIZE || header.valueSize != ValueField::FIXED_SIZE
+            || header.entrySize != sizeof(Entry))
+            throw SnapshotError("mapped map of different key or value type: " + path);
+        bool consistent = header.fileBytes == mappedBytes
+            && header.slots && !(header.slots & (header.slots - 1)) && header.count < header.slots
+            && header.indexOffset == align(sizeof(Header))
+            && header.entriesOffset >= header.indexOffset + header.slots * sizeof(std::uint32_t)
+            && header.entriesOffset % ALIGNMENT == 0
+            && header.heapOffset >= header.entriesOffset + header.count * sizeof(Entry)
+            && header.heapOffset <= header.fileBytes
+            && header.heapBytes == header.fileBytes - header.heapOffset;
+        if (!consistent) throw SnapshotError("mapped map damaged: " + path);
+
+        count = header.count;
+        slots = header.slots;
+        heapBytes = header.heapBytes;
+        index = reinterpret_cast<const std::uint32_t*>(base + header.indexOffset);
+        entries = reinterpret_cast<const Entry*>(base + header.entriesOffset);
+        heap = base + header.heapOffset;
+    }
+
+    void unmap() {
+        if (base) ::munmap(const_cast<char*>(base), mappedBytes);
+        base = nullptr;
+    }
+
+    void swap(MappedMap& other) noexcept {
+        std::swap(base, other.base);
+        std::swap(mappedBytes, other.mappedBytes);
+        std::swap(index, other.index);
+        std::swap(entries, other.entries);
+        std::swap(heap, other.heap);
+        std::swap(count, other.count);
+        std::swap(slots, other.slots);
+        std::swap(heapBytes, other.heapBytes);
+    }
+};
+
+template <typename KeyType, typename ValueType>
+constexpr char MappedMap<KeyType, ValueType>::MAGIC[8];
+
+template <typename KeyType, typename ValueType>
+constexpr std::uint32_t MappedMap<KeyType, ValueType>::VERSION;
+
+template <typename KeyType, typename ValueType>
+constexpr std::uint64_t MappedMap<KeyType, ValueType>::ALIGNMENT;
+
+// Items are made on dereference from the mapped entry, as (key, value) views.
+template <typename KeyType, typename ValueType>
+class MappedMap<KeyType, ValueType>::ConstIterator {
+    friend class MappedMap;
+    const MappedMap *map;
+    std::uint64_t position;
+
+    struct Arrow {
+        value_type item;
+        const value_type* operator->() const {
+            return &item;
+        }
+    };
+public:
+    using reference = typename MappedMap::value_type;
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = typename MappedMap::value_type;
+    using difference_type = std::ptrdiff_t;
+    using pointer = Arrow;
+
+    ConstIterator(const MappedMap *m, std::uint64_t p)
+        : map(m), position(p)
+    { }
+
+    ConstIterator& operator++() {
+        if (position == map->count) throw std::out_of_range("end of map");
+        ++position;
+        return *this;
+    }
+
+    ConstIterator operator++(int) {
+        ConstIterator t(*this);
+        operator++();
+        return t;
+    }
+
+    reference operator*() const {
+        if (position == map->count) throw std::out_of_range("dereference of end()");
+        const Entry& entry = map->entries[position];
+        return value_type(KeyField::view(entry.key, map->heap, map->heapBytes),
+                          ValueField::view(entry.value, map->heap, map->heapBytes));
+    }
+
+    pointer operator->() const {
+        return Arrow{**this};
+    }
+
+    bool operator==(const ConstIterator& other) const {
+        return map == other.map && position == other.position;
+    }
+
+    bool operator!=(const ConstIterator& other) const {
+        return !(*this == other);
+    }
+};
+
+}
+
+#endif /* AISDI_MAPS_MAPPEDMAP_H */
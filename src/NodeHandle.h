@@ -0,0 +1,92 @@
+#ifndef AISDI_MAPS_NODEHANDLE_H
+#define AISDI_MAPS_NODEHANDLE_H
+
+#include <functional>
+#include <stdexcept>
+#include <utility>
+
+#include "bst.h"
+
+namespace aisdi {
+
+template<typename KeyType, typename ValueType, typename Compare>
+class TreeMap;
+
+template<typename KeyType, typename ValueType>
+class HashMap;
+
+// An item taken out of a map by extract(), node and all, until insert()
+// links it into another map. TreeMap and HashMap keep items in the same
+// nodes, so with the default Compare an item can go from either kind of map
+// to the other without being copied or reallocated. A handle still holding
+// its node when destroyed frees it.
+template<typename KeyType, typename ValueType, typename Compare = std::less<KeyType>>
+class NodeHandle {
+    friend class TreeMap<KeyType, ValueType, Compare>;
+    friend class HashMap<KeyType, ValueType>;
+    using node = typename BST<KeyType, ValueType, Compare>::BSTNode;
+
+    node *held = nullptr;
+
+    explicit NodeHandle(node *n)
+        : held(n)
+    { }
+
+    // Gives the node up to a map; the handle is empty then.
+    node* release() {
+        node *n = held;
+        held = nullptr;
+        return n;
+    }
+
+public:
+    using key_type = KeyType;
+    using mapped_type = ValueType;
+
+    NodeHandle() { }
+
+    NodeHandle(NodeHandle&& other) noexcept
+        : held(other.release())
+    { }
+
+    NodeHandle& operator=(NodeHandle&& other) noexcept {
+        if (this != &other) {
+            delete held;
+            held = other.release();
+        }
+        return *this;
+    }
+
+    NodeHandle(const NodeHandle&) = delete;
+    NodeHandle& operator=(const NodeHandle&) = delete;
+
+    ~NodeHandle() {
+        delete held;
+    }
+
+    bool isEmpty() const {
+        return !held;
+    }
+
+    explicit operator bool() const {
+        return held;
+    }
+
+    const key_type& key() const {
+        if (!held) throw std::out_of_range("empty node handle");
+        return held->value.first;
+    }
+
+    mapped_type& mapped() const {
+        if (!held) throw std::out_of_range("empty node handle");
+        return held->value.second;
+    }
+
+    void swap(NodeHandle& other) noexcept {
+        std::swap(held, other.held);
+    }
+};
+
+}
+
+#endif /* AISDI_MAPS_NODEHANDLE_H */
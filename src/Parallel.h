@@ -0,0 +1,90 @@
+#ifndef AISDI_MAPS_PARALLEL_H
+#define AISDI_MAPS_PARALLEL_H
+
+#include <algorithm>
+#include <cstddef>
+#include <exception>
+#include <iterator>
+#include <thread>
+#include <vector>
+
+namespace aisdi {
+
+// Accumulator of folds that are run only for their side effects.
+struct NoResult { };
+
+// Number of workers the parallel operations use unless told otherwise.
+inline unsigned defaultThreadsNumber() {
+    unsigned n = std::thread::hardware_concurrency();
+    return n ? n : 1;
+}
+
+// Number of workers worth starting for items items - a few thousand each at
+// least, so that thread start-up doesn't eat the gain.
+inline unsigned workersFor(std::size_t items, unsigned threads) {
+    const std::size_t MIN_ITEMS_PER_WORKER = 1 << 12;
+    return static_cast<unsigned>(std::max<std::size_t>(
+        1, std::min<std::size_t>(threads, items / MIN_ITEMS_PER_WORKER)));
+}
+
+// Runs fn(worker) for every worker in [0, workers), each on its own thread -
+// worker 0 on the calling one. Returns when all are done, rethrowing the
+// exception of the lowest worker that failed.
+template <typename Fn>
+void runWorkers(unsigned workers, Fn fn) {
+    if (workers <= 1) {
+        fn(0u);
+        return;
+    }
+    std::vector<std::exception_ptr> errors(workers);
+    std::vector<std::thread> threads;
+    threads.reserve(workers - 1);
+    auto guarded = [&fn, &errors](unsigned worker) {
+        try {
+            fn(worker);
+        } catch (...) {
+            errors[worker] = std::current_exception();
+        }
+    };
+    try {
+        for (unsigned worker = 1; worker < workers; ++worker)
+            threads.emplace_back(guarded, worker);
+    } catch (...) {
+        for (auto& thread : threads) thread.join();
+        throw;
+    }
+    guarded(0u);
+    for (auto& thread : threads) thread.join();
+    for (auto& error : errors)
+        if (error) std::rethrow_exception(error);
+}
+
+// Stable sort of [first, last): chunks are sorted concurrently, then merged
+// pairwise, a whole level of merges at a time.
+template <typename RandomIt, typename Compare>
+void parallelStableSort(RandomIt first, RandomIt last, Compare comp, unsigned threads) {
+    std::size_t n = last - first;
+    std::size_t chunks = workersFor(n, threads);
+    std::vector<RandomIt> bounds;
+    for (std::size_t i = 0; i <= chunks; ++i)
+        bounds.push_back(first + n * i / chunks);
+
+    runWorkers(chunks, [&](unsigned chunk) {
+        std::stable_sort(bounds[chunk], bounds[chunk + 1], comp);
+    });
+    while (bounds.size() > 2) {
+        std::size_t pairs = (bounds.size() - 1) / 2;
+        runWorkers(pairs, [&](unsigned pair) {
+            std::inplace_merge(bounds[2 * pair], bounds[2 * pair + 1], bounds[2 * pair + 2], comp);
+        });
+        std::vector<RandomIt> merged;
+        for (std::size_t i = 0; i < bounds.size(); i += 2)
+            merged.push_back(bounds[i]);
+        if (merged.back() != last) merged.push_back(last);
+        bounds.swap(merged);
+    }
+}
+
+}
+
+#endif /* AISDI_MAPS_PARALLEL_H */
@@ -0,0 +1,12 @@
+#ifndef AISDI_MAPS_PREFETCH_H
+#define AISDI_MAPS_PREFETCH_H
+
+// Hint that address will be read soon. Never faults, so null or dangling
+// addresses are fine; compiles to nothing where the builtin is missing.
+#if defined(__GNUC__) || defined(__clang__)
+#  define AISDI_PREFETCH(address) __builtin_prefetch(address)
+#else
+#  define AISDI_PREFETCH(address) ((void)(address))
+#endif
+
+#endif /* AISDI_MAPS_PREFETCH_H */
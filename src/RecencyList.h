@@ -0,0 +1,59 @@
+#ifndef AISDI_MAPS_RECENCYLIST_H
+#define AISDI_MAPS_RECENCYLIST_H
+
+#include <cstddef>
+
+namespace aisdi {
+
+// Doubly linked list of items, head the most recent. Intrusive: an Item is
+// a map's value_type whose second holds the prev and next links, so linking
+// allocates nothing.
+template<typename Item>
+class RecencyList {
+    Item *head = nullptr;
+    Item *tail = nullptr;
+    std::size_t size = 0;
+public:
+    void pushFront(Item *item) {
+        item->second.prev = nullptr;
+        item->second.next = head;
+        if (head) head->second.prev = item;
+        else tail = item;
+        head = item;
+        ++size;
+    }
+
+    void pushBack(Item *item) {
+        item->second.next = nullptr;
+        item->second.prev = tail;
+        if (tail) tail->second.next = item;
+        else head = item;
+        tail = item;
+        ++size;
+    }
+
+    void unlink(Item *item) {
+        if (item->second.prev) item->second.prev->second.next = item->second.next;
+        else head = item->second.next;
+        if (item->second.next) item->second.next->second.prev = item->second.prev;
+        else tail = item->second.prev;
+        item->second.prev = item->second.next = nullptr;
+        --size;
+    }
+
+    Item* front() const {
+        return head;
+    }
+
+    Item* back() const {
+        return tail;
+    }
+
+    std::size_t getSize() const {
+        return size;
+    }
+};
+
+}
+
+#endif /* AISDI_MAPS_RECENCYLIST_H */
@@ -0,0 +1,298 @@
+#ifndef AISDI_MAPS_SERIALIZATION_H
+#define AISDI_MAPS_SERIALIZATION_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace aisdi {
+
+// Thrown when a snapshot can't be written or read back: I/O failure, wrong
+// magic, version or item types, damaged data.
+class SnapshotError : public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
+};
+
+// Encoding of keys and values in snapshots, appended to / consumed from a
+// byte buffer. Trivially copyable types are stored as their bytes, in native
+// byte order, and a run of them is read back with one memcpy. Other types
+// need a specialization - see std::string below.
+template <typename T, typename = void>
+struct Serializer {
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "no snapshot encoding for this type - specialize aisdi::Serializer");
+
+    // bytes of every item, or 0 if they vary
+    static constexpr std::uint32_t FIXED_SIZE = sizeof(T);
+
+    static void write(std::vector<char>& out, const T& item) {
+        const char *bytes = reinterpret_cast<const char*>(&item);
+        out.insert(out.end(), bytes, bytes + sizeof(T));
+    }
+
+    static const char* readRun(const char *in, const char *end, T *items, std::size_t n) {
+        if (static_cast<std::size_t>(end - in) < n * sizeof(T))
+            throw SnapshotError("snapshot block too short");
+        std::memcpy(items, in, n * sizeof(T));
+        return in + n * sizeof(T);
+    }
+};
+
+template <typename T, typename Tag>
+constexpr std::uint32_t Serializer<T, Tag>::FIXED_SIZE;
+
+// Length-prefixed: 64-bit length, then the characters.
+template <typename CharT, typename Traits, typename Alloc>
+struct Serializer<std::basic_string<CharT, Traits, Alloc>> {
+    using string = std::basic_string<CharT, Traits, Alloc>;
+    static constexpr std::uint32_t FIXED_SIZE = 0;
+
+    static void write(std::vector<char>& out, const string& item) {
+        std::uint64_t length = item.size();
+        Serializer<std::uint64_t>::write(out, length);
+        const char *bytes = reinterpret_cast<const char*>(item.data());
+        out.insert(out.end(), bytes, bytes + length * sizeof(CharT));
+    }
+
+    static const char* readRun(const char *in, const char *end, string *items, std::size_t n) {
+        for (std::size_t i = 0; i < n; ++i) {
+            std::uint64_t length;
+            in = Serializer<std::uint64_t>::readRun(in, end, &length, 1);
+            if (static_cast<std::uint64_t>(end - in) / sizeof(CharT) < length)
+                throw SnapshotError("snapshot block too short");
+            items[i].assign(reinterpret_cast<const CharT*>(in), length);
+            in += length * sizeof(CharT);
+        }
+        return in;
+    }
+};
+
+template <typename CharT, typename Traits, typename Alloc>
+constexpr std::uint32_t Serializer<std::basic_string<CharT, Traits, Alloc>>::FIXED_SIZE;
+
+// Checksum of a byte stream, independent of how the stream is split into
+// updates. Mixes 8 bytes at a time, so it keeps up with the disk.
+class Checksum {
+    std::uint64_t hash = 0x9E3779B97F4A7C15ull;
+    std::uint64_t length = 0;
+    char carry[8];
+    unsigned carried = 0;
+
+    void mix(std::uint64_t word) {
+        hash ^= word * 0xC2B2AE3D27D4EB4Full;
+        hash = ((hash << 31) | (hash >> 33)) * 0x9E3779B185EBCA87ull;
+    }
+
+    void mixCarry() {
+        std::uint64_t word = 0;
+        std::memcpy(&word, carry, carried);
+        mix(word);
+        carried = 0;
+    }
+public:
+    void update(const char *data, std::size_t n) {
+        length += n;
+        for (; n && carried; --n) {
+            carry[carried++] = *data++;
+            if (carried == 8) mixCarry();
+        }
+        for (; n >= 8; data += 8, n -= 8) {
+            std::uint64_t word;
+            std::memcpy(&word, data, 8);
+            mix(word);
+        }
+        for (; n; --n) carry[carried++] = *data++;
+    }
+
+    std::uint64_t value() const {
+        Checksum last(*this);
+        if (last.carried) last.mixCarry();
+        last.mix(length);
+        std::uint64_t h = last.hash;
+        h ^= h >> 33;
+        h *= 0xFF51AFD7ED558CCDull;
+        h ^= h >> 33;
+        return h;
+    }
+};
+
+// Snapshot layout, native byte order:
+//   header:  "AISDIMAP" | version u32 | flags u32 | key size u32 | value size u32
+//            | key kind u32 | value kind u32 | items u64
+//   blocks:  items u32 | bytes u64 | keys of the block | values of the block
+//   trailer: checksum u64 of everything before it
+// Sizes are Serializer<>::FIXED_SIZE of the item types and kinds their
+// snapshotKind(), both checked on reading.
+constexpr char SNAPSHOT_MAGIC[8] = { 'A', 'I', 'S', 'D', 'I', 'M', 'A', 'P' };
+constexpr std::uint32_t SNAPSHOT_VERSION = 2;
+constexpr std::uint32_t SNAPSHOT_SORTED = 1; // items are in key order
+constexpr std::size_t SNAPSHOT_BLOCK_ITEMS = 4096;
+
+constexpr std::uint32_t SNAPSHOT_KIND_OTHER = 0;
+constexpr std::uint32_t SNAPSHOT_KIND_INTEGRAL = 1;
+constexpr std::uint32_t SNAPSHOT_KIND_FLOATING = 2;
+constexpr std::uint32_t SNAPSHOT_KIND_SIGNED = 0x100;
+
+// What sort of type T is, so that items of the same size but another type
+// (an int read as a float, a uint32_t as an int32_t) aren't taken silently.
+template <typename T>
+constexpr std::uint32_t snapshotKind() {
+    return (std::is_integral<T>::value ? SNAPSHOT_KIND_INTEGRAL
+            : std::is_floating_point<T>::value ? SNAPSHOT_KIND_FLOATING
+            : SNAPSHOT_KIND_OTHER)
+           | (std::is_signed<T>::value ? SNAPSHOT_KIND_SIGNED : 0);
+}
+
+// Writes count items, which visit(emit) passes one by one to emit(const value_type&).
+template <typename KeyType, typename ValueType, typename Visit>
+void writeSnapshot(std::ostream& out, std::uint64_t count, std::uint32_t flags, Visit visit) {
+    using value_type = std::pair<const KeyType, ValueType>;
+    Checksum checksum;
+    std::vector<char> buffer;
+    auto flush = [&]() {
+        checksum.update(buffer.data(), buffer.size());
+        if (!out.write(buffer.data(), buffer.size())) throw SnapshotError("snapshot write failed");
+        buffer.clear();
+    };
+
+    buffer.insert(buffer.end(), SNAPSHOT_MAGIC, SNAPSHOT_MAGIC + sizeof(SNAPSHOT_MAGIC));
+    Serializer<std::uint32_t>::write(buffer, SNAPSHOT_VERSION);
+    Serializer<std::uint32_t>::write(buffer, flags);
+    Serializer<std::uint32_t>::write(buffer, Serializer<KeyType>::FIXED_SIZE);
+    Serializer<std::uint32_t>::write(buffer, Serializer<ValueType>::FIXED_SIZE);
+    Serializer<std::uint32_t>::write(buffer, snapshotKind<KeyType>());
+    Serializer<std::uint32_t>::write(buffer, snapshotKind<ValueType>());
+    Serializer<std::uint64_t>::write(buffer, count);
+
+    std::vector<const value_type*> block;
+    std::uint64_t written = 0;
+    auto writeBlock = [&]() {
+        std::size_t start = buffer.size();
+        Serializer<std::uint32_t>::write(buffer, static_cast<std::uint32_t>(block.size()));
+        Serializer<std::uint64_t>::write(buffer, 0); // patched below
+        std::size_t payload = buffer.size();
+        for (auto item : block) Serializer<KeyType>::write(buffer, item->first);
+        for (auto item : block) Serializer<ValueType>::write(buffer, item->second);
+        std::uint64_t bytes = buffer.size() - payload;
+        std::memcpy(&buffer[start + sizeof(std::uint32_t)], &bytes, sizeof(bytes));
+        written += block.size();
+        block.clear();
+        flush();
+    };
+    visit([&](const value_type& item) {
+        block.push_back(&item);
+        if (block.size() == SNAPSHOT_BLOCK_ITEMS) writeBlock();
+    });
+    if (!block.empty()) writeBlock();
+    if (!buffer.empty()) flush(); // header of an empty snapshot
+    if (written != count) throw SnapshotError("snapshot item count mismatch");
+
+    std::uint64_t sum = checksum.value();
+    if (!out.write(reinterpret_cast<const char*>(&sum), sizeof(sum)))
+        throw SnapshotError("snapshot write failed");
+}
+
+// Reads a snapshot written by writeSnapshot() block by block. Reads exactly
+// the snapshot's bytes, so the stream may go on with other data.
+template <typename KeyType, typename ValueType>
+class SnapshotReader {
+    std::istream& in;
+    Checksum checksum;
+    std::vector<char> buffer;
+    std::uint32_t flags;
+    std::uint64_t count;
+    std::uint64_t read = 0;
+
+    // Grows the buffer as data arrives, so that a damaged length can't make
+    // it allocate more than the stream holds.
+    const char* fill(std::uint64_t bytes) {
+        const std::size_t STEP = 1 << 20;
+        buffer.clear();
+        while (buffer.size() < bytes) {
+            std::size_t done = buffer.size();
+            std::size_t more = static_cast<std::size_t>(std::min<std::uint64_t>(STEP, bytes - done));
+            buffer.resize(done + more);
+            if (!in.read(buffer.data() + done, more)) throw SnapshotError("snapshot truncated");
+        }
+        checksum.update(buffer.data(), buffer.size());
+        return buffer.data();
+    }
+
+    template <typename T>
+    T field(const char *&position) {
+        T value;
+        position = Serializer<T>::readRun(position, buffer.data() + buffer.size(), &value, 1);
+        return value;
+    }
+public:
+    explicit SnapshotReader(std::istream& input)
+        : in(input)
+    {
+        const std::size_t HEADER_BYTES = sizeof(SNAPSHOT_MAGIC) + 6 * sizeof(std::uint32_t) + sizeof(std::uint64_t);
+        const char *position = fill(HEADER_BYTES);
+        if (!std::equal(SNAPSHOT_MAGIC, SNAPSHOT_MAGIC + sizeof(SNAPSHOT_MAGIC), position))
+            throw SnapshotError("not a map snapshot");
+        position += sizeof(SNAPSHOT_MAGIC);
+        if (field<std::uint32_t>(position) != SNAPSHOT_VERSION)
+            throw SnapshotError("unsupported snapshot version");
+        flags = field<std::uint32_t>(position);
+        if (field<std::uint32_t>(position) != Serializer<KeyType>::FIXED_SIZE
+            || field<std::uint32_t>(position) != Serializer<ValueType>::FIXED_SIZE
+            || field<std::uint32_t>(position) != snapshotKind<KeyType>()
+            || field<std::uint32_t>(position) != snapshotKind<ValueType>())
+            throw SnapshotError("snapshot of different key or value type");
+        count = field<std::uint64_t>(position);
+    }
+
+    std::uint32_t getFlags() const {
+        return flags;
+    }
+
+    // items in the snapshot, as claimed by its (not yet verified) header
+    std::uint64_t getCount() const {
+        return count;
+    }
+
+    // Replaces keys and values with the next block's items. Returns false,
+    // having verified the checksum, once all items were read.
+    bool nextBlock(std::vector<KeyType>& keys, std::vector<ValueType>& values) {
+        if (read == count) {
+            std::uint64_t expected = checksum.value(), stored;
+            if (!in.read(reinterpret_cast<char*>(&stored), sizeof(stored)))
+                throw SnapshotError("snapshot truncated");
+            if (stored != expected) throw SnapshotError("snapshot checksum mismatch");
+            return false;
+        }
+        const char *position = fill(sizeof(std::uint32_t) + sizeof(std::uint64_t));
+        std::uint32_t items = field<std::uint32_t>(position);
+        std::uint64_t bytes = field<std::uint64_t>(position);
+        if (!items || items > SNAPSHOT_BLOCK_ITEMS || items > count - read)
+            throw SnapshotError("snapshot damaged");
+        const std::uint64_t itemBytes = std::uint64_t(Serializer<KeyType>::FIXED_SIZE)
+                                        + Serializer<ValueType>::FIXED_SIZE;
+        if (Serializer<KeyType>::FIXED_SIZE && Serializer<ValueType>::FIXED_SIZE && bytes != items * itemBytes)
+            throw SnapshotError("snapshot damaged");
+
+        position = fill(bytes);
+        const char *end = position + bytes;
+        keys.resize(items);
+        values.resize(items);
+        position = Serializer<KeyType>::readRun(position, end, keys.data(), items);
+        position = Serializer<ValueType>::readRun(position, end, values.data(), items);
+        if (position != end) throw SnapshotError("snapshot damaged");
+        read += items;
+        return true;
+    }
+};
+
+}
+
+#endif /* AISDI_MAPS_SERIALIZATION_H */
@@ -0,0 +1,376 @@
+#ifndef AISDI_MAPS_SHARDEDTREEMAP_H
+#define AISDI_MAPS_SHARDEDTREEMAP_H
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#include "TreeMap.h"
+
+namespace aisdi {
+
+// Ordered map for concurrent use, spread over TreeMap shards by key range.
+// Shard i holds keys in [splits[i-1], splits[i]) and has its own lock, so
+// writers working on different ranges never contend.
+//
+// A shard that grows past maxShardSize is split at its median online, by
+// relinking the upper half of its tree into a new shard (TreeMap::splitOff).
+// The shard directory is guarded by a reader-writer lock that operations hold
+// shared. A split finds the median holding only the shard, then takes the
+// directory exclusively for the relink: one walk down the shard's tree and a
+// count of the nodes moved.
+//
+// As with the other concurrent maps, values are handed out by copy or to a
+// visitor - never as references that could outlive the shard lock - except
+// through ConstIterator, which holds the lock of the shard it's in.
+template<typename KeyType, typename ValueType, typename Compare = std::less<KeyType>>
+class ShardedTreeMap {
+    using Lock = std::shared_timed_mutex;
+
+    struct Shard {
+        mutable Lock lock;
+        TreeMap<KeyType, ValueType, Compare> map;
+
+        explicit Shard(const Compare& comp) : map(comp) { }
+    };
+
+    mutable Lock directoryLock;
+    std::vector<KeyType> splits;
+    std::vector<std::unique_ptr<Shard>> shards;
+    const std::size_t maxShardSize;
+    Compare comp;
+public:
+    using key_type = KeyType;
+    using mapped_type = ValueType;
+    using value_type = std::pair<const key_type, mapped_type>;
+    using size_type = std::size_t;
+    using key_compare = Compare;
+
+    class ConstIterator;
+
+    using const_iterator = ConstIterator;
+
+    static constexpr std::size_t DEFAULT_MAX_SHARD_SIZE = 1 << 16;
+
+    // Configured split points; shards = split points + 1.
+    explicit ShardedTreeMap(std::vector<KeyType> splitPoints = {},
+                            std::size_t maxShard = DEFAULT_MAX_SHARD_SIZE,
+                            const Compare& c = Compare())
+        : splits(std::move(splitPoints)), maxShardSize(maxShard), comp(c)
+    {
+        if (maxShardSize < 2) throw std::invalid_argument("shards must be allowed 2 items at least");
+        std::sort(splits.begin(), splits.end(), comp);
+        splits.erase(std::unique(splits.begin(), splits.end(),
+                                 [this](const KeyType& a, const KeyType& b) {
+                                     return !comp(a, b) && !comp(b, a);
+                                 }),
+                     splits.end());
+        for (std::size_t i = 0; i <= splits.size(); ++i)
+            shards.emplace_back(new Shard(comp));
+    }
+
+    // Split points sampled as quantiles of [sampleFirst, sampleLast).
+    template <typename InputIt,
+              typename = typename std::iterator_traits<InputIt>::iterator_category>
+    ShardedTreeMap(InputIt sampleFirst, InputIt sampleLast, std::size_t shardsNumber,
+                   std::size_t maxShard = DEFAULT_MAX_SHARD_SIZE,
+                   const Compare& c = Compare())
+        : ShardedTreeMap(quantiles(std::vector<KeyType>(sampleFirst, sampleLast), shardsNumber, c),
+                         maxShard, c)
+    { }
+
+    ShardedTreeMap(const ShardedTreeMap&) = delete;
+    ShardedTreeMap& operator=(const ShardedTreeMap&) = delete;
+
+    // Inserts the pair if the key is absent. Returns false if it was present.
+    template <typename Kk, typename Vv>
+    bool insert(Kk&& key, Vv&& value) {
+        bool inserted = false;
+        const Shard *tooLarge = nullptr;
+        {
+            std::shared_lock<Lock> directory(directoryLock);
+            Shard& shard = shardFor(key);
+            std::lock_guard<Lock> guard(shard.lock);
+            std::size_t before = shard.map.getSize();
+            auto& slot = shard.map[std::forward<Kk>(key)];
+            if (shard.map.getSize() != before) {
+                slot = std::forward<Vv>(value);
+                inserted = true;
+                if (shard.map.getSize() > maxShardSize) tooLarge = &shard;
+            }
+        }
+        if (tooLarge) splitShard(tooLarge);
+        return inserted;
+    }
+
+    // Equivalent of TreeMap's map[key] = value.
+    template <typename Kk, typename Vv>
+    void assign(Kk&& key, Vv&& value) {
+        const Shard *tooLarge = nullptr;
+        {
+            std::shared_lock<Lock> directory(directoryLock);
+            Shard& shard = shardFor(key);
+            std::lock_guard<Lock> guard(shard.lock);
+            shard.map[std::forward<Kk>(key)] = std::forward<Vv>(value);
+            if (shard.map.getSize() > maxShardSize) tooLarge = &shard;
+        }
+        if (tooLarge) splitShard(tooLarge);
+    }
+
+    // Calls fn(const mapped_type&) with the shard held for reading.
+    // fn must not call back into the map.
+    template <typename Fn>
+    bool visit(const key_type& key, Fn&& fn) const {
+        std::shared_lock<Lock> directory(directoryLock);
+        const Shard& shard = shardFor(key);
+        std::shared_lock<Lock> guard(shard.lock);
+        auto it = shard.map.find(key);
+        if (it == shard.map.end()) return false;
+        fn(it->second);
+        return true;
+    }
+
+    bool find(const key_type& key, mapped_type& out) const {
+        return visit(key, [&out](const mapped_type& value) { out = value; });
+    }
+
+    bool contains(const key_type& key) const {
+        return visit(key, [](const mapped_type&) { });
+    }
+
+    mapped_type valueOf(const key_type& key) const {
+        mapped_type result;
+        if (!find(key, result)) throw std::out_of_range("item doesn't exist");
+        return result;
+    }
+
+    // Returns false if key was absent.
+    bool remove(const key_type& key) {
+        std::shared_lock<Lock> directory(directoryLock);
+        Shard& shard = shardFor(key);
+        std::lock_guard<Lock> guard(shard.lock);
+        auto it = shard.map.find(key);
+        if (it == shard.map.end()) return false;
+        shard.map.remove(it);
+        return true;
+    }
+
+    // Calls fn(const value_type&) for every item in key order, as iterating
+    // does. fn must not call back into the map.
+    template <typename Fn>
+    void forEach(Fn&& fn) const {
+        for (const auto& item : *this)
+            fn(item);
+    }
+
+    const_iterator cbegin() const {
+        return ConstIterator(this);
+    }
+
+    const_iterator cend() const {
+        return ConstIterator();
+    }
+
+    const_iterator begin() const {
+        return cbegin();
+    }
+
+    const_iterator end() const {
+        return cend();
+    }
+
+    size_type getSize() const {
+        std::shared_lock<Lock> directory(directoryLock);
+        size_type result = 0;
+        for (auto& shard : shards) {
+            std::shared_lock<Lock> guard(shard->lock);
+            result += shard->map.getSize();
+        }
+        return result;
+    }
+
+    bool isEmpty() const {
+        return !getSize();
+    }
+
+    size_type getShardsNumber() const {
+        std::shared_lock<Lock> directory(directoryLock);
+        return shards.size();
+    }
+
+    void clear() {
+        std::shared_lock<Lock> directory(directoryLock);
+        for (auto& shard : shards) {
+            std::lock_guard<Lock> guard(shard->lock);
+            shard->map.clear();
+        }
+    }
+
+    key_compare keyComp() const {
+        return comp;
+    }
+
+private:
+    // caller holds directoryLock
+    std::size_t shardIndex(const key_type& key) const {
+        return std::upper_bound(splits.begin(), splits.end(), key, comp) - splits.begin();
+    }
+
+    Shard& shardFor(const key_type& key) {
+        return *shards[shardIndex(key)];
+    }
+
+    const Shard& shardFor(const key_type& key) const {
+        return *shards[shardIndex(key)];
+    }
+
+    // key may have been moved into the map, so the shard is looked up by
+    // address. The median is found with only the shard held for reading;
+    // the directory is taken exclusively just for the relink, once it's
+    // checked that the shard still needs the split and the key still
+    // falls strictly inside the shard's range.
+    void splitShard(const Shard *target) {
+        std::unique_ptr<KeyType> splitPoint; // KeyType needn't be default-constructible
+        {
+            std::shared_lock<Lock> directory(directoryLock);
+            std::shared_lock<Lock> guard(target->lock);
+            if (target->map.getSize() <= maxShardSize) return; // someone has split it already
+            auto median = target->map.begin();
+            std::advance(median, target->map.getSize() / 2);
+            splitPoint.reset(new KeyType(median->first));
+        }
+
+        std::lock_guard<Lock> directory(directoryLock);
+        std::size_t idx = 0;
+        while (shards[idx].get() != target) ++idx;
+        Shard& shard = *shards[idx];
+        // split meanwhile, or the key left for the other side of a split
+        if (shard.map.getSize() <= maxShardSize
+            || (idx > 0 && !comp(splits[idx - 1], *splitPoint))
+            || (idx < splits.size() && !comp(*splitPoint, splits[idx])))
+            return;
+
+        std::unique_ptr<Shard> upper(new Shard(comp));
+        shard.map.splitOff(*splitPoint, upper->map);
+        shards.insert(shards.begin() + idx + 1, std::move(upper));
+        splits.insert(splits.begin() + idx, std::move(*splitPoint));
+    }
+
+    static std::vector<KeyType> quantiles(std::vector<KeyType> sample, std::size_t shardsNumber,
+                                          const Compare& comp) {
+        std::vector<KeyType> result;
+        if (sample.empty() || shardsNumber < 2) return result;
+        std::sort(sample.begin(), sample.end(), comp);
+        for (std::size_t i = 1; i < shardsNumber; ++i)
+            result.push_back(sample[i * sample.size() / shardsNumber]);
+        return result;
+    }
+};
+
+template<typename KeyType, typename ValueType, typename Compare>
+constexpr std::size_t ShardedTreeMap<KeyType, ValueType, Compare>::DEFAULT_MAX_SHARD_SIZE;
+
+// Forward iterator over the items in key order, crossing shard boundaries
+// transparently. While not at the end it holds the shard directory and the
+// shard it's in for reading, taking the shards one at a time as it moves on:
+// splits, and writers to that shard, wait until it moves past or is
+// destroyed, and the thread holding it must not call back into the map. The
+// scan thus sees every shard at one moment, not the whole map. Iterators are
+// move-only, as the locks are.
+template<typename KeyType, typename ValueType, typename Compare>
+class ShardedTreeMap<KeyType, ValueType, Compare>::ConstIterator {
+    friend class ShardedTreeMap;
+    using ShardIterator = typename TreeMap<KeyType, ValueType, Compare>::const_iterator;
+
+    const ShardedTreeMap *owner; // null at the end
+    std::shared_lock<Lock> directory;
+    std::size_t shard;
+    std::shared_lock<Lock> shardGuard;
+    ShardIterator current;
+
+    explicit ConstIterator(const ShardedTreeMap *map)
+        : owner(map), directory(map->directoryLock), shard(0)
+    {
+        settle();
+    }
+
+    // moves on from an exhausted shard to the first item of the next ones
+    void settle() {
+        for (; shard < owner->shards.size(); ++shard) {
+            const Shard& next = *owner->shards[shard];
+            shardGuard = std::shared_lock<Lock>(next.lock);
+            current = next.map.cbegin();
+            if (current != next.map.cend()) return;
+        }
+        shardGuard = std::shared_lock<Lock>();
+        directory = std::shared_lock<Lock>();
+        owner = nullptr;
+    }
+
+public:
+    using reference = const typename ShardedTreeMap::value_type&;
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = typename ShardedTreeMap::value_type;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const typename ShardedTreeMap::value_type*;
+
+    ConstIterator()
+        : owner(nullptr), shard(0)
+    { }
+
+    ConstIterator(ConstIterator&& other) noexcept
+        : owner(other.owner), directory(std::move(other.directory)), shard(other.shard),
+          shardGuard(std::move(other.shardGuard)), current(std::move(other.current))
+    {
+        other.owner = nullptr;
+    }
+
+    ConstIterator& operator=(ConstIterator&& other) noexcept {
+        if (this != &other) {
+            shardGuard = std::move(other.shardGuard);
+            directory = std::move(other.directory);
+            owner = other.owner;
+            shard = other.shard;
+            current = std::move(other.current);
+            other.owner = nullptr;
+        }
+        return *this;
+    }
+
+    ConstIterator& operator++() {
+        if (!owner) throw std::out_of_range("increment end");
+        if (++current == owner->shards[shard]->map.cend()) {
+            ++shard;
+            settle();
+        }
+        return *this;
+    }
+
+    reference operator*() const {
+        if (!owner) throw std::out_of_range("dereference end");
+        return *current;
+    }
+
+    pointer operator->() const {
+        return &this->operator*();
+    }
+
+    bool operator==(const ConstIterator& other) const {
+        if (!owner || !other.owner) return owner == other.owner;
+        return owner == other.owner && shard == other.shard && current == other.current;
+    }
+
+    bool operator!=(const ConstIterator& other) const {
+        return !(*this == other);
+    }
+};
+
+}
+
+#endif /* AISDI_MAPS_SHARDEDTREEMAP_H */
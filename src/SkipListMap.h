@@ -0,0 +1,385 @@
+#ifndef AISDI_MAPS_SKIPLISTMAP_H
+#define AISDI_MAPS_SKIPLISTMAP_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <new>
+#include <stdexcept>
+#include <utility>
+#include "bst.h"
+#include "EpochReclamation.h"
+
+namespace aisdi {
+
+// Lock-free ordered map (Herlihy-Shavit skip list) that any number of threads
+// may read and write at once. Offers the read/insert/remove subset of TreeMap
+// plus lowerBound(). Values are immutable once inserted.
+//
+// A node is linked bottom-up with CAS and removed by marking its forward links
+// top-down; the level 0 mark is the linearization point. Marked nodes are
+// snipped out by any thread passing by. A removed node is retired to the
+// EpochDomain only when both its inserter and its remover are done with it and
+// it has been snipped at every level, so no late CAS can link it back.
+//
+// Iterators pin the epoch while alive and must stay on the thread that made them.
+template<typename KeyType, typename ValueType, typename Compare = std::less<KeyType>>
+class SkipListMap : private CompareHolder<Compare> {
+public:
+    using key_type = KeyType;
+    using mapped_type = ValueType;
+    using value_type = std::pair<const key_type, mapped_type>;
+    using size_type = std::size_t;
+    using reference = value_type&;
+    using const_reference = const value_type&;
+    using key_compare = Compare;
+
+    class ConstIterator;
+    using const_iterator = ConstIterator;
+
+    static constexpr int MAX_LEVEL = 24;
+
+private:
+    using Link = std::atomic<std::uintptr_t>;
+
+    struct alignas(Link) Node {
+        value_type value;
+        const int height;
+        // inserter still linking + not yet removed; retired when it drops to 0
+        std::atomic<int> references{2};
+
+        template <typename Kk, typename Vv>
+        Node(Kk&& k, Vv&& v, int h)
+            : value(std::forward<Kk>(k), std::forward<Vv>(v)), height(h)
+        { }
+
+        // tower of forward links allocated right behind the node
+        Link* links() {
+            return reinterpret_cast<Link*>(reinterpret_cast<char*>(this) + sizeof(Node));
+        }
+    };
+
+    static Node* nodeOf(std::uintptr_t link) {
+        return reinterpret_cast<Node*>(link & ~std::uintptr_t(1));
+    }
+
+    static bool isMarked(std::uintptr_t link) {
+        return link & 1;
+    }
+
+    static std::uintptr_t address(Node *node) {
+        return reinterpret_cast<std::uintptr_t>(node);
+    }
+
+    Link head[MAX_LEVEL];
+    std::atomic<size_type> size{0};
+    EpochDomain& epochs;
+
+public:
+    SkipListMap()
+        : SkipListMap(Compare())
+    { }
+
+    explicit SkipListMap(const Compare& comp)
+        : CompareHolder<Compare>(comp), epochs(EpochDomain::global())
+    {
+        for (auto& link : head)
+            link.store(0, std::memory_order_relaxed);
+    }
+
+    SkipListMap(std::initializer_list<value_type> list)
+        : SkipListMap()
+    {
+        for (auto&& pair : list)
+            insert(pair.first, pair.second);
+    }
+
+    SkipListMap(const SkipListMap&) = delete;
+    SkipListMap& operator=(const SkipListMap&) = delete;
+
+    // No thread may use the map concurrently with its destruction.
+    ~SkipListMap() {
+        Node *node = nodeOf(head[0].load(std::memory_order_relaxed));
+        while (node) {
+            Node *next = nodeOf(node->links()[0].load(std::memory_order_relaxed));
+            destroyNode(node);
+            node = next;
+        }
+    }
+
+    bool isEmpty() const {
+        return !getSize();
+    }
+
+    size_type getSize() const {
+        return size.load(std::memory_order_relaxed);
+    }
+
+    // Inserts the pair if the key is absent. Returns false if it was present.
+    template <typename Kk, typename Vv>
+    bool insert(Kk&& key, Vv&& value) {
+        EpochDomain::Guard guard(epochs);
+        const key_type& converted = key;
+        // key may be moved into the node, which is searched for afterwards
+        const key_type *searched = &converted;
+        Link *preds[MAX_LEVEL];
+        Node *succs[MAX_LEVEL];
+        Node *node = nullptr;
+        for (;;) {
+            if (findPosition(*searched, preds, succs)) {
+                if (node) destroyNode(node); // never published
+                return false;
+            }
+            if (!node) {
+                node = createNode(std::forward<Kk>(key), std::forward<Vv>(value), randomLevel());
+                searched = &node->value.first;
+            }
+            for (int level = 0; level < node->height; ++level)
+                node->links()[level].store(address(succs[level]), std::memory_order_relaxed);
+            std::uintptr_t expected = address(succs[0]);
+            if (preds[0][0].compare_exchange_strong(expected, address(node)))
+                break;
+        }
+        size.fetch_add(1, std::memory_order_relaxed);
+        linkUpperLevels(node, preds, succs);
+        return true;
+    }
+
+    // Returns false if key was absent.
+    bool remove(const key_type& key) {
+        EpochDomain::Guard guard(epochs);
+        Link *preds[MAX_LEVEL];
+        Node *succs[MAX_LEVEL];
+        if (!findPosition(key, preds, succs))
+            return false;
+        Node *victim = succs[0];
+        for (int level = victim->height - 1; level > 0; --level) {
+            std::uintptr_t next = victim->links()[level].load();
+            while (!isMarked(next))
+                victim->links()[level].compare_exchange_weak(next, next | 1);
+        }
+        std::uintptr_t next = victim->links()[0].load();
+        for (;;) {
+            if (isMarked(next))
+                return false; // removed by someone else first
+            if (victim->links()[0].compare_exchange_weak(next, next | 1))
+                break;
+        }
+        size.fetch_sub(1, std::memory_order_relaxed);
+        findPosition(key, preds, succs); // snips victim at every level
+        release(victim);
+        return true;
+    }
+
+    const_iterator find(const key_type& key) const {
+        ConstIterator it = lowerBound(key);
+        if (it.node && compareKeys(it.node->value.first, key) != 0)
+            return cend();
+        return it;
+    }
+
+    // First item with key not less than the given one.
+    const_iterator lowerBound(const key_type& key) const {
+        ConstIterator it(this, nullptr);
+        const Link *pred = head;
+        Node *curr = nullptr;
+        for (int level = MAX_LEVEL - 1; level >= 0; --level) {
+            curr = nodeOf(pred[level].load(std::memory_order_acquire));
+            // marked nodes are skipped, not snipped - readers don't write
+            while (curr && (isMarked(curr->links()[0].load(std::memory_order_acquire))
+                            || compareKeys(curr->value.first, key) < 0)) {
+                if (!isMarked(curr->links()[0].load(std::memory_order_acquire)))
+                    pred = curr->links();
+                curr = nodeOf(curr->links()[level].load(std::memory_order_acquire));
+            }
+        }
+        it.node = curr;
+        return it;
+    }
+
+    bool contains(const key_type& key) const {
+        return find(key) != cend();
+    }
+
+    mapped_type valueOf(const key_type& key) const {
+        auto it = find(key);
+        if (it == cend()) throw std::out_of_range("item doesn't exist");
+        return it->second;
+    }
+
+    const_iterator begin() const {
+        return cbegin();
+    }
+
+    const_iterator end() const {
+        return cend();
+    }
+
+    const_iterator cbegin() const {
+        ConstIterator it(this, nullptr);
+        it.node = nodeOf(head[0].load(std::memory_order_acquire));
+        it.skipRemoved();
+        return it;
+    }
+
+    const_iterator cend() const {
+        return ConstIterator(this, nullptr);
+    }
+
+    key_compare keyComp() const {
+        return CompareHolder<Compare>::getComparator();
+    }
+
+private:
+    int compareKeys(const key_type& a, const key_type& b) const {
+        return ThreeWayCompare<KeyType, Compare>::compare(CompareHolder<Compare>::getComparator(), a, b);
+    }
+
+    // Fills preds/succs with the neighbours of key at every level, snipping
+    // marked nodes on the way. preds[level] is the predecessor's whole tower,
+    // so its link at that level is preds[level][level].
+    // Returns whether an unmarked node with key exists.
+    bool findPosition(const key_type& key, Link **preds, Node **succs) {
+    retry:
+        Link *pred = head;
+        for (int level = MAX_LEVEL - 1; level >= 0; --level) {
+            Node *curr = nodeOf(pred[level].load());
+            while (curr) {
+                std::uintptr_t succ = curr->links()[level].load();
+                while (isMarked(succ)) {
+                    std::uintptr_t expected = address(curr);
+                    if (!pred[level].compare_exchange_strong(expected, succ & ~std::uintptr_t(1)))
+                        goto retry;
+                    curr = nodeOf(succ);
+                    if (!curr) break;
+                    succ = curr->links()[level].load();
+                }
+                if (!curr || compareKeys(curr->value.first, key) >= 0)
+                    break;
+                pred = curr->links();
+                curr = nodeOf(succ);
+            }
+            preds[level] = pred;
+            succs[level] = curr;
+        }
+        return succs[0] && compareKeys(succs[0]->value.first, key) == 0;
+    }
+
+    void linkUpperLevels(Node *node, Link **preds, Node **succs) {
+        const key_type& key = node->value.first;
+        for (int level = 1; level < node->height; ++level) {
+            for (;;) {
+                std::uintptr_t next = node->links()[level].load();
+                if (isMarked(next))
+                    goto done; // being removed, stop linking
+                if (nodeOf(next) != succs[level]
+                    && !node->links()[level].compare_exchange_strong(next, address(succs[level])))
+                    continue;
+                std::uintptr_t expected = address(succs[level]);
+                if (preds[level][level].compare_exchange_strong(expected, address(node)))
+                    break;
+                findPosition(key, preds, succs);
+                if (succs[0] != node)
+                    goto done; // removed meanwhile
+            }
+        }
+    done:
+        if (isMarked(node->links()[0].load()))
+            findPosition(key, preds, succs); // a level may have been linked after the remover's sweep
+        release(node);
+    }
+
+    void release(Node *node) {
+        if (node->references.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            epochs.retire(node, &SkipListMap::destroyNode);
+    }
+
+    template <typename Kk, typename Vv>
+    static Node* createNode(Kk&& key, Vv&& value, int height) {
+        void *memory = ::operator new(sizeof(Node) + height * sizeof(Link));
+        Node *node = new (memory) Node(std::forward<Kk>(key), std::forward<Vv>(value), height);
+        for (int level = 0; level < height; ++level)
+            new (node->links() + level) Link(0);
+        return node;
+    }
+
+    static void destroyNode(void *memory) {
+        Node *node = static_cast<Node*>(memory);
+        node->~Node();
+        ::operator delete(memory);
+    }
+
+    // p = 1/2 per level
+    static int randomLevel() {
+        static thread_local std::uint64_t state = 0x9E3779B97F4A7C15ull ^ reinterpret_cast<std::uintptr_t>(&state);
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        int level = 1;
+        for (std::uint64_t bits = state; (bits & 1) && level < MAX_LEVEL; bits >>= 1)
+            ++level;
+        return level;
+    }
+};
+
+template<typename KeyType, typename ValueType, typename Compare>
+constexpr int SkipListMap<KeyType, ValueType, Compare>::MAX_LEVEL;
+
+template<typename KeyType, typename ValueType, typename Compare>
+class SkipListMap<KeyType, ValueType, Compare>::ConstIterator {
+    friend class SkipListMap;
+    EpochDomain::Guard guard;
+    Node *node;
+public:
+    using reference = typename SkipListMap::const_reference;
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = typename SkipListMap::value_type;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const typename SkipListMap::value_type*;
+
+    explicit ConstIterator(const SkipListMap *m, Node *n)
+        : guard(m->epochs), node(n)
+    { }
+
+    ConstIterator& operator++() {
+        if (!node) throw std::out_of_range("end of list");
+        node = SkipListMap::nodeOf(node->links()[0].load(std::memory_order_acquire));
+        skipRemoved();
+        return *this;
+    }
+
+    ConstIterator operator++(int) {
+        ConstIterator t(*this);
+        operator++();
+        return t;
+    }
+
+    reference operator*() const {
+        if (!node) throw std::out_of_range("dereference of end()");
+        return node->value;
+    }
+
+    pointer operator->() const {
+        return &this->operator*();
+    }
+
+    bool operator==(const ConstIterator& other) const {
+        return node == other.node;
+    }
+
+    bool operator!=(const ConstIterator& other) const {
+        return !(*this == other);
+    }
+
+private:
+    void skipRemoved() {
+        while (node && SkipListMap::isMarked(node->links()[0].load(std::memory_order_acquire)))
+            node = SkipListMap::nodeOf(node->links()[0].load(std::memory_order_acquire));
+    }
+};
+
+}
+
+#endif /* AISDI_MAPS_SKIPLISTMAP_H */
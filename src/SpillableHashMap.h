@@ -0,0 +1,329 @@
+#ifndef AISDI_MAPS_SPILLABLEHASHMAP_H
+#define AISDI_MAPS_SPILLABLEHASHMAP_H
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "bst.h"
+#include "Serialization.h"
+
+namespace aisdi {
+
+// Approximate heap bytes an item holds beyond its node.
+template <typename T>
+std::size_t extraFootprint(const T&) {
+    return 0;
+}
+
+template <typename CharT, typename Traits, typename Alloc>
+std::size_t extraFootprint(const std::basic_string<CharT, Traits, Alloc>& s) {
+    // short strings live inside the object
+    return s.capacity() > 15 ? (s.capacity() + 1) * sizeof(CharT) : 0;
+}
+
+struct SpillMetrics {
+    std::uint64_t lookups = 0;
+    std::uint64_t residentHits = 0;  // lookups landing on a resident bucket
+    std::uint64_t faults = 0;        // buckets read back from the spill file
+    std::uint64_t evictions = 0;
+    std::uint64_t bytesSpilled = 0;  // written to the spill file, in total
+    std::uint64_t bytesFaulted = 0;  // read back from it, in total
+    std::size_t residentBytes = 0;   // approximate, of resident buckets' items
+    std::size_t spilledBuckets = 0;
+    std::uint64_t spillFileBytes = 0; // taken by regions of the spill file, free ones included
+
+    double hitRate() const {
+        return lookups ? double(residentHits) / lookups : 1.0;
+    }
+};
+
+// HashMap that keeps its items within a memory budget by spilling whole
+// buckets to a scratch file. When resident items outgrow the budget, buckets
+// not used lately - by a CLOCK sweep over their reference bits - are written
+// out (unless unchanged since they were last read) and dropped; an operation
+// landing on a spilled bucket reads it back first. Buckets are the BSTs of
+// HashMap, and come back balanced, rebuilt from their sorted spill.
+//
+// A bucket takes a file region of the next power of two bytes up from its
+// spill; one outgrowing its region moves to a bigger one, and the old region
+// is reused by the next bucket needing one of its size. So the file stays
+// within a small multiple of the spilled data however often items change.
+//
+// This is a class of its own rather than a mode of HashMap: any call may
+// spill a bucket and free its nodes, so nothing may point into the map
+// across calls. Hence no iterators and no operator[] - values are handed
+// out as pointers valid until the next call, and changes go through assign().
+template<typename KeyType, typename ValueType>
+class SpillableHashMap {
+    using Tree = BST<KeyType, ValueType>;
+    using node = typename Tree::BSTNode;
+
+    struct Bucket {
+        Tree tree;
+        std::size_t bytes = 0;           // approximate, of items in memory
+        std::size_t spilledItems = 0;    // in the file, while not resident
+        std::uint64_t fileOffset = 0;    // region of the file holding the bucket
+        std::uint64_t fileCapacity = 0;  // MIN_REGION_BYTES << some size class; 0 if none
+        std::uint64_t fileBytes = 0;     // of the region in use; 0 if none
+        bool resident = true;
+        bool dirty = false;              // differs from the file copy
+        bool referenced = false;
+    };
+
+    const std::string spillPath;
+    const std::size_t memoryBudget;
+    std::vector<Bucket> buckets;
+    std::size_t size = 0;
+    std::size_t clockHand = 0;
+    std::uint64_t fileEnd = 0;
+    std::vector<std::vector<std::uint64_t>> freeRegions; // offsets, by size class
+    int fd = -1;
+    SpillMetrics metrics;
+
+public:
+    using key_type = KeyType;
+    using mapped_type = ValueType;
+    using value_type = std::pair<const key_type, mapped_type>;
+    using size_type = std::size_t;
+
+    static constexpr std::size_t DEFAULT_BUCKETS_NUMBER = 15693;
+    static constexpr std::uint64_t MIN_REGION_BYTES = 64;
+
+    // The scratch file at spillPath is created (truncated) and removed with the map.
+    SpillableHashMap(const std::string& path, std::size_t budgetBytes,
+                     std::size_t bucketsNumber = DEFAULT_BUCKETS_NUMBER)
+        : spillPath(path), memoryBudget(budgetBytes), buckets(bucketsNumber)
+    {
+        if (!bucketsNumber) throw std::invalid_argument("no buckets");
+        fd = ::open(spillPath.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+        if (fd < 0) throw std::system_error(errno, std::generic_category(), "open " + spillPath);
+    }
+
+    SpillableHashMap(const SpillableHashMap&) = delete;
+    SpillableHashMap& operator=(const SpillableHashMap&) = delete;
+
+    ~SpillableHashMap() {
+        ::close(fd);
+        std::remove(spillPath.c_str());
+    }
+
+    // map[key] = value
+    template <typename Kk, typename Vv>
+    void assign(Kk&& key, Vv&& value) {
+        std::size_t idx = bucketOf(key);
+        Bucket& bucket = access(idx);
+        node *n = bucket.tree.findNodeWithKey(key);
+        if (n) {
+            std::size_t old = itemBytes(n->value.first, n->value.second);
+            bucket.bytes -= old;
+            metrics.residentBytes -= old;
+            n->value.second = std::forward<Vv>(value);
+        } else {
+            n = bucket.tree.insert(std::forward<Kk>(key), std::forward<Vv>(value));
+            ++size;
+        }
+        std::size_t bytes = itemBytes(n->value.first, n->value.second);
+        bucket.bytes += bytes;
+        metrics.residentBytes += bytes;
+        bucket.dirty = true;
+        enforceBudget(idx);
+    }
+
+    // Pointer to the value, or nullptr; valid until the next call.
+    const mapped_type* find(const key_type& key) {
+        std::size_t idx = bucketOf(key);
+        node *n = access(idx).tree.findNodeWithKey(key);
+        enforceBudget(idx);
+        return n ? &n->value.second : nullptr;
+    }
+
+    bool contains(const key_type& key) {
+        return find(key) != nullptr;
+    }
+
+    mapped_type valueOf(const key_type& key) {
+        const mapped_type *value = find(key);
+        if (!value) throw std::out_of_range("item doesn't exist");
+        return *value;
+    }
+
+    // Returns false if key was absent.
+    bool remove(const key_type& key) {
+        std::size_t idx = bucketOf(key);
+        Bucket& bucket = access(idx);
+        node *n = bucket.tree.findNodeWithKey(key);
+        bool found = n != nullptr;
+        if (found) {
+            std::size_t bytes = itemBytes(n->value.first, n->value.second);
+            bucket.bytes -= bytes;
+            metrics.residentBytes -= bytes;
+            bucket.tree.deleteKey(key);
+            bucket.dirty = true;
+            --size;
+        }
+        enforceBudget(idx);
+        return found;
+    }
+
+    size_type getSize() const {
+        return size;
+    }
+
+    bool isEmpty() const {
+        return !size;
+    }
+
+    const SpillMetrics& getMetrics() const {
+        return metrics;
+    }
+
+private:
+    std::size_t bucketOf(const key_type& key) const {
+        return std::hash<KeyType>()(key) % buckets.size();
+    }
+
+    static std::size_t itemBytes(const key_type& key, const mapped_type& value) {
+        return sizeof(node) + extraFootprint(key) + extraFootprint(value);
+    }
+
+    Bucket& access(std::size_t idx) {
+        Bucket& bucket = buckets[idx];
+        ++metrics.lookups;
+        if (bucket.resident) ++metrics.residentHits;
+        else faultIn(bucket);
+        bucket.referenced = true;
+        return bucket;
+    }
+
+    // CLOCK: a referenced bucket gets its bit cleared and another round;
+    // the one just used (pinned) and empty ones are passed over.
+    void enforceBudget(std::size_t pinned) {
+        std::size_t passed = 0;
+        while (metrics.residentBytes > memoryBudget && passed < 2 * buckets.size()) {
+            std::size_t idx = clockHand;
+            clockHand = (clockHand + 1) % buckets.size();
+            ++passed;
+            Bucket& bucket = buckets[idx];
+            if (!bucket.resident || idx == pinned || bucket.tree.isEmpty()) continue;
+            if (bucket.referenced) {
+                bucket.referenced = false;
+                continue;
+            }
+            spill(bucket);
+        }
+    }
+
+    void spill(Bucket& bucket) {
+        if (bucket.dirty) {
+            std::vector<char> bytes;
+            bucket.tree.forEachNode([&bytes](node *n) { Serializer<KeyType>::write(bytes, n->value.first); });
+            bucket.tree.forEachNode([&bytes](node *n) { Serializer<ValueType>::write(bytes, n->value.second); });
+            if (bytes.size() > bucket.fileCapacity) relocate(bucket, bytes.size());
+            writeAt(bytes.data(), bytes.size(), bucket.fileOffset);
+            bucket.fileBytes = bytes.size();
+            metrics.bytesSpilled += bytes.size();
+        }
+        bucket.spilledItems = bucket.tree.getSize();
+        bucket.tree.clear();
+        metrics.residentBytes -= bucket.bytes;
+        bucket.bytes = 0;
+        bucket.resident = false;
+        bucket.dirty = false;
+        ++metrics.evictions;
+        ++metrics.spilledBuckets;
+    }
+
+    static std::size_t sizeClass(std::uint64_t bytes) {
+        std::size_t c = 0;
+        while ((MIN_REGION_BYTES << c) < bytes) ++c;
+        return c;
+    }
+
+    // Gives the bucket a region for bytes, freeing the one it had.
+    void relocate(Bucket& bucket, std::uint64_t bytes) {
+        if (bucket.fileCapacity)
+            freeRegions[sizeClass(bucket.fileCapacity)].push_back(bucket.fileOffset);
+        std::size_t c = sizeClass(bytes);
+        if (freeRegions.size() <= c) freeRegions.resize(c + 1);
+        bucket.fileCapacity = MIN_REGION_BYTES << c;
+        if (!freeRegions[c].empty()) {
+            bucket.fileOffset = freeRegions[c].back();
+            freeRegions[c].pop_back();
+        } else {
+            bucket.fileOffset = fileEnd;
+            fileEnd += bucket.fileCapacity;
+            metrics.spillFileBytes = fileEnd;
+        }
+    }
+
+    void faultIn(Bucket& bucket) {
+        std::vector<char> bytes(bucket.fileBytes);
+        readAt(bytes.data(), bytes.size(), bucket.fileOffset);
+        std::vector<KeyType> keys(bucket.spilledItems);
+        std::vector<ValueType> values(bucket.spilledItems);
+        const char *position = bytes.data(), *end = bytes.data() + bytes.size();
+        position = Serializer<KeyType>::readRun(position, end, keys.data(), keys.size());
+        Serializer<ValueType>::readRun(position, end, values.data(), values.size());
+
+        std::vector<std::pair<KeyType, ValueType>> items;
+        items.reserve(keys.size());
+        std::size_t resident = 0;
+        for (std::size_t i = 0; i < keys.size(); ++i) {
+            resident += itemBytes(keys[i], values[i]);
+            items.emplace_back(std::move(keys[i]), std::move(values[i]));
+        }
+        bucket.tree.buildFromSorted(std::make_move_iterator(items.begin()), std::make_move_iterator(items.end()));
+        bucket.bytes = resident;
+        metrics.residentBytes += resident;
+        metrics.bytesFaulted += bytes.size();
+        ++metrics.faults;
+        --metrics.spilledBuckets;
+        bucket.resident = true;
+    }
+
+    void writeAt(const char *data, std::size_t n, std::uint64_t offset) {
+        while (n) {
+            ssize_t written = ::pwrite(fd, data, n, offset);
+            if (written < 0) {
+                if (errno == EINTR) continue;
+                throw std::system_error(errno, std::generic_category(), "write " + spillPath);
+            }
+            data += written;
+            n -= written;
+            offset += written;
+        }
+    }
+
+    void readAt(char *data, std::size_t n, std::uint64_t offset) {
+        while (n) {
+            ssize_t got = ::pread(fd, data, n, offset);
+            if (got < 0 && errno == EINTR) continue;
+            if (got <= 0) throw std::system_error(got ? errno : EIO, std::generic_category(), "read " + spillPath);
+            data += got;
+            n -= got;
+            offset += got;
+        }
+    }
+};
+
+template<typename KeyType, typename ValueType>
+constexpr std::size_t SpillableHashMap<KeyType, ValueType>::DEFAULT_BUCKETS_NUMBER;
+
+template<typename KeyType, typename ValueType>
+constexpr std::uint64_t SpillableHashMap<KeyType, ValueType>::MIN_REGION_BYTES;
+
+}
+
+#endif /* AISDI_MAPS_SPILLABLEHASHMAP_H */
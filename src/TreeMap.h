@@ -5,23 +5,40 @@
 #include <initializer_list>
 #include <stdexcept>
 #include <utility>
+#include <functional>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <iterator>
+#include <list>
+#include <mutex>
+#include <type_traits>
+#include <vector>
 #include "bst.h"
+#include "NodeHandle.h"
+#include "Parallel.h"
+#include "Prefetch.h"
+#include "Serialization.h"
 
 namespace aisdi {
 template<typename KeyType, typename ValueType>
 class HashMap;
 
-template<typename KeyType, typename ValueType>
+template<typename KeyType, typename ValueType, typename Compare = std::less<KeyType>>
 class TreeMap {
     friend class HashMap<KeyType, ValueType>;
-    BST<KeyType, ValueType> tree;
+    using Tree = BST<KeyType, ValueType, Compare>;
+    Tree tree;
 public:
     using key_type = KeyType;
     using mapped_type = ValueType;
+    using key_compare = Compare;
     using value_type = std::pair<const key_type, mapped_type>;
     using size_type = std::size_t;
     using reference = value_type&;
     using const_reference = const value_type&;
+    using node_type = NodeHandle<KeyType, ValueType, Compare>;
 
     class ConstIterator;
 
@@ -30,9 +47,17 @@ public:
     using iterator = Iterator;
     using const_iterator = ConstIterator;
 
+    static constexpr std::size_t DEFAULT_LOOKUP_GROUP = 16;
+    static constexpr std::size_t MAX_LOOKUP_GROUP = 64;
+
     TreeMap() { }
 
-    TreeMap(std::initializer_list<value_type> list) {
+    explicit TreeMap(const Compare& comp)
+        : tree(comp)
+    { }
+
+    TreeMap(std::initializer_list<value_type> list, const Compare& comp = Compare())
+        : tree(comp) {
         for (auto&& pair : list) {
             tree.insert(std::move(pair.first), std::move(pair.second));
         }
@@ -42,7 +67,7 @@ public:
         : tree(other.tree)
     { }
 
-    TreeMap(TreeMap&& other)
+    TreeMap(TreeMap&& other) noexcept(std::is_nothrow_move_constructible<Tree>::value)
         : tree(std::move(other.tree))
     { }
 
@@ -51,11 +76,39 @@ public:
         return *this;
     }
 
-    TreeMap& operator=(TreeMap&& other) {
+    TreeMap& operator=(TreeMap&& other) noexcept(std::is_nothrow_move_assignable<Tree>::value) {
         tree = std::move(other.tree);
         return *this;
     }
 
+    // Builds a map of the pairs of [first, last) as if they were assigned one
+    // by one, so the last of equivalent keys wins. The pairs are stable-sorted
+    // in parallel, deduplicated, and made into a balanced tree whose subtrees
+    // are built concurrently.
+    template <typename ForwardIt>
+    static TreeMap buildParallel(ForwardIt first, ForwardIt last,
+                                 unsigned threads = defaultThreadsNumber(),
+                                 const Compare& comp = Compare()) {
+        using Item = std::pair<KeyType, ValueType>;
+        std::vector<Item> items(first, last);
+        auto keyLess = [&comp](const Item& a, const Item& b) { return comp(a.first, b.first); };
+        parallelStableSort(items.begin(), items.end(), keyLess, threads);
+
+        std::size_t kept = 0;
+        for (std::size_t i = 0; i < items.size(); ++i) {
+            if (i + 1 < items.size() && !keyLess(items[i], items[i + 1]))
+                continue; // a later one replaces it
+            if (kept != i) items[kept] = std::move(items[i]);
+            ++kept;
+        }
+
+        TreeMap result(comp);
+        result.tree.buildFromSorted(std::make_move_iterator(items.begin()),
+                                    std::make_move_iterator(items.begin() + kept),
+                                    workersFor(kept, threads));
+        return result;
+    }
+
     bool isEmpty() const {
         return tree.isEmpty();
     }
@@ -97,6 +150,42 @@ public:
         if (it.isEnd || !tree.deleteKey(it.node->value.first)) throw std::out_of_range("delete unexistent item");
     }
 
+    // Takes the item with key out of the map without freeing it; the handle
+    // is empty if there's no such item.
+    node_type extract(const key_type& key) {
+        auto node = tree.findNodeWithKey(key);
+        return node_type(node ? tree.extractNode(node) : nullptr);
+    }
+
+    node_type extract(const const_iterator& it) {
+        if (it.isEnd || it.tree != &tree) throw std::out_of_range("extract unexistent item");
+        return node_type(tree.extractNode(it.node));
+    }
+
+    // Links in the node of handle, unless its key is here already - then the
+    // handle keeps it. Returns the item with the key and whether it's the
+    // handle's; nullptr and false for an empty handle. Nodes are linked in
+    // as in a scapegoat tree, so ones coming in key order don't make a list.
+    std::pair<value_type*, bool> insert(node_type&& handle) {
+        if (handle.isEmpty()) return { nullptr, false };
+        auto node = tree.adoptUnique(handle.held);
+        if (node != handle.held) return { &node->value, false };
+        return { &handle.release()->value, true };
+    }
+
+    // Relinks every item of other whose key isn't in this map, leaving other
+    // the rest; none is copied or reallocated.
+    void merge(TreeMap& other) {
+        if (&other == this || other.isEmpty()) return;
+        auto last = other.tree.getLastNode();
+        for (auto node = other.tree.getFirstNode(); node;) {
+            auto next = node == last ? nullptr : other.tree.getNextNode(node);
+            if (!tree.findNodeWithKey(node->value.first))
+                tree.adoptBalanced(other.tree.extractNode(node));
+            node = next;
+        }
+    }
+
     size_type getSize() const {
         return tree.getSize();
     }
@@ -113,6 +202,76 @@ public:
         tree.clear();
     }
 
+    key_compare keyComp() const {
+        return tree.keyComp();
+    }
+
+    // Looks up every key of [keysFirst, keysLast) and writes a pointer to its
+    // item, or nullptr if missing, to out - in the order of the keys given.
+    // A lookup is a chain of dependent loads, so group lookups are interleaved
+    // (asynchronous memory access chaining): each one descends a single level
+    // per round and prefetches its next node, so that by the time it is
+    // visited again the node is likely in cache. A finished lookup hands its
+    // slot to the next key at once, keeping group misses in flight.
+    template <typename ForwardIt, typename OutputIt>
+    OutputIt findMany(ForwardIt keysFirst, ForwardIt keysLast, OutputIt out,
+                      std::size_t group = DEFAULT_LOOKUP_GROUP) const {
+        using BSTNode = typename Tree::BSTNode;
+        struct Lookup {
+            ForwardIt key;
+            BSTNode *node;
+            std::size_t slot;
+        };
+        group = std::max<std::size_t>(1, std::min(group, MAX_LOOKUP_GROUP));
+        ForwardIt keys[LOOKUP_WINDOW];
+        const BSTNode *found[LOOKUP_WINDOW];
+        Lookup lookups[MAX_LOOKUP_GROUP];
+        BSTNode *root = tree.getRoot();
+
+        while (keysFirst != keysLast) {
+            std::size_t n = 0;
+            for (; n < LOOKUP_WINDOW && keysFirst != keysLast; ++n, ++keysFirst)
+                keys[n] = keysFirst;
+
+            std::size_t next = 0, active = 0;
+            for (; active < group && next < n; ++active, ++next)
+                lookups[active] = Lookup{keys[next], root, next};
+            AISDI_PREFETCH(root);
+
+            while (active) {
+                for (std::size_t i = 0; i < active;) {
+                    Lookup& lookup = lookups[i];
+                    int cmp = 0;
+                    if (lookup.node) {
+                        cmp = tree.compareKeys(*lookup.key, lookup.node->value.first);
+                        if (cmp) {
+                            lookup.node = cmp < 0 ? lookup.node->left : lookup.node->right;
+                            AISDI_PREFETCH(lookup.node);
+                            ++i;
+                            continue;
+                        }
+                    }
+                    // finished - found, or fell off the tree
+                    found[lookup.slot] = lookup.node;
+                    if (next < n)
+                        lookup = Lookup{keys[next], root, next}, ++next, ++i;
+                    else
+                        lookup = lookups[--active];
+                }
+            }
+
+            for (std::size_t i = 0; i < n; ++i)
+                *out++ = found[i] ? &found[i]->value : nullptr;
+        }
+        return out;
+    }
+
+    // Moves all items with keys not less than key into the empty map upper,
+    // without copying them. Iterators to moved items must not be used after.
+    void splitOff(const key_type& key, TreeMap& upper) {
+        tree.splitOff(key, upper.tree);
+    }
+
     iterator begin() {
         auto node = tree.getFirstNode();
         return Iterator(&tree, node, !static_cast<bool>(node));
@@ -138,22 +297,211 @@ public:
     const_iterator end() const {
         return cend();
     }
+
+    // Calls fn(value_type&) for every item, on up to threads threads. fn must
+    // be safe to call concurrently and must not add or remove items.
+    template <typename Fn>
+    void forEachParallel(Fn fn, unsigned threads = defaultThreadsNumber()) {
+        foldParallel(NoResult(), [&fn](NoResult&, typename Tree::BSTNode *node) { fn(node->value); },
+                     threads);
+    }
+
+    template <typename Fn>
+    void forEachParallel(Fn fn, unsigned threads = defaultThreadsNumber()) const {
+        foldParallel(NoResult(), [&fn](NoResult&, typename Tree::BSTNode *node) {
+            fn(const_cast<const value_type&>(node->value));
+        }, threads);
+    }
+
+    // Folds mapFn(item) of every item with reduceFn, on up to threads threads.
+    // Workers fold consecutive runs of items from identity and the runs'
+    // results are combined in key order, so for an associative reduceFn with
+    // identity as its neutral element the result equals that of a sequential
+    // fold, however the work got split.
+    template <typename Acc, typename MapFn, typename ReduceFn>
+    Acc reduceParallel(Acc identity, MapFn mapFn, ReduceFn reduceFn,
+                       unsigned threads = defaultThreadsNumber()) const {
+        auto partials = foldParallel(identity, [&](Acc& acc, typename Tree::BSTNode *node) {
+            acc = reduceFn(std::move(acc), mapFn(const_cast<const value_type&>(node->value)));
+        }, threads);
+        Acc result = std::move(identity);
+        for (auto& partial : partials)
+            result = reduceFn(std::move(result), std::move(partial));
+        return result;
+    }
+
+    // Writes a binary snapshot of the map (see Serialization.h), in key order.
+    // Throws SnapshotError if the stream fails.
+    void save(std::ostream& out) const {
+        writeSnapshot<KeyType, ValueType>(out, tree.getSize(), SNAPSHOT_SORTED, [this](const auto& emit) {
+            tree.forEachNode([&emit](typename Tree::BSTNode *node) { emit(node->value); });
+        });
+    }
+
+    // Replaces the contents with a snapshot written by save() of either map.
+    // Items found in strictly increasing order, as TreeMap writes them, are
+    // made into a balanced tree in O(n); others are sorted first.
+    // Throws SnapshotError, leaving the map untouched, if the snapshot is
+    // damaged or holds other types.
+    void load(std::istream& in) {
+        SnapshotReader<KeyType, ValueType> reader(in);
+        std::vector<std::pair<KeyType, ValueType>> items;
+        std::vector<KeyType> keys;
+        std::vector<ValueType> values;
+        bool sorted = true;
+        while (reader.nextBlock(keys, values)) {
+            for (std::size_t i = 0; i < keys.size(); ++i) {
+                if (!items.empty() && tree.compareKeys(items.back().first, keys[i]) >= 0)
+                    sorted = false;
+                items.emplace_back(std::move(keys[i]), std::move(values[i]));
+            }
+        }
+
+        TreeMap loaded(keyComp());
+        if (sorted)
+            loaded.tree.buildFromSorted(std::make_move_iterator(items.begin()),
+                                        std::make_move_iterator(items.end()));
+        else
+            loaded = buildParallel(std::make_move_iterator(items.begin()),
+                                   std::make_move_iterator(items.end()), 1, keyComp());
+        *this = std::move(loaded);
+    }
+
+private:
+    static constexpr std::size_t LOOKUP_WINDOW = 256;
+
+    // fold(acc, node) over the tree by up to threads workers; returns the
+    // accumulators of the folded runs in key order.
+    //
+    // A task is a subtree (or a node and its right subtree), walked in order
+    // with an explicit stack. While some worker idles, a busy one donates the
+    // bottom of its stack - the node furthest in key order together with its
+    // right subtree - as a new task, so a skewed tree still keeps everybody
+    // busy. The donated run follows whatever is left of the donor's task, and
+    // precedes anything donated from it earlier, so its result slot goes
+    // right behind the donor's. A stack of one node, as in a list-shaped tree,
+    // has no bottom to give: then the right spine below the node is split in
+    // the middle, the lower half donated, and the donor stops where it begins.
+    template <typename Acc, typename Fold>
+    std::list<Acc> foldParallel(const Acc& identity, Fold fold, unsigned threads) const {
+        using BSTNode = typename Tree::BSTNode;
+        using Slot = typename std::list<Acc>::iterator;
+        struct Task {
+            BSTNode *node;
+            bool withLeft;
+            Slot slot;
+            BSTNode *stop; // first node of a later task, not walked into
+        };
+
+        std::list<Acc> slots; // guarded by lock, like everything below
+        if (tree.isEmpty()) return slots;
+        const unsigned workers = workersFor(tree.getSize(), threads);
+        std::mutex lock;
+        std::condition_variable wake;
+        std::deque<Task> pending;
+        unsigned busy = 0;
+        bool failed = false;
+        std::atomic<bool> starving{false}; // hint for busy workers, read without lock
+        pending.push_back(Task{tree.getRoot(), true, slots.insert(slots.end(), identity), nullptr});
+
+        runWorkers(workers, [&](unsigned) {
+            std::vector<BSTNode*> stack; // top = next in key order
+            std::unique_lock<std::mutex> guard(lock);
+            for (;;) {
+                wake.wait(guard, [&] { return failed || !pending.empty() || !busy; });
+                if (failed || pending.empty()) return;
+                Task task = pending.front();
+                pending.pop_front();
+                ++busy;
+                starving.store(pending.empty() && busy < workers, std::memory_order_relaxed);
+                guard.unlock();
+
+                Acc acc = identity;
+                try {
+                    stack.clear();
+                    stack.push_back(task.node);
+                    if (task.withLeft)
+                        for (BSTNode *child = task.node->left; child; child = child->left)
+                            stack.push_back(child);
+                    while (!stack.empty()) {
+                        if (starving.load(std::memory_order_relaxed)) {
+                            BSTNode *donated = nullptr;
+                            bool withLeft = false;
+                            if (stack.size() > 1) {
+                                donated = stack.front();
+                            } else {
+                                std::size_t spine = 0;
+                                for (BSTNode *n = stack.back()->right; n && n != task.stop; n = n->right) ++spine;
+                                if (spine > 1) {
+                                    donated = stack.back()->right;
+                                    for (std::size_t i = 0; i < spine / 2; ++i) donated = donated->right;
+                                    withLeft = true;
+                                }
+                            }
+                            std::lock_guard<std::mutex> donation(lock);
+                            if (donated && pending.empty()) {
+                                pending.push_back(Task{donated, withLeft,
+                                                       slots.insert(std::next(task.slot), identity), task.stop});
+                                if (withLeft)
+                                    task.stop = donated;
+                                else
+                                    stack.erase(stack.begin());
+                                starving.store(false, std::memory_order_relaxed);
+                                wake.notify_one();
+                            }
+                        }
+                        BSTNode *node = stack.back();
+                        stack.pop_back();
+                        fold(acc, node);
+                        if (node->right != task.stop)
+                            for (BSTNode *child = node->right; child; child = child->left)
+                                stack.push_back(child);
+                    }
+                } catch (...) {
+                    guard.lock();
+                    failed = true;
+                    --busy;
+                    wake.notify_all();
+                    throw;
+                }
+
+                guard.lock();
+                *task.slot = std::move(acc);
+                --busy;
+                starving.store(pending.empty() && busy < workers, std::memory_order_relaxed);
+                if (!busy && pending.empty()) wake.notify_all();
+            }
+        });
+        return slots;
+    }
 };
 
-template<typename KeyType, typename ValueType>
-class TreeMap<KeyType, ValueType>::ConstIterator {
+template<typename KeyType, typename ValueType, typename Compare>
+constexpr std::size_t TreeMap<KeyType, ValueType, Compare>::DEFAULT_LOOKUP_GROUP;
+
+template<typename KeyType, typename ValueType, typename Compare>
+constexpr std::size_t TreeMap<KeyType, ValueType, Compare>::MAX_LOOKUP_GROUP;
+
+template<typename KeyType, typename ValueType, typename Compare>
+class TreeMap<KeyType, ValueType, Compare>::ConstIterator {
     friend class TreeMap;
-    const BST<KeyType, ValueType> *tree;
-    typename BST<KeyType, ValueType>::BSTNode *node;
+    const Tree *tree;
+    typename Tree::BSTNode *node;
     bool isEnd;
 public:
     using reference = typename TreeMap::const_reference;
     using iterator_category = std::bidirectional_iterator_tag;
     using value_type = typename TreeMap::value_type;
+    using difference_type = std::ptrdiff_t;
     using pointer = const typename TreeMap::value_type*;
 
-    explicit ConstIterator(const BST<KeyType, ValueType> *t,
-                           typename BST<KeyType, ValueType>::BSTNode *n,
+    // an end iterator of no map
+    ConstIterator()
+        : tree(nullptr), node(nullptr), isEnd(true)
+    { }
+
+    explicit ConstIterator(const Tree *t,
+                           typename Tree::BSTNode *n,
                            bool end)
         : tree(t), node(n), isEnd(end)
     { }
@@ -216,14 +564,14 @@ public:
     }
 };
 
-template<typename KeyType, typename ValueType>
-class TreeMap<KeyType, ValueType>::Iterator : public TreeMap<KeyType, ValueType>::ConstIterator {
+template<typename KeyType, typename ValueType, typename Compare>
+class TreeMap<KeyType, ValueType, Compare>::Iterator : public TreeMap<KeyType, ValueType, Compare>::ConstIterator {
 public:
     using reference = typename TreeMap::reference;
     using pointer = typename TreeMap::value_type*;
 
-    explicit Iterator(const BST<KeyType, ValueType> *t,
-                      typename BST<KeyType, ValueType>::BSTNode *n,
+    explicit Iterator(const Tree *t,
+                      typename Tree::BSTNode *n,
                       bool end)
         : ConstIterator(t, n, end)
     { }
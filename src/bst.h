@@ -3,9 +3,63 @@
 
 #include <iostream>
 #include <string>
+#include <functional>
+#include <type_traits>
+#include <stdexcept>
+#include <vector>
+#include <exception>
+#include <thread>
+
+// Three-way comparison of two keys: negative if a < b, zero if equivalent,
+// positive if a > b. The generic version asks the ordering twice at most;
+// the specializations below answer with a single comparison.
+template <typename KeyType, typename Compare, typename = void>
+struct ThreeWayCompare {
+    static int compare(const Compare& less, const KeyType& a, const KeyType& b) {
+        if (less(a, b)) return -1;
+        if (less(b, a)) return 1;
+        return 0;
+    }
+};
+
+template <typename KeyType>
+struct ThreeWayCompare<KeyType, std::less<KeyType>,
+                       typename std::enable_if<std::is_arithmetic<KeyType>::value>::type> {
+    static int compare(const std::less<KeyType>&, const KeyType& a, const KeyType& b) {
+        // branchless "spaceship", no overflow unlike a - b
+        return (a > b) - (a < b);
+    }
+};
+
+template <typename CharT, typename Traits, typename Alloc>
+struct ThreeWayCompare<std::basic_string<CharT, Traits, Alloc>,
+                       std::less<std::basic_string<CharT, Traits, Alloc>>> {
+    using string = std::basic_string<CharT, Traits, Alloc>;
+    static int compare(const std::less<string>&, const string& a, const string& b) {
+        // walks the common prefix once
+        return a.compare(b);
+    }
+};
 
-template <typename KeyType, typename T>
-class BST {
+// Holds the comparator without spending space on stateless ones.
+template <typename Compare,
+          bool = std::is_empty<Compare>::value && !std::is_final<Compare>::value>
+class CompareHolder : private Compare {
+public:
+    CompareHolder(const Compare& c) : Compare(c) { }
+    const Compare& getComparator() const { return *this; }
+};
+
+template <typename Compare>
+class CompareHolder<Compare, false> {
+    Compare comparator;
+public:
+    CompareHolder(const Compare& c) : comparator(c) { }
+    const Compare& getComparator() const { return comparator; }
+};
+
+template <typename KeyType, typename T, typename Compare = std::less<KeyType>>
+class BST : private CompareHolder<Compare> {
 public:
     struct BSTNode;
 private:
@@ -14,20 +68,30 @@ private:
 public:
     struct BSTNode;
 
-    BST() = default;
-    BST(const BST<KeyType, T>& other);
-    BST(BST<KeyType, T>&& other);
+    explicit BST(const Compare& comp = Compare())
+        : CompareHolder<Compare>(comp)
+    { }
+    BST(const BST<KeyType, T, Compare>& other);
+    BST(BST<KeyType, T, Compare>&& other) noexcept(std::is_nothrow_copy_constructible<Compare>::value);
     ~BST();
-    BST<KeyType, T>& operator=(const BST<KeyType, T>& other);
-    BST<KeyType, T>& operator=(BST<KeyType, T>&& other);
-    bool operator==(const BST<KeyType, T>& other) const;
-    bool operator!=(const BST<KeyType, T>& other) const;
+    BST<KeyType, T, Compare>& operator=(const BST<KeyType, T, Compare>& other);
+    BST<KeyType, T, Compare>& operator=(BST<KeyType, T, Compare>&& other)
+        noexcept(std::is_nothrow_copy_assignable<Compare>::value);
+    bool operator==(const BST<KeyType, T, Compare>& other) const;
+    bool operator!=(const BST<KeyType, T, Compare>& other) const;
 
         template <typename Kk, typename Tt>
     BSTNode* insert(Kk&& key, Tt&& item);
         template <typename Kk>
     BSTNode* insert(Kk&& key);
+    BSTNode* adoptNode(BSTNode *node);
+        template <typename Kk>
+    BSTNode* insertBalanced(Kk&& key);
+    BSTNode* adoptBalanced(BSTNode *node);
+    BSTNode* adoptUnique(BSTNode *node);
     bool deleteKey(const KeyType& key);
+    BSTNode* extractNode(BSTNode *node);
+    BSTNode* getRoot() const;
     BSTNode* getFirstNode() const;
     BSTNode* getLastNode() const;
     BSTNode* getNextNode(BSTNode *node) const;
@@ -36,6 +100,15 @@ public:
     std::size_t getSize() const;
     BSTNode* findNodeWithKey(const KeyType& key) const;
     void clear();
+    const Compare& keyComp() const;
+    int compareKeys(const KeyType& a, const KeyType& b) const;
+    void splitOff(const KeyType& key, BST<KeyType, T, Compare>& upper);
+        template <typename RandomIt>
+    void buildFromSorted(RandomIt first, RandomIt last, unsigned threads = 1);
+        template <typename Fn>
+    void forEachNode(Fn fn) const;
+        template <typename Fn>
+    void releaseNodes(Fn fn);
 
 #ifdef DEBUG
     void print() const;
@@ -46,15 +119,23 @@ private:
     void print(BSTNode *node) const;
 #endif
 
-    void treeCopyingHelper(const BSTNode* otherTreeNode);
+    void cloneFrom(const BSTNode *otherRoot);
         template <typename Kk, typename Tt>
     BSTNode* insertHelper(BSTNode *current, Kk&& key, Tt&& item);
     bool deleteKeyHelper(BSTNode *current, const KeyType& key);
+    void unlinkNode(BSTNode *node);
+    void replaceInParent(BSTNode *node, BSTNode *replacement);
     void deleteTreeHelper(BSTNode *current);
+    static std::size_t countNodes(BSTNode *current);
+    void rebalanceAfter(BSTNode *inserted);
+    void rebuildSubtree(BSTNode *top);
+    static BSTNode* linkBalanced(BSTNode **first, BSTNode **last, BSTNode *parent);
+        template <typename RandomIt>
+    BSTNode* buildBalanced(RandomIt first, RandomIt last, BSTNode *parent, unsigned threads);
 };
 
-template <typename KeyType, typename T>
-struct BST<KeyType, T>::BSTNode {
+template <typename KeyType, typename T, typename Compare>
+struct BST<KeyType, T, Compare>::BSTNode {
     std::pair<const KeyType, T> value;
 
     union {
@@ -74,13 +155,13 @@ struct BST<KeyType, T>::BSTNode {
 };
 
 #ifdef DEBUG
-template <typename KeyType, typename T>
-void BST<KeyType, T>::print() const {
+template <typename KeyType, typename T, typename Compare>
+void BST<KeyType, T, Compare>::print() const {
     print(root);
 }
 
-template <typename KeyType, typename T>
-void BST<KeyType, T>::print(BSTNode *node) const {
+template <typename KeyType, typename T, typename Compare>
+void BST<KeyType, T, Compare>::print(BSTNode *node) const {
     if (!node) return;
     std::cout << node->value.first <<": "<< node->value.second << "\n";
     print(node->left);
@@ -90,23 +171,27 @@ void BST<KeyType, T>::print(BSTNode *node) const {
 
 
 
-template <typename KeyType, typename T>
-BST<KeyType, T>::BST(const BST<KeyType, T>& other) {
+template <typename KeyType, typename T, typename Compare>
+BST<KeyType, T, Compare>::BST(const BST<KeyType, T, Compare>& other)
+    : CompareHolder<Compare>(other.keyComp()) {
     operator=(other);
 }
 
-template <typename KeyType, typename T>
-BST<KeyType, T>::BST(BST<KeyType, T>&& other) {
-    operator=(std::move(other));
+template <typename KeyType, typename T, typename Compare>
+BST<KeyType, T, Compare>::BST(BST<KeyType, T, Compare>&& other)
+    noexcept(std::is_nothrow_copy_constructible<Compare>::value)
+    : CompareHolder<Compare>(other.keyComp()), root(other.root), size(other.size) {
+    other.root = nullptr;
+    other.size = 0;
 }
 
-template <typename KeyType, typename T>
-BST<KeyType, T>::~BST() {
+template <typename KeyType, typename T, typename Compare>
+BST<KeyType, T, Compare>::~BST() {
     clear();
 }
 
-template <typename KeyType, typename T>
-bool BST<KeyType, T>::operator==(const BST<KeyType, T>& other) const {
+template <typename KeyType, typename T, typename Compare>
+bool BST<KeyType, T, Compare>::operator==(const BST<KeyType, T, Compare>& other) const {
     if (size != other.size)
         return false;
     if (size == 0u)
@@ -124,35 +209,60 @@ bool BST<KeyType, T>::operator==(const BST<KeyType, T>& other) const {
     return true;
 }
 
-template <typename KeyType, typename T>
-bool BST<KeyType, T>::operator!=(const BST<KeyType, T>& other) const {
+template <typename KeyType, typename T, typename Compare>
+bool BST<KeyType, T, Compare>::operator!=(const BST<KeyType, T, Compare>& other) const {
     return !operator==(other);
 }
 
-template <typename KeyType, typename T>
-BST<KeyType, T>& BST<KeyType, T>::operator=(const BST<KeyType, T>& other) {
-    if (root == other.root) {
+template <typename KeyType, typename T, typename Compare>
+BST<KeyType, T, Compare>& BST<KeyType, T, Compare>::operator=(const BST<KeyType, T, Compare>& other) {
+    if (this == &other) {
         return *this;
     }
     clear();
-    treeCopyingHelper(other.root);
+    static_cast<CompareHolder<Compare>&>(*this) = other;
+    try {
+        cloneFrom(other.root);
+    } catch (...) {
+        clear();
+        throw;
+    }
+    size = other.size;
     return *this;
 }
 
-template <typename KeyType, typename T>
-void BST<KeyType, T>::treeCopyingHelper(const BSTNode *otherTreeNode) {
-    if (!otherTreeNode) return;
-    insert(otherTreeNode->value.first, otherTreeNode->value.second);
-    treeCopyingHelper(otherTreeNode->left);
-    treeCopyingHelper(otherTreeNode->right);
+// Copies the shape of the tree under otherRoot node by node, in one walk
+// through the parent pointers - no key comparisons, no recursion.
+template <typename KeyType, typename T, typename Compare>
+void BST<KeyType, T, Compare>::cloneFrom(const BSTNode *otherRoot) {
+    if (!otherRoot) return;
+    root = new BSTNode(nullptr, otherRoot->value.first, otherRoot->value.second);
+    const BSTNode *source = otherRoot;
+    BSTNode *copy = root;
+    for (;;) {
+        if (source->left && !copy->left) {
+            source = source->left;
+            copy = copy->left = new BSTNode(copy, source->value.first, source->value.second);
+        } else if (source->right && !copy->right) {
+            source = source->right;
+            copy = copy->right = new BSTNode(copy, source->value.first, source->value.second);
+        } else if (source != otherRoot) {
+            source = source->parent;
+            copy = copy->parent;
+        } else {
+            break;
+        }
+    }
 }
 
-template <typename KeyType, typename T>
-BST<KeyType, T>& BST<KeyType, T>::operator=(BST<KeyType, T>&& other) {
-    if (root == other.root) {
+template <typename KeyType, typename T, typename Compare>
+BST<KeyType, T, Compare>& BST<KeyType, T, Compare>::operator=(BST<KeyType, T, Compare>&& other)
+    noexcept(std::is_nothrow_copy_assignable<Compare>::value) {
+    if (this == &other) {
         return *this;
     }
     clear();
+    static_cast<CompareHolder<Compare>&>(*this) = other;
     root = other.root;
     size = other.size;
     other.root = nullptr;
@@ -160,9 +270,9 @@ BST<KeyType, T>& BST<KeyType, T>::operator=(BST<KeyType, T>&& other) {
     return *this;
 }
 
-template <typename KeyType, typename T>
+template <typename KeyType, typename T, typename Compare>
 template <typename Kk, typename Tt>
-typename BST<KeyType, T>::BSTNode* BST<KeyType, T>::insert(Kk&& key, Tt&& item) {
+typename BST<KeyType, T, Compare>::BSTNode* BST<KeyType, T, Compare>::insert(Kk&& key, Tt&& item) {
     if (!root) {
         root = new BSTNode(NULL, std::forward<Kk>(key), std::forward<Tt>(item));
         ++size;
@@ -171,23 +281,26 @@ typename BST<KeyType, T>::BSTNode* BST<KeyType, T>::insert(Kk&& key, Tt&& item)
     return insertHelper(root, std::forward<Kk>(key), std::forward<Tt>(item));
 }
 
-template <typename KeyType, typename T>
+template <typename KeyType, typename T, typename Compare>
 template <typename Kk>
-typename BST<KeyType, T>::BSTNode* BST<KeyType, T>::insert(Kk&& key) {
-    return insert(key, T());
+typename BST<KeyType, T, Compare>::BSTNode* BST<KeyType, T, Compare>::insert(Kk&& key) {
+    return insert(std::forward<Kk>(key), T());
 }
 
-template <typename KeyType, typename T>
+template <typename KeyType, typename T, typename Compare>
 template <typename Kk, typename Tt>
-typename BST<KeyType, T>::BSTNode* BST<KeyType, T>::insertHelper(BSTNode *current, Kk&& key, Tt&& item) {
+typename BST<KeyType, T, Compare>::BSTNode* BST<KeyType, T, Compare>::insertHelper(BSTNode *current, Kk&& key, Tt&& item) {
     BSTNode *node = current;
     // root exist here
+    // converted once, so that e.g. a const char* isn't turned into a string per node
+    const KeyType& searched = key;
 
     for (;;) {
-        if (node->value.first == key) {
+        int cmp = compareKeys(searched, node->value.first);
+        if (cmp == 0) {
             return node;
         }
-        if (node->value.first > key) {
+        if (cmp < 0) {
             if (!node->left) {
                 node->left = new BSTNode(node, std::forward<Kk>(key), std::forward<Tt>(item));
                 ++size;
@@ -209,57 +322,193 @@ typename BST<KeyType, T>::BSTNode* BST<KeyType, T>::insertHelper(BSTNode *curren
     }
 }
 
-template <typename KeyType, typename T>
-bool BST<KeyType, T>::deleteKey(const KeyType& key) {
+// Links in a node allocated elsewhere, with no children, whose key isn't in
+// the tree yet; the tree owns it from then on.
+template <typename KeyType, typename T, typename Compare>
+typename BST<KeyType, T, Compare>::BSTNode* BST<KeyType, T, Compare>::adoptNode(BSTNode *node) {
+    BSTNode **hook = &root, *parent = nullptr;
+    while (*hook) {
+        parent = *hook;
+        hook = compareKeys(node->value.first, parent->value.first) < 0 ? &parent->left : &parent->right;
+    }
+    node->parent = parent;
+    *hook = node;
+    ++size;
+    return node;
+}
+
+// insert() and adoptNode() keeping the tree a scapegoat tree (alpha = 2/3):
+// a node inserted deeper than log_{3/2}(size) makes its lowest ancestor
+// holding more than 2/3 of its subtree in one child rebuild that subtree
+// perfectly balanced. The height stays O(log n) - of the most nodes since
+// the last rebuild, as removals don't rebalance - at amortized O(log n) per
+// insert, with no balance data in the nodes. Nodes are relinked, not moved.
+template <typename KeyType, typename T, typename Compare>
+template <typename Kk>
+typename BST<KeyType, T, Compare>::BSTNode* BST<KeyType, T, Compare>::insertBalanced(Kk&& key) {
+    std::size_t before = size;
+    BSTNode *node = insert(std::forward<Kk>(key));
+    if (size != before) rebalanceAfter(node);
+    return node;
+}
+
+template <typename KeyType, typename T, typename Compare>
+typename BST<KeyType, T, Compare>::BSTNode* BST<KeyType, T, Compare>::adoptBalanced(BSTNode *node) {
+    adoptNode(node);
+    rebalanceAfter(node);
+    return node;
+}
+
+// adoptBalanced(), in the same descent as the lookup, unless node's key is in
+// the tree already; then node is left alone and the node with the key is
+// returned instead.
+template <typename KeyType, typename T, typename Compare>
+typename BST<KeyType, T, Compare>::BSTNode* BST<KeyType, T, Compare>::adoptUnique(BSTNode *node) {
+    BSTNode **hook = &root, *parent = nullptr;
+    while (*hook) {
+        parent = *hook;
+        int cmp = compareKeys(node->value.first, parent->value.first);
+        if (!cmp) return parent;
+        hook = cmp < 0 ? &parent->left : &parent->right;
+    }
+    node->parent = parent;
+    *hook = node;
+    ++size;
+    rebalanceAfter(node);
+    return node;
+}
+
+template <typename KeyType, typename T, typename Compare>
+void BST<KeyType, T, Compare>::rebalanceAfter(BSTNode *inserted) {
+    std::size_t depth = 0;
+    for (BSTNode *node = inserted; node->parent; node = node->parent) ++depth;
+    double bound = 1; // (3/2)^depth
+    for (std::size_t i = 0; i < depth && bound <= size; ++i) bound *= 1.5;
+    if (bound <= size) return;
+
+    BSTNode *child = inserted;
+    std::size_t childSize = 1;
+    while (child->parent) {
+        BSTNode *parent = child->parent;
+        std::size_t parentSize = childSize + 1 + countNodes(parent->left == child ? parent->right : parent->left);
+        if (3 * childSize > 2 * parentSize) {
+            rebuildSubtree(parent);
+            return;
+        }
+        child = parent;
+        childSize = parentSize;
+    }
+    rebuildSubtree(root);
+}
+
+template <typename KeyType, typename T, typename Compare>
+void BST<KeyType, T, Compare>::rebuildSubtree(BSTNode *top) {
+    BSTNode *parent = top->parent;
+    BSTNode **hook = !parent ? &root : parent->left == top ? &parent->left : &parent->right;
+    std::vector<BSTNode*> nodes;
+    std::vector<BSTNode*> pending;
+    for (BSTNode *node = top; node || !pending.empty();) {
+        if (node) {
+            pending.push_back(node);
+            node = node->left;
+        } else {
+            node = pending.back();
+            pending.pop_back();
+            nodes.push_back(node);
+            node = node->right;
+        }
+    }
+    *hook = linkBalanced(nodes.data(), nodes.data() + nodes.size(), parent);
+}
+
+template <typename KeyType, typename T, typename Compare>
+typename BST<KeyType, T, Compare>::BSTNode*
+BST<KeyType, T, Compare>::linkBalanced(BSTNode **first, BSTNode **last, BSTNode *parent) {
+    if (first == last) return nullptr;
+    BSTNode **middle = first + (last - first) / 2;
+    BSTNode *node = *middle;
+    node->parent = parent;
+    node->left = linkBalanced(first, middle, node);
+    node->right = linkBalanced(middle + 1, last, node);
+    return node;
+}
+
+template <typename KeyType, typename T, typename Compare>
+bool BST<KeyType, T, Compare>::deleteKey(const KeyType& key) {
     return deleteKeyHelper(root, key);
 }
 
-template <typename KeyType, typename T>
-bool BST<KeyType, T>::deleteKeyHelper(BSTNode *current, const KeyType& key) {
+template <typename KeyType, typename T, typename Compare>
+bool BST<KeyType, T, Compare>::deleteKeyHelper(BSTNode *current, const KeyType& key) {
     if (!current) return false;
     BSTNode *node = current;
     for(;node;) {
-        if (node->value.first > key) node = node->left;
-        else if (node->value.first < key) node = node->right;
+        int cmp = compareKeys(key, node->value.first);
+        if (cmp < 0) node = node->left;
+        else if (cmp > 0) node = node->right;
         else break;
     }
     // if item wasn't found
     if (!node) return false;
     // here node is the one to delete
 
-    if (!node->left || !node->right) {
-        BSTNode* temp = node->left;
-        if (node->right) temp = node->right;
-        if (node->parent) {
-            if (node->parent->left == node) {
-                node->parent->left = temp;
-            } else {
-                node->parent->right = temp;
-            }
-        } else {
-            root = temp;
-        }
-    } else {
+    unlinkNode(node);
+    delete node;
+    return true;
+}
+
+// Unlinks node from the tree without freeing it and hands it back, with no
+// links, for adoptNode() of this or another tree.
+template <typename KeyType, typename T, typename Compare>
+typename BST<KeyType, T, Compare>::BSTNode* BST<KeyType, T, Compare>::extractNode(BSTNode *node) {
+    unlinkNode(node);
+    return node;
+}
+
+template <typename KeyType, typename T, typename Compare>
+void BST<KeyType, T, Compare>::unlinkNode(BSTNode *node) {
+    if (node->left && node->right) {
+        // successor takes node's place - relinked rather than swapped by value,
+        // because std::pair<CONST Key, T> can't be reassigned
         BSTNode* validSubs = node->right;
         while (validSubs->left) {
             validSubs = validSubs->left;
         }
-
-        // magical swap of 2 nodes without reassigning std::pair<CONST Key, T>
-        BSTNode* temp[] = {node->nodePointers[0], node->nodePointers[1], node->nodePointers[2]};
-        for(int i=0;i<3;++i) node->nodePointers[i] = validSubs->nodePointers[i];
-        for(int i=0;i<3;++i) validSubs->nodePointers[i] = temp[i];
-
-        return deleteKeyHelper(node->right, validSubs->value.first);
+        if (validSubs != node->right) {
+            replaceInParent(validSubs, validSubs->right);
+            validSubs->right = node->right;
+            validSubs->right->parent = validSubs;
+        }
+        validSubs->left = node->left;
+        validSubs->left->parent = validSubs;
+        replaceInParent(node, validSubs);
+    } else {
+        replaceInParent(node, node->left ? node->left : node->right);
     }
-    // here node is a leaf
-    delete node;
+    node->left = node->right = node->parent = nullptr;
     --size;
-    return true;
 }
 
-template <typename KeyType, typename T>
-typename BST<KeyType, T>::BSTNode* BST<KeyType, T>::getFirstNode() const {
+template <typename KeyType, typename T, typename Compare>
+void BST<KeyType, T, Compare>::replaceInParent(BSTNode *node, BSTNode *replacement) {
+    if (replacement) replacement->parent = node->parent;
+    if (!node->parent) {
+        root = replacement;
+    } else if (node->parent->left == node) {
+        node->parent->left = replacement;
+    } else {
+        node->parent->right = replacement;
+    }
+}
+
+
+template <typename KeyType, typename T, typename Compare>
+typename BST<KeyType, T, Compare>::BSTNode* BST<KeyType, T, Compare>::getRoot() const {
+    return root;
+}
+
+template <typename KeyType, typename T, typename Compare>
+typename BST<KeyType, T, Compare>::BSTNode* BST<KeyType, T, Compare>::getFirstNode() const {
     if (!root) return nullptr;
     BSTNode *node = root;
     node = root;
@@ -267,16 +516,16 @@ typename BST<KeyType, T>::BSTNode* BST<KeyType, T>::getFirstNode() const {
     return node;
 }
 
-template <typename KeyType, typename T>
-typename BST<KeyType, T>::BSTNode* BST<KeyType, T>::getLastNode() const {
+template <typename KeyType, typename T, typename Compare>
+typename BST<KeyType, T, Compare>::BSTNode* BST<KeyType, T, Compare>::getLastNode() const {
     if (!root) return nullptr;
     BSTNode *node = root;
     while(node->right) node = node->right;
     return node;
 }
 
-template <typename KeyType, typename T>
-typename BST<KeyType, T>::BSTNode* BST<KeyType, T>::getNextNode(BSTNode *node) const {
+template <typename KeyType, typename T, typename Compare>
+typename BST<KeyType, T, Compare>::BSTNode* BST<KeyType, T, Compare>::getNextNode(BSTNode *node) const {
     if (!node) throw std::out_of_range("end of tree");
     if (node->right) {
         node = node->right;
@@ -297,8 +546,8 @@ typename BST<KeyType, T>::BSTNode* BST<KeyType, T>::getNextNode(BSTNode *node) c
     return nullptr;
 }
 
-template <typename KeyType, typename T>
-typename BST<KeyType, T>::BSTNode* BST<KeyType, T>::getPreviousNode(BSTNode *node) const {
+template <typename KeyType, typename T, typename Compare>
+typename BST<KeyType, T, Compare>::BSTNode* BST<KeyType, T, Compare>::getPreviousNode(BSTNode *node) const {
     if (!node) throw std::out_of_range("end of tree");
     if (node->left) {
         node = node->left;
@@ -319,42 +568,209 @@ typename BST<KeyType, T>::BSTNode* BST<KeyType, T>::getPreviousNode(BSTNode *nod
     return nullptr;
 }
 
-template <typename KeyType, typename T>
-bool BST<KeyType, T>::isEmpty() const {
+template <typename KeyType, typename T, typename Compare>
+bool BST<KeyType, T, Compare>::isEmpty() const {
     return !size;
 }
 
-template <typename KeyType, typename T>
-std::size_t BST<KeyType, T>::getSize() const {
+template <typename KeyType, typename T, typename Compare>
+std::size_t BST<KeyType, T, Compare>::getSize() const {
     return size;
 }
 
 
-template <typename KeyType, typename T>
-typename BST<KeyType, T>::BSTNode* BST<KeyType, T>::findNodeWithKey(const KeyType& key) const {
+template <typename KeyType, typename T, typename Compare>
+typename BST<KeyType, T, Compare>::BSTNode* BST<KeyType, T, Compare>::findNodeWithKey(const KeyType& key) const {
     BSTNode *node = root;
     for(;node;) {
-        if (node->value.first > key) node = node->left;
-        else if (node->value.first < key) node = node->right;
+        int cmp = compareKeys(key, node->value.first);
+        if (cmp < 0) node = node->left;
+        else if (cmp > 0) node = node->right;
         else break;
     }
     return node;
 }
 
-template <typename KeyType, typename T>
-void BST<KeyType, T>::clear() {
+template <typename KeyType, typename T, typename Compare>
+const Compare& BST<KeyType, T, Compare>::keyComp() const {
+    return CompareHolder<Compare>::getComparator();
+}
+
+template <typename KeyType, typename T, typename Compare>
+int BST<KeyType, T, Compare>::compareKeys(const KeyType& a, const KeyType& b) const {
+    return ThreeWayCompare<KeyType, Compare>::compare(keyComp(), a, b);
+}
+
+// Moves every node with key not less than the given one into the empty tree
+// upper. Nodes are relinked, not copied - one walk down the tree plus a count
+// of the moved nodes.
+template <typename KeyType, typename T, typename Compare>
+void BST<KeyType, T, Compare>::splitOff(const KeyType& key, BST<KeyType, T, Compare>& upper) {
+    if (!upper.isEmpty()) throw std::logic_error("splitting into non-empty tree");
+    BSTNode *lowerRoot = nullptr, *upperRoot = nullptr;
+    // where the next node of each part gets attached
+    BSTNode **lowerHook = &lowerRoot, **upperHook = &upperRoot;
+    BSTNode *lowerParent = nullptr, *upperParent = nullptr;
+    for (BSTNode *node = root; node;) {
+        if (compareKeys(node->value.first, key) < 0) {
+            *lowerHook = node;
+            node->parent = lowerParent;
+            lowerParent = node;
+            lowerHook = &node->right;
+            node = node->right;
+        } else {
+            *upperHook = node;
+            node->parent = upperParent;
+            upperParent = node;
+            upperHook = &node->left;
+            node = node->left;
+        }
+    }
+    *lowerHook = nullptr;
+    *upperHook = nullptr;
+
+    std::size_t moved = countNodes(upperRoot);
+    root = lowerRoot;
+    size -= moved;
+    upper.root = upperRoot;
+    upper.size = moved;
+}
+
+template <typename KeyType, typename T, typename Compare>
+std::size_t BST<KeyType, T, Compare>::countNodes(BSTNode *current) {
+    std::size_t count = 0;
+    std::vector<BSTNode*> pending;
+    if (current) pending.push_back(current);
+    while (!pending.empty()) {
+        BSTNode *node = pending.back();
+        pending.pop_back();
+        ++count;
+        if (node->left) pending.push_back(node->left);
+        if (node->right) pending.push_back(node->right);
+    }
+    return count;
+}
+
+// Replaces the contents with a perfectly balanced tree of the pairs of
+// [first, last), which must be sorted and free of equivalent keys. Subtrees
+// are built by up to threads threads at once. Dereferencing a move_iterator
+// moves the pairs in.
+template <typename KeyType, typename T, typename Compare>
+template <typename RandomIt>
+void BST<KeyType, T, Compare>::buildFromSorted(RandomIt first, RandomIt last, unsigned threads) {
+    clear();
+    root = buildBalanced(first, last, nullptr, threads ? threads : 1);
+    size = last - first;
+}
+
+template <typename KeyType, typename T, typename Compare>
+template <typename RandomIt>
+typename BST<KeyType, T, Compare>::BSTNode*
+BST<KeyType, T, Compare>::buildBalanced(RandomIt first, RandomIt last, BSTNode *parent, unsigned threads) {
+    if (first == last) return nullptr;
+    RandomIt middle = first + (last - first) / 2;
+    auto&& item = *middle;
+    BSTNode *node = new BSTNode(parent, std::forward<decltype(item)>(item).first,
+                                std::forward<decltype(item)>(item).second);
+    // on failure node is freed along with whatever got attached to it
+    try {
+        if (threads > 1) {
+            std::exception_ptr leftError;
+            std::thread worker([&]() {
+                try {
+                    node->left = buildBalanced(first, middle, node, threads / 2);
+                } catch (...) {
+                    leftError = std::current_exception();
+                }
+            });
+            try {
+                node->right = buildBalanced(middle + 1, last, node, threads - threads / 2);
+            } catch (...) {
+                worker.join();
+                throw;
+            }
+            worker.join();
+            if (leftError) std::rethrow_exception(leftError);
+        } else {
+            node->left = buildBalanced(first, middle, node, 1);
+            node->right = buildBalanced(middle + 1, last, node, 1);
+        }
+    } catch (...) {
+        deleteTreeHelper(node);
+        throw;
+    }
+    return node;
+}
+
+// Calls fn(node) for every node in key order. Unlike getNextNode() it doesn't
+// throw at the end, so it's cheap to run over many small trees. fn must not
+// change the tree's structure.
+template <typename KeyType, typename T, typename Compare>
+template <typename Fn>
+void BST<KeyType, T, Compare>::forEachNode(Fn fn) const {
+    BSTNode *node = getFirstNode();
+    while (node) {
+        fn(node);
+        if (node->right) {
+            node = node->right;
+            while (node->left) node = node->left;
+        } else {
+            while (node->parent && node == node->parent->right) node = node->parent;
+            node = node->parent;
+        }
+    }
+}
+
+// Empties the tree without freeing anything: detaches the nodes leaf by leaf
+// and hands each, with no links left, to fn, which takes ownership - e.g. to
+// adoptNode() it into another tree.
+template <typename KeyType, typename T, typename Compare>
+template <typename Fn>
+void BST<KeyType, T, Compare>::releaseNodes(Fn fn) {
+    BSTNode *node = root;
+    root = nullptr;
+    size = 0;
+    while (node) {
+        if (node->left) {
+            node = node->left;
+        } else if (node->right) {
+            node = node->right;
+        } else {
+            BSTNode *parent = node->parent;
+            if (parent) (parent->left == node ? parent->left : parent->right) = nullptr;
+            node->parent = nullptr;
+            fn(node);
+            node = parent;
+        }
+    }
+}
+
+template <typename KeyType, typename T, typename Compare>
+void BST<KeyType, T, Compare>::clear() {
     deleteTreeHelper(root);
     size = 0;
     root = nullptr;
 }
 
-template <typename KeyType, typename T>
-void BST<KeyType, T>::deleteTreeHelper(BSTNode *current) {
+// Deletes the subtree under current leaf by leaf, climbing back through the
+// parent pointers - no recursion, so a degenerate tree can't overflow the stack.
+template <typename KeyType, typename T, typename Compare>
+void BST<KeyType, T, Compare>::deleteTreeHelper(BSTNode *current) {
     if (!current) return;
-    deleteTreeHelper(current->left);
-    deleteTreeHelper(current->right);
-    current->left = current->right = current->parent = nullptr;
-    delete current;
+    BSTNode *top = current->parent;
+    BSTNode *node = current;
+    while (node != top) {
+        if (node->left) {
+            node = node->left;
+        } else if (node->right) {
+            node = node->right;
+        } else {
+            BSTNode *parent = node->parent;
+            if (parent != top) (parent->left == node ? parent->left : parent->right) = nullptr;
+            delete node;
+            node = parent;
+        }
+    }
 }
 
 
@@ -1,13 +1,28 @@
+#include <cmath>
 #include <cstddef>
 #include <string>
 #include <random>
 #include <fstream>
+#include <sstream>
+#include <list>
 #include <map>
 #include <unordered_map>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <numeric>
+#include <chrono>
 
 #include "HashMap.h"
 #include "Benchmark.h"
 #include "TreeMap.h"
+#include "ConcurrentHashMap.h"
+#include "SkipListMap.h"
+#include "LruCache.h"
+#include "CompactTreeMap.h"
+#include "CompactHashMap.h"
+#include "CuckooHashMap.h"
 
 
 template<class Collection, int N>
@@ -20,6 +35,462 @@ void randomInsert(int n) {
     }
 }
 
+// Wraps HashMap in one mutex - what the services did before ConcurrentHashMap.
+template<typename KeyType, typename ValueType>
+class SingleLockHashMap {
+    aisdi::HashMap<KeyType, ValueType> map;
+    mutable std::mutex lock;
+public:
+    bool find(const KeyType& key, ValueType& out) const {
+        std::lock_guard<std::mutex> guard(lock);
+        auto it = map.find(key);
+        if (it == map.end()) return false;
+        out = it->second;
+        return true;
+    }
+
+    void assign(const KeyType& key, const ValueType& value) {
+        std::lock_guard<std::mutex> guard(lock);
+        map[key] = value;
+    }
+};
+
+// Every thread does the same number of operations (90% reads, 10% writes),
+// so a flat time over growing thread counts means linear scaling.
+template<class Collection, int KEYS, int OPS_PER_THREAD>
+void mixedReadWrite(int threadsNumber) {
+    Collection map;
+    for (int i = 0; i < KEYS; ++i)
+        map.assign(i, i);
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < threadsNumber; ++t) {
+        threads.emplace_back([&map, t]() {
+            std::mt19937 device(t);
+            std::uniform_int_distribution<int> keys(0, KEYS - 1);
+            std::uniform_int_distribution<int> operation(0, 9);
+            int value;
+            for (int i = 0; i < OPS_PER_THREAD; ++i) {
+                int key = keys(device);
+                if (operation(device) == 0) map.assign(key, i);
+                else map.find(key, value);
+            }
+        });
+    }
+    for (auto& thread : threads)
+        thread.join();
+}
+
+// Threads insert disjoint random keys into one shared list.
+template<int INSERTS_PER_THREAD>
+void skipListInsertHeavy(int threadsNumber) {
+    aisdi::SkipListMap<int, int> map;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < threadsNumber; ++t) {
+        threads.emplace_back([&map, t, threadsNumber]() {
+            std::mt19937 device(t);
+            std::uniform_int_distribution<int> keys(0, 1 << 28);
+            for (int i = 0; i < INSERTS_PER_THREAD; ++i)
+                map.insert(keys(device) * threadsNumber + t, i);
+        });
+    }
+    for (auto& thread : threads)
+        thread.join();
+}
+
+// Every thread runs SCANS full ordered scans, inserting a key between scans.
+template<int KEYS, int SCANS>
+void skipListScanHeavy(int threadsNumber) {
+    aisdi::SkipListMap<int, int> map;
+    for (int i = 0; i < KEYS; ++i)
+        map.insert(2 * i, i);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < threadsNumber; ++t) {
+        threads.emplace_back([&map, t]() {
+            long long sum = 0;
+            for (int scan = 0; scan < SCANS; ++scan) {
+                for (const auto& item : map)
+                    sum += item.second;
+                map.insert(2 * (t * SCANS + scan) + 1, scan);
+            }
+            bm::doNotOptimize(sum);
+        });
+    }
+    for (auto& thread : threads)
+        thread.join();
+}
+
+// Lookups of random present keys in a map much larger than the cache.
+class LookupBenchmark {
+    static constexpr int ENTRIES = 2000000;
+    static constexpr int LOOKUPS = 2000000;
+public:
+    static const aisdi::HashMap<int, int>& map() {
+        static aisdi::HashMap<int, int> instance = []() {
+            aisdi::HashMap<int, int> m;
+            std::mt19937 device;
+            for (int i = 0; i < ENTRIES; ++i) m[static_cast<int>(device())] = i;
+            return m;
+        }();
+        return instance;
+    }
+
+    static const std::vector<int>& keys() {
+        static std::vector<int> instance = []() {
+            std::vector<int> k;
+            for (auto& item : map()) k.push_back(item.first);
+            std::shuffle(k.begin(), k.end(), std::mt19937());
+            k.resize(LOOKUPS);
+            return k;
+        }();
+        return instance;
+    }
+
+    static void findLoop(int) {
+        long long sum = 0;
+        for (int key : keys()) sum += map().find(key)->second;
+        bm::doNotOptimize(sum);
+    }
+
+    static void findBatch(int batchSize) {
+        long long sum = 0;
+        std::vector<const aisdi::HashMap<int, int>::value_type*> found(batchSize);
+        for (auto it = keys().begin(); it != keys().end();) {
+            auto batchEnd = keys().end() - it > batchSize ? it + batchSize : keys().end();
+            auto foundEnd = map().findBatch(it, batchEnd, found.begin());
+            for (auto f = found.begin(); f != foundEnd; ++f) sum += (*f)->second;
+            it = batchEnd;
+        }
+        bm::doNotOptimize(sum);
+    }
+};
+
+// Same lookups in a TreeMap, interleaved by findMany in groups of given size.
+class TreeLookupBenchmark {
+    static constexpr int ENTRIES = 1000000;
+    static constexpr int LOOKUPS = 1000000;
+public:
+    static const aisdi::TreeMap<int, int>& map() {
+        static aisdi::TreeMap<int, int> instance = []() {
+            aisdi::TreeMap<int, int> m;
+            std::mt19937 device;
+            for (int i = 0; i < ENTRIES; ++i) m[static_cast<int>(device())] = i;
+            return m;
+        }();
+        return instance;
+    }
+
+    static const std::vector<int>& keys() {
+        static std::vector<int> instance = []() {
+            std::vector<int> k;
+            for (auto& item : map()) k.push_back(item.first);
+            std::shuffle(k.begin(), k.end(), std::mt19937());
+            k.resize(LOOKUPS);
+            return k;
+        }();
+        return instance;
+    }
+
+    static void findLoop(int) {
+        long long sum = 0;
+        for (int key : keys()) sum += map().find(key)->second;
+        bm::doNotOptimize(sum);
+    }
+
+    static void findMany(int group) {
+        long long sum = 0;
+        std::vector<const aisdi::TreeMap<int, int>::value_type*> found(keys().size());
+        map().findMany(keys().begin(), keys().end(), found.begin(), group);
+        for (auto f : found) sum += f->second;
+        bm::doNotOptimize(sum);
+    }
+};
+
+// Bulk construction from N random pairs: one key at a time, or buildParallel
+// with the given number of threads (0 = one key at a time).
+template<class Collection, int N>
+void bulkBuild(int threadsNumber) {
+    static const std::vector<std::pair<int, int>> items = []() {
+        std::vector<std::pair<int, int>> v;
+        std::mt19937 device;
+        for (int i = 0; i < N; ++i) v.emplace_back(static_cast<int>(device()), i);
+        return v;
+    }();
+    if (!threadsNumber) {
+        Collection map;
+        for (auto& item : items) map[item.first] = item.second;
+        return;
+    }
+    auto map = Collection::buildParallel(items.begin(), items.end(), threadsNumber);
+}
+
+// Sum of the values of N random pairs with reduceParallel on the given number
+// of threads.
+template<class Collection, int N>
+void parallelSum(int threadsNumber) {
+    static const Collection map = []() {
+        Collection m;
+        std::mt19937 device;
+        for (int i = 0; i < N; ++i) m[static_cast<int>(device())] = i;
+        return m;
+    }();
+    long long sum = map.reduceParallel(0ll, [](const typename Collection::value_type& item) { return item.second; },
+                                       [](long long a, long long b) { return a + b; }, threadsNumber);
+    bm::doNotOptimize(sum);
+}
+
+// Restoring N random pairs: 0 = inserting them one by one, 1 = loading a
+// snapshot of the map from memory.
+template<class Collection, int N>
+void restore(int fromSnapshot) {
+    static const std::vector<std::pair<int, int>> items = []() {
+        std::vector<std::pair<int, int>> v;
+        std::mt19937 device;
+        for (int i = 0; i < N; ++i) v.emplace_back(static_cast<int>(device()), i);
+        return v;
+    }();
+    static const std::string snapshot = []() {
+        Collection m;
+        for (auto& item : items) m[item.first] = item.second;
+        std::ostringstream out;
+        m.save(out);
+        return out.str();
+    }();
+    Collection map;
+    if (fromSnapshot) {
+        std::istringstream in(snapshot);
+        map.load(in);
+    } else {
+        for (auto& item : items) map[item.first] = item.second;
+    }
+}
+
+
+// Eviction bolted on from outside: a HashMap plus a std::list of keys - what
+// the caches did before LruCache.
+template<typename KeyType, typename ValueType>
+class ListLruCache {
+    using Order = std::list<KeyType>;
+    aisdi::HashMap<KeyType, std::pair<ValueType, typename Order::iterator>> map;
+    Order order;
+    const std::size_t capacity;
+public:
+    explicit ListLruCache(std::size_t maxItems) : capacity(maxItems) { }
+
+    ValueType* get(const KeyType& key) {
+        auto item = map.findItem(key);
+        if (!item) return nullptr;
+        order.splice(order.begin(), order, item->second.second);
+        return &item->second.first;
+    }
+
+    void put(const KeyType& key, const ValueType& value) {
+        auto item = map.findItem(key);
+        if (item) {
+            item->second.first = value;
+            order.splice(order.begin(), order, item->second.second);
+            return;
+        }
+        if (map.getSize() == capacity) {
+            map.remove(order.back());
+            order.pop_back();
+        }
+        order.push_front(key);
+        map[key] = std::make_pair(value, order.begin());
+    }
+};
+
+// Requests for 1000000 keys, Zipf-distributed (s = 0.99), optionally with
+// every fourth request a key of a one-off scan.
+class CacheTrace {
+    static constexpr int KEYS = 1000000;
+    static constexpr int REQUESTS = 2000000;
+
+    static std::vector<int> make(bool withScans) {
+        std::vector<double> weights(KEYS);
+        for (int i = 0; i < KEYS; ++i) weights[i] = 1.0 / std::pow(i + 1, 0.99);
+        std::discrete_distribution<int> zipf(weights.begin(), weights.end());
+        std::mt19937 device;
+        std::vector<int> trace;
+        for (int i = 0; i < REQUESTS; ++i)
+            trace.push_back(withScans && i % 4 == 3 ? KEYS + i : zipf(device));
+        return trace;
+    }
+public:
+    static const std::vector<int>& zipf() {
+        static const std::vector<int> instance = make(false);
+        return instance;
+    }
+
+    static const std::vector<int>& zipfWithScans() {
+        static const std::vector<int> instance = make(true);
+        return instance;
+    }
+
+    // Fraction of the trace's requests that hit a cache of given capacity,
+    // which loads a missing key on the spot.
+    template<class Cache>
+    static double replay(const std::vector<int>& trace, int capacity) {
+        Cache cache(capacity);
+        std::size_t hits = 0;
+        for (int key : trace) {
+            if (cache.get(key)) ++hits;
+            else cache.put(key, key);
+        }
+        return double(hits) / trace.size();
+    }
+
+    template<class Cache>
+    static void replayZipf(int capacity) {
+        replay<Cache>(zipf(), capacity);
+    }
+};
+
+template<class Cache>
+void exportHitRates(std::ostream& out, const std::string& name, std::initializer_list<int> capacities) {
+    out << "capacity," << name << " zipf," << name << " zipf with scans\n";
+    for (int capacity : capacities)
+        out << capacity << "," << CacheTrace::replay<Cache>(CacheTrace::zipf(), capacity)
+            << "," << CacheTrace::replay<Cache>(CacheTrace::zipfWithScans(), capacity) << "\n";
+}
+
+
+// Copying a map of N random items, n times.
+template<class Collection, int N>
+void copyMap(int n) {
+    static const Collection source = []() {
+        Collection m;
+        std::mt19937 device;
+        for (int i = 0; i < N; ++i) m[static_cast<int>(device())] = i;
+        return m;
+    }();
+    for (int i = 0; i < n; ++i) {
+        Collection copy(source);
+        bm::doNotOptimize(copy.getSize());
+    }
+}
+
+// Summing the values of a map of N random items, n times over.
+template<class Collection, int N>
+void iterateMap(int n) {
+    static const Collection source = []() {
+        Collection m;
+        std::mt19937 device;
+        for (int i = 0; i < N; ++i) m[static_cast<int>(device())] = i;
+        return m;
+    }();
+    long long sum = 0;
+    for (int i = 0; i < n; ++i)
+        for (const auto& item : source) sum += item.second;
+    bm::doNotOptimize(sum);
+}
+
+// Moving every other of N items of a map, in random order, into another
+// one, by copying and removing them (0) or by relinking their nodes (1).
+// The values are strings too long to copy without allocating.
+template<class Collection, int N>
+void moveItems(int byNode) {
+    std::mt19937 device;
+    std::vector<int> keys(N);
+    std::iota(keys.begin(), keys.end(), 0);
+    std::shuffle(keys.begin(), keys.end(), device);
+    Collection from, to;
+    for (int i = 0; i < N; ++i) from[keys[i]] = std::string(40, 'a' + i % 26);
+    for (int i = 0; i < N; i += 2) {
+        if (byNode) {
+            to.insert(from.extract(keys[i]));
+        } else {
+            to[keys[i]] = from.valueOf(keys[i]);
+            from.remove(keys[i]);
+        }
+    }
+    bm::doNotOptimize(to.getSize());
+}
+
+// Percentiles of the time of single lookups of present keys in a map of
+// items random items, in nanoseconds.
+template<class Collection>
+void exportLookupLatencies(std::ostream& out, const std::string& name, std::initializer_list<int> sizes) {
+    const int LOOKUPS = 1000000;
+    out << "items," << name << " p50," << name << " p99," << name << " p99.9\n";
+    for (int items : sizes) {
+        Collection map;
+        std::vector<int> keys;
+        std::mt19937 device;
+        for (int i = 0; i < items; ++i) {
+            keys.push_back(static_cast<int>(device()));
+            map[keys.back()] = i;
+        }
+        std::uniform_int_distribution<std::size_t> pick(0, keys.size() - 1);
+        std::vector<long long> latencies;
+        latencies.reserve(LOOKUPS);
+        long long sum = 0;
+        for (int i = 0; i < LOOKUPS; ++i) {
+            int key = keys[pick(device)];
+            auto start = std::chrono::steady_clock::now();
+            sum += map.valueOf(key);
+            auto stop = std::chrono::steady_clock::now();
+            latencies.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count());
+        }
+        bm::doNotOptimize(sum);
+        std::sort(latencies.begin(), latencies.end());
+        out << items << "," << latencies[LOOKUPS / 2] << "," << latencies[LOOKUPS * 99 / 100]
+            << "," << latencies[LOOKUPS * 999 / 1000] << "\n";
+    }
+}
+
+// Longest single insert of random keys while a map grows from items / 2 to
+// items, for items doubling up to maxItems, in microseconds.
+template<class Collection>
+std::vector<long long> maxInsertLatencies(int firstItems, int maxItems) {
+    Collection map;
+    std::mt19937 device;
+    std::vector<long long> result;
+    long long longest = 0;
+    for (int i = 0, next = firstItems; i < maxItems; ++i) {
+        int key = static_cast<int>(device());
+        auto start = std::chrono::steady_clock::now();
+        map[key] = i;
+        auto stop = std::chrono::steady_clock::now();
+        longest = std::max<long long>(longest, std::chrono::duration_cast<std::chrono::microseconds>(stop - start).count());
+        if (i + 1 == next) {
+            result.push_back(longest);
+            longest = 0;
+            next *= 2;
+        }
+    }
+    return result;
+}
+
+// Looking up, 10 times over, n keys inserted in ascending order into one
+// bucket of the table they grow a HashMap to.
+template<class Collection>
+void collidingLookups(int n) {
+    Collection map;
+    std::size_t buckets = Collection::BUCKETS_NUMBER;
+    while (std::size_t(n) > Collection::MAX_LOAD_FACTOR * buckets) buckets = 2 * buckets + 1;
+    const int stride = static_cast<int>(buckets);
+    for (int i = 0; i < n; ++i) map[i * stride] = i;
+    long long sum = 0;
+    for (int round = 0; round < 10; ++round)
+        for (int i = 0; i < n; ++i) sum += map.valueOf(i * stride);
+    bm::doNotOptimize(sum);
+}
+
+// Bytes a map reports before and after shrinkToFit(), once 9 in 10 of n
+// items have been removed.
+template<class Collection>
+void exportShrinkReports(std::ostream& out, std::initializer_list<int> sizes) {
+    out << "items,left,before (B),after (B)\n";
+    for (int n : sizes) {
+        Collection map;
+        for (int i = 0; i < n; ++i) map[i] = i;
+        for (int i = 0; i < n; ++i)
+            if (i % 10) map.remove(i);
+        auto report = map.shrinkToFit();
+        out << n << "," << map.getSize() << "," << report.before << "," << report.after << "\n";
+    }
+}
 
 int main(int argc, char** argv) {
     (void) argc;
@@ -28,8 +499,11 @@ int main(int argc, char** argv) {
 
     using Map = aisdi::HashMap<int, int>;
     using Tree = aisdi::TreeMap<int, int>;
+    using CompactTree = aisdi::CompactTreeMap<int, int>;
+    using CompactMap = aisdi::CompactHashMap<int, int>;
+    using CuckooMap = aisdi::CuckooHashMap<int, int>;
 
-    bm::BenchmarkSuite randomInsertSuite("Random Insert buckets: 15693");
+    bm::BenchmarkSuite randomInsertSuite("Random Insert");
 
     auto cases = {1000, 2000, 5000, 8000, 10000, 20000,
                   50000
@@ -39,8 +513,137 @@ int main(int argc, char** argv) {
                  };
 
     randomInsertSuite.addBenchmark(bm::Benchmark("HashMap", randomInsert<Map, 52342>, cases))
-                     .addBenchmark(bm::Benchmark("TreeMap", randomInsert<Tree, 52342>, cases));
+                     .addBenchmark(bm::Benchmark("TreeMap", randomInsert<Tree, 52342>, cases))
+                     .addBenchmark(bm::Benchmark("CompactTreeMap", randomInsert<CompactTree, 52342>, cases))
+                     .addBenchmark(bm::Benchmark("CompactHashMap", randomInsert<CompactMap, 52342>, cases))
+                     .addBenchmark(bm::Benchmark("CuckooHashMap", randomInsert<CuckooMap, 52342>, cases));
 
     randomInsertSuite.run().exportCSV(f);
+
+    bm::BenchmarkSuite collisionSuite("Lookups of n keys in one bucket, 10 times");
+    collisionSuite.addBenchmark(bm::Benchmark("HashMap", collidingLookups<Map>, {100, 1000, 5000}));
+    collisionSuite.run().exportCSV(f);
     f.close();
+
+    std::ofstream concurrentFile("concurrent.txt");
+    bm::BenchmarkSuite mixedSuite("Mixed 90/10 read/write, 200000 ops per thread");
+    auto threadCases = {1, 2, 4, 8};
+
+    mixedSuite.addBenchmark(bm::Benchmark("HashMap + mutex",
+                                          mixedReadWrite<SingleLockHashMap<int, int>, 100000, 200000>,
+                                          threadCases))
+              .addBenchmark(bm::Benchmark("ConcurrentHashMap rw-locks",
+                                          mixedReadWrite<aisdi::ConcurrentHashMap<int, int>, 100000, 200000>,
+                                          threadCases))
+              .addBenchmark(bm::Benchmark("ConcurrentHashMap spin-locks",
+                                          mixedReadWrite<aisdi::ConcurrentHashMap<int, int, aisdi::SpinLocking>,
+                                                         100000, 200000>,
+                                          threadCases));
+
+    mixedSuite.run().exportCSV(concurrentFile);
+
+    bm::BenchmarkSuite skipListSuite("SkipListMap, time per thread count");
+    skipListSuite.addBenchmark(bm::Benchmark("insert-heavy, 100000 inserts per thread",
+                                             skipListInsertHeavy<100000>, threadCases))
+                 .addBenchmark(bm::Benchmark("scan-heavy, 20 scans of 100000 per thread",
+                                             skipListScanHeavy<100000, 20>, threadCases));
+
+    skipListSuite.run().exportCSV(concurrentFile);
+    concurrentFile.close();
+
+    std::ofstream batchFile("batch.txt");
+    LookupBenchmark::keys(); // build the map outside of measurements
+    bm::BenchmarkSuite batchSuite("2000000 lookups in HashMap of 2000000, by batch size");
+    batchSuite.addBenchmark(bm::Benchmark("find loop", LookupBenchmark::findLoop, {1}))
+              .addBenchmark(bm::Benchmark("findBatch", LookupBenchmark::findBatch, {1, 8, 32, 128}));
+
+    batchSuite.run().exportCSV(batchFile);
+
+    TreeLookupBenchmark::keys();
+    bm::BenchmarkSuite treeBatchSuite("1000000 lookups in TreeMap of 1000000, by group size");
+    treeBatchSuite.addBenchmark(bm::Benchmark("find loop", TreeLookupBenchmark::findLoop, {1}))
+                  .addBenchmark(bm::Benchmark("findMany", TreeLookupBenchmark::findMany, {1, 4, 8, 16, 32, 64}));
+
+    treeBatchSuite.run().exportCSV(batchFile);
+    batchFile.close();
+
+    std::ofstream buildFile("build.txt");
+    bm::BenchmarkSuite buildSuite("Building from 1000000 pairs, by threads (0 = operator[] loop)");
+    auto buildCases = {0, 1, 2, 4, 8};
+    buildSuite.addBenchmark(bm::Benchmark("HashMap", bulkBuild<Map, 1000000>, buildCases))
+              .addBenchmark(bm::Benchmark("TreeMap", bulkBuild<Tree, 1000000>, buildCases));
+
+    buildSuite.run().exportCSV(buildFile);
+
+    bm::BenchmarkSuite sumSuite("reduceParallel sum over 1000000 items, by threads");
+    auto sumCases = {1, 2, 4, 8};
+    sumSuite.addBenchmark(bm::Benchmark("HashMap", parallelSum<Map, 1000000>, sumCases))
+            .addBenchmark(bm::Benchmark("TreeMap", parallelSum<Tree, 1000000>, sumCases));
+
+    sumSuite.run().exportCSV(buildFile);
+
+    bm::BenchmarkSuite restoreSuite("Restoring 1000000 pairs (0 = operator[] loop, 1 = snapshot load)");
+    restoreSuite.addBenchmark(bm::Benchmark("HashMap", restore<Map, 1000000>, {0, 1}))
+                .addBenchmark(bm::Benchmark("TreeMap", restore<Tree, 1000000>, {0, 1}));
+
+    restoreSuite.run().exportCSV(buildFile);
+
+    bm::BenchmarkSuite copySuite("Copying a map of 1000000 items, n times");
+    copySuite.addBenchmark(bm::Benchmark("HashMap", copyMap<Map, 1000000>, {1, 5}))
+             .addBenchmark(bm::Benchmark("TreeMap", copyMap<Tree, 1000000>, {1, 5}))
+             .addBenchmark(bm::Benchmark("CompactHashMap", copyMap<CompactMap, 1000000>, {1, 5}));
+
+    copySuite.run().exportCSV(buildFile);
+
+    bm::BenchmarkSuite iterateSuite("Iterating over a map of 1000000 items, n times");
+    iterateSuite.addBenchmark(bm::Benchmark("HashMap", iterateMap<Map, 1000000>, {1, 10}))
+                .addBenchmark(bm::Benchmark("TreeMap", iterateMap<Tree, 1000000>, {1, 10}))
+                .addBenchmark(bm::Benchmark("CompactHashMap", iterateMap<CompactMap, 1000000>, {1, 10}));
+
+    iterateSuite.run().exportCSV(buildFile);
+
+    bm::BenchmarkSuite moveSuite("Moving 500000 of 1000000 items to another map (0 = copy and remove, 1 = extract and insert)");
+    using StringMap = aisdi::HashMap<int, std::string>;
+    using StringTree = aisdi::TreeMap<int, std::string>;
+    moveSuite.addBenchmark(bm::Benchmark("HashMap", moveItems<StringMap, 1000000>, {0, 1}))
+             .addBenchmark(bm::Benchmark("TreeMap", moveItems<StringTree, 1000000>, {0, 1}));
+
+    moveSuite.run().exportCSV(buildFile);
+    buildFile.close();
+
+    std::ofstream cacheFile("cache.txt");
+    using Lru = aisdi::LruCache<int, int>;
+    using Clock = aisdi::LruCache<int, int, aisdi::ClockEviction>;
+    using Slru = aisdi::LruCache<int, int, aisdi::SegmentedLruEviction>;
+    CacheTrace::zipfWithScans();
+    bm::BenchmarkSuite cacheSuite("2000000 Zipf requests to a cache, by capacity");
+    auto capacities = {1000, 10000, 100000};
+    cacheSuite.addBenchmark(bm::Benchmark("HashMap + std::list", CacheTrace::replayZipf<ListLruCache<int, int>>, capacities))
+              .addBenchmark(bm::Benchmark("LruCache LRU", CacheTrace::replayZipf<Lru>, capacities))
+              .addBenchmark(bm::Benchmark("LruCache CLOCK", CacheTrace::replayZipf<Clock>, capacities))
+              .addBenchmark(bm::Benchmark("LruCache SLRU", CacheTrace::replayZipf<Slru>, capacities));
+
+    cacheSuite.run().exportCSV(cacheFile);
+
+    exportHitRates<Lru>(cacheFile, "LRU", capacities);
+    exportHitRates<Clock>(cacheFile, "CLOCK", capacities);
+    exportHitRates<Slru>(cacheFile, "SLRU", capacities);
+    cacheFile.close();
+
+    std::ofstream latencyFile("latency.txt");
+    auto latencySizes = {10000, 100000, 1000000};
+    exportLookupLatencies<Map>(latencyFile, "HashMap", latencySizes);
+    exportLookupLatencies<CuckooMap>(latencyFile, "CuckooHashMap", latencySizes);
+
+    const int FIRST_ITEMS = 1 << 16, MAX_ITEMS = 1 << 23;
+    auto hashLatencies = maxInsertLatencies<Map>(FIRST_ITEMS, MAX_ITEMS);
+    auto unorderedLatencies = maxInsertLatencies<std::unordered_map<int, int>>(FIRST_ITEMS, MAX_ITEMS);
+    latencyFile << "items,HashMap longest insert (us),std::unordered_map longest insert (us)\n";
+    for (std::size_t i = 0; i < hashLatencies.size(); ++i)
+        latencyFile << (FIRST_ITEMS << i) << "," << hashLatencies[i] << "," << unorderedLatencies[i] << "\n";
+    latencyFile.close();
+
+    std::ofstream memoryFile("memory.txt");
+    exportShrinkReports<Map>(memoryFile, {100000, 1000000, 4000000});
+    memoryFile.close();
 }
@@ -0,0 +1,207 @@
+#include <CompactHashMap.h>
+
+#include <cstdint>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+#include <boost/mpl/list.hpp>
+
+using TestedKeyTypes = boost::mpl::list<std::int32_t, std::uint64_t>;
+
+template <typename K>
+using Map = aisdi::CompactHashMap<K, std::string>;
+
+using std::begin;
+using std::end;
+
+BOOST_AUTO_TEST_SUITE(CompactHashMapTests)
+
+template <typename K>
+void thenMapContainsItemsInOrder(const Map<K>& map,
+                                 const std::vector<std::pair<K, std::string>>& expected)
+{
+  BOOST_CHECK_EQUAL(map.getSize(), expected.size());
+
+  auto expectedIt = expected.begin();
+  for (const auto& item : map)
+  {
+    BOOST_REQUIRE(expectedIt != expected.end());
+    BOOST_CHECK_EQUAL(item.first, expectedIt->first);
+    BOOST_CHECK_EQUAL(item.second, expectedIt->second);
+    ++expectedIt;
+  }
+  BOOST_CHECK(expectedIt == expected.end());
+  for (const auto& item : expected)
+    BOOST_CHECK_EQUAL(map.valueOf(item.first), item.second);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenEmptyMap_WhenIterating_ThenBeginEqualsEnd,
+                              K,
+                              TestedKeyTypes)
+{
+  const Map<K> map;
+
+  BOOST_CHECK(map.isEmpty());
+  BOOST_CHECK(begin(map) == end(map));
+  BOOST_CHECK_THROW(*begin(map), std::out_of_range);
+  BOOST_CHECK_THROW(--end(map), std::out_of_range);
+  BOOST_CHECK_THROW(map.valueOf(1), std::out_of_range);
+  BOOST_CHECK(map.find(1) == end(map));
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenMap_WhenAddingItems_ThenTheyAreIteratedInInsertionOrder,
+                              K,
+                              TestedKeyTypes)
+{
+  Map<K> map = { { 1789, "Paris" }, { 753, "Rome" } };
+  map[1410] = "Grunwald";
+  map[753] = "Roma";
+
+  thenMapContainsItemsInOrder<K>(map, { { 1789, "Paris" }, { 753, "Roma" }, { 1410, "Grunwald" } });
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenMap_WhenIteratingBackwards_ThenItemsComeInReverseOrder,
+                              K,
+                              TestedKeyTypes)
+{
+  Map<K> map = { { 3, "c" }, { 1, "a" }, { 2, "b" } };
+  map.remove(1);
+
+  auto it = end(map);
+  BOOST_CHECK_EQUAL((--it)->first, 2);
+  BOOST_CHECK_EQUAL((--it)->first, 3);
+  BOOST_CHECK(it == begin(map));
+  BOOST_CHECK_THROW(--it, std::out_of_range);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenMap_WhenRemovingItems_ThenOthersKeepTheirOrder,
+                              K,
+                              TestedKeyTypes)
+{
+  Map<K> map = { { 1, "a" }, { 2, "b" }, { 3, "c" }, { 4, "d" } };
+
+  map.remove(1);
+  map.remove(map.find(3));
+  map[1] = "e";
+
+  thenMapContainsItemsInOrder<K>(map, { { 2, "b" }, { 4, "d" }, { 1, "e" } });
+  BOOST_CHECK_THROW(map.remove(3), std::out_of_range);
+  BOOST_CHECK_THROW(map.remove(end(map)), std::out_of_range);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenManyInsertsAndRemovals_WhenTableIsRebuilt_ThenMapMatchesReference,
+                              K,
+                              TestedKeyTypes)
+{
+  Map<K> map;
+  std::unordered_map<K, std::string> reference;
+  std::vector<std::pair<K, std::string>> order;
+  std::mt19937 device;
+  std::uniform_int_distribution<int> keys(0, 4000);
+
+  // goes through the 8, 16 and 32-bit tables, with tombstones on the way
+  for (int i = 0; i < 100000; ++i)
+  {
+    K key = keys(device);
+    if (reference.count(key) && device() % 3 == 0)
+    {
+      map.remove(key);
+      reference.erase(key);
+    }
+    else
+    {
+      map[key] = std::to_string(i);
+      reference[key] = std::to_string(i);
+    }
+  }
+
+  BOOST_CHECK_EQUAL(map.getSize(), reference.size());
+  std::size_t iterated = 0;
+  for (const auto& item : map)
+  {
+    BOOST_CHECK_EQUAL(item.second, reference.at(item.first));
+    ++iterated;
+  }
+  BOOST_CHECK_EQUAL(iterated, reference.size());
+  for (const auto& item : reference)
+    BOOST_CHECK_EQUAL(map.valueOf(item.first), item.second);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenItemsRemovedInBetween_WhenMapIsCompacted_ThenInsertionOrderIsKept,
+                              K,
+                              TestedKeyTypes)
+{
+  Map<K> map;
+  std::vector<std::pair<K, std::string>> expected;
+  for (int i = 0; i < 1000; ++i)
+    map[i] = std::to_string(i);
+  for (int i = 0; i < 1000; ++i)
+    if (i % 10)
+      map.remove(i);
+    else
+      expected.emplace_back(i, std::to_string(i));
+  // rebuilds the table, dropping the tombstones
+  for (int i = 1000; i < 3000; ++i)
+  {
+    map[i] = std::to_string(i);
+    expected.emplace_back(i, std::to_string(i));
+  }
+
+  thenMapContainsItemsInOrder<K>(map, expected);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenMaps_WhenComparing_ThenInsertionOrderDoesNotMatter,
+                              K,
+                              TestedKeyTypes)
+{
+  Map<K> map = { { 1, "a" }, { 2, "b" } };
+  Map<K> other = { { 2, "b" }, { 1, "a" } };
+
+  BOOST_CHECK(map == other);
+  other[1] = "c";
+  BOOST_CHECK(map != other);
+  other.remove(1);
+  BOOST_CHECK(map != other);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenMap_WhenCopyingAndMoving_ThenItemsFollow,
+                              K,
+                              TestedKeyTypes)
+{
+  Map<K> map = { { 1, "a" }, { 2, "b" } };
+
+  Map<K> copy(map);
+  copy[3] = "c";
+  Map<K> moved(std::move(copy));
+  map = moved;
+
+  thenMapContainsItemsInOrder<K>(map, { { 1, "a" }, { 2, "b" }, { 3, "c" } });
+  BOOST_CHECK(copy.isEmpty());
+  BOOST_CHECK(begin(copy) == end(copy));
+  copy[4] = "d";
+  thenMapContainsItemsInOrder<K>(copy, { { 4, "d" } });
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenMap_WhenClearing_ThenItCanBeFilledAgain,
+                              K,
+                              TestedKeyTypes)
+{
+  Map<K> map;
+  map.reserve(100);
+  for (int i = 0; i < 100; ++i)
+    map[i] = std::to_string(i);
+
+  map.clear();
+
+  BOOST_CHECK(map.isEmpty());
+  BOOST_CHECK(map.find(1) == end(map));
+  map[5] = "e";
+  thenMapContainsItemsInOrder<K>(map, { { 5, "e" } });
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,179 @@
+#include <CompactTreeMap.h>
+
+#include <cstdint>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+#include <boost/mpl/list.hpp>
+
+using TestedKeyTypes = boost::mpl::list<std::int32_t, std::uint64_t>;
+
+template <typename K>
+using Map = aisdi::CompactTreeMap<K, std::string>;
+
+using std::begin;
+using std::end;
+
+BOOST_AUTO_TEST_SUITE(CompactTreeMapTests)
+
+template <typename K>
+void thenMapContainsItems(const Map<K>& map,
+                          const std::map<K, std::string>& expected)
+{
+  BOOST_CHECK_EQUAL(map.getSize(), expected.size());
+
+  auto expectedIt = expected.begin();
+  for (const auto& item : map)
+  {
+    BOOST_REQUIRE(expectedIt != expected.end());
+    BOOST_CHECK_EQUAL(item.first, expectedIt->first);
+    BOOST_CHECK_EQUAL(item.second, expectedIt->second);
+    ++expectedIt;
+  }
+  for (const auto& item : expected)
+    BOOST_CHECK_EQUAL(map.valueOf(item.first), item.second);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenEmptyMap_WhenIterating_ThenBeginEqualsEnd,
+                              K,
+                              TestedKeyTypes)
+{
+  const Map<K> map;
+
+  BOOST_CHECK(map.isEmpty());
+  BOOST_CHECK(begin(map) == end(map));
+  BOOST_CHECK_THROW(*begin(map), std::out_of_range);
+  BOOST_CHECK_THROW(--end(map), std::out_of_range);
+  BOOST_CHECK_THROW(map.valueOf(1), std::out_of_range);
+  BOOST_CHECK(map.find(1) == end(map));
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenMap_WhenAddingItems_ThenTheyAreIteratedInKeyOrder,
+                              K,
+                              TestedKeyTypes)
+{
+  Map<K> map = { { 1789, "Paris" }, { 753, "Rome" } };
+  map[1410] = "Grunwald";
+  map[753] = "Roma";
+
+  thenMapContainsItems(map, { { 753, "Roma" }, { 1410, "Grunwald" }, { 1789, "Paris" } });
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenMap_WhenIteratingBackwards_ThenItemsComeInReverseKeyOrder,
+                              K,
+                              TestedKeyTypes)
+{
+  Map<K> map = { { 5, "e" }, { 2, "b" }, { 8, "h" }, { 1, "a" }, { 3, "c" }, { 9, "i" }, { 7, "g" } };
+
+  std::vector<K> keys;
+  for (auto it = end(map); it != begin(map);)
+    keys.push_back((--it)->first);
+
+  BOOST_CHECK((keys == std::vector<K>{ 9, 8, 7, 5, 3, 2, 1 }));
+  BOOST_CHECK_THROW(--begin(map), std::out_of_range);
+  BOOST_CHECK_THROW(++end(map), std::out_of_range);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenFoundItem_WhenMovingIteratorBothWays_ThenNeighboursAreReached,
+                              K,
+                              TestedKeyTypes)
+{
+  Map<K> map = { { 5, "e" }, { 2, "b" }, { 8, "h" }, { 3, "c" }, { 7, "g" } };
+
+  auto it = map.find(3);
+  BOOST_CHECK_EQUAL((++it)->first, 5u);
+  BOOST_CHECK_EQUAL((++it)->first, 7u);
+  BOOST_CHECK_EQUAL((--it)->first, 5u);
+  BOOST_CHECK_EQUAL((--it)->first, 3u);
+  BOOST_CHECK_EQUAL((--it)->first, 2u);
+  it->second = "B";
+
+  BOOST_CHECK_EQUAL(map.valueOf(2), "B");
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenMap_WhenRemovingItems_ThenFreedNodesAreReused,
+                              K,
+                              TestedKeyTypes)
+{
+  Map<K> map = { { 5, "e" }, { 2, "b" }, { 8, "h" }, { 3, "c" }, { 7, "g" }, { 9, "i" } };
+  const std::string *freedLast = &map.valueOf(9);
+
+  map.remove(5); // two children
+  map.remove(map.find(2)); // one child
+  map.remove(9); // leaf
+  BOOST_CHECK_THROW(map.remove(5), std::out_of_range);
+  BOOST_CHECK_THROW(map.remove(end(map)), std::out_of_range);
+  map[1] = "a";
+
+  thenMapContainsItems(map, { { 1, "a" }, { 3, "c" }, { 7, "g" }, { 8, "h" } });
+  BOOST_CHECK_EQUAL(&map.valueOf(1), freedLast); // freed last, reused first
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenManyRandomOperations_WhenComparedWithStdMap_ThenContentsMatch,
+                              K,
+                              TestedKeyTypes)
+{
+  Map<K> map;
+  std::map<K, std::string> expected;
+  std::mt19937 device;
+  std::uniform_int_distribution<int> keys(0, 2000);
+  for (int i = 0; i < 20000; ++i)
+  {
+    K key = keys(device);
+    if (i % 3 == 2 && expected.count(key))
+    {
+      map.remove(key);
+      expected.erase(key);
+    }
+    else
+    {
+      map[key] = std::to_string(i);
+      expected[key] = std::to_string(i);
+    }
+  }
+
+  thenMapContainsItems(map, expected);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenNonEmptyMap_WhenCopyingAndMoving_ThenMapsAreIndependent,
+                              K,
+                              TestedKeyTypes)
+{
+  Map<K> map = { { 753, "Rome" }, { 1789, "Paris" }, { 1410, "Grunwald" } };
+  map.remove(1410);
+  Map<K> copy{map};
+  Map<K> assigned = { { 1, "overwritten" } };
+  assigned = map;
+  map[1] = "changed";
+
+  BOOST_CHECK(copy == assigned);
+  BOOST_CHECK(copy != map);
+  thenMapContainsItems(copy, { { 753, "Rome" }, { 1789, "Paris" } });
+
+  Map<K> moved{std::move(map)};
+  BOOST_CHECK(map.isEmpty());
+  BOOST_CHECK_EQUAL(moved.getSize(), 3u);
+  map = std::move(copy);
+  thenMapContainsItems(map, { { 753, "Rome" }, { 1789, "Paris" } });
+  map.clear();
+  BOOST_CHECK(map.isEmpty());
+  map[2] = "again";
+  thenMapContainsItems(map, { { 2, "again" } });
+}
+
+BOOST_AUTO_TEST_CASE(GivenSmallKeysAndValues_WhenStored_ThenNodeTakesSixteenBytes)
+{
+  BOOST_CHECK_EQUAL((aisdi::CompactTreeMap<std::int32_t, std::int32_t>::NODE_BYTES), 16u);
+
+  aisdi::CompactTreeMap<std::int32_t, std::int32_t> map;
+  for (int i = 0; i < 100000; ++i)
+    map[(i * 7919) % 100003] = i;
+  BOOST_CHECK_EQUAL(map.getSize(), 100000u);
+  BOOST_CHECK_EQUAL(map.valueOf(7919), 1);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,133 @@
+#include <ConcurrentHashMap.h>
+
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+#include <boost/mpl/list.hpp>
+
+using TestedLockPolicies = boost::mpl::list<aisdi::ReaderWriterLocking, aisdi::SpinLocking>;
+
+template <typename L>
+using Map = aisdi::ConcurrentHashMap<std::int32_t, std::string, L>;
+
+BOOST_AUTO_TEST_SUITE(ConcurrentHashMapTests)
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenEmptyMap_WhenInsertingItem_ThenItCanBeFound,
+                              L,
+                              TestedLockPolicies)
+{
+  Map<L> map;
+
+  BOOST_CHECK(map.insert(42, "Alice"));
+
+  std::string value;
+  BOOST_CHECK(map.find(42, value));
+  BOOST_CHECK_EQUAL(value, "Alice");
+  BOOST_CHECK_EQUAL(map.getSize(), 1u);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenNonEmptyMap_WhenInsertingExistingKey_ThenValueIsKept,
+                              L,
+                              TestedLockPolicies)
+{
+  Map<L> map;
+  map.insert(42, "Alice");
+
+  BOOST_CHECK(!map.insert(42, "Bob"));
+  BOOST_CHECK_EQUAL(map.valueOf(42), "Alice");
+
+  map.assign(42, "Bob");
+  BOOST_CHECK_EQUAL(map.valueOf(42), "Bob");
+  BOOST_CHECK_EQUAL(map.getSize(), 1u);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenNonEmptyMap_WhenSearchingForMissingKey_ThenNothingIsFound,
+                              L,
+                              TestedLockPolicies)
+{
+  Map<L> map;
+  map.insert(321, "Not it");
+
+  std::string value = "untouched";
+  BOOST_CHECK(!map.find(123, value));
+  BOOST_CHECK_EQUAL(value, "untouched");
+  BOOST_CHECK(!map.visit(123, [](const std::string&) { BOOST_FAIL("visited missing key"); }));
+  BOOST_CHECK_THROW(map.valueOf(123), std::out_of_range);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenNonEmptyMap_WhenRemovingKey_ThenItIsGone,
+                              L,
+                              TestedLockPolicies)
+{
+  Map<L> map;
+  map.insert(42, "Alice");
+  map.insert(27, "Bob");
+
+  BOOST_CHECK(map.remove(27));
+  BOOST_CHECK(!map.remove(27));
+  BOOST_CHECK(!map.contains(27));
+  BOOST_CHECK_EQUAL(map.getSize(), 1u);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenMap_WhenComputingIfAbsent_ThenFactoryRunsOnlyForMissingKey,
+                              L,
+                              TestedLockPolicies)
+{
+  Map<L> map;
+  map.insert(42, "Alice");
+  int calls = 0;
+  auto factory = [&calls]() { ++calls; return std::string("Chuck"); };
+
+  BOOST_CHECK_EQUAL(map.computeIfAbsent(42, factory), "Alice");
+  BOOST_CHECK_EQUAL(map.computeIfAbsent(13, factory), "Chuck");
+  BOOST_CHECK_EQUAL(map.computeIfAbsent(13, factory), "Chuck");
+  BOOST_CHECK_EQUAL(calls, 1);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenBucketsNotDividingIntoStripes_WhenClearing_ThenEveryBucketIsEmptied,
+                              L,
+                              TestedLockPolicies)
+{
+  Map<L> map(7, 100);
+  for (int i = 0; i < 1000; ++i)
+    map.assign(i, std::to_string(i));
+  BOOST_CHECK_EQUAL(map.getSize(), 1000u);
+
+  map.clear();
+
+  BOOST_CHECK(map.isEmpty());
+  for (int i = 0; i < 1000; ++i)
+    BOOST_REQUIRE(!map.contains(i));
+  BOOST_CHECK(map.insert(99, "again"));
+  BOOST_CHECK_EQUAL(map.getSize(), 1u);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenManyThreads_WhenInsertingAndRemovingConcurrently_ThenSizeIsConsistent,
+                              L,
+                              TestedLockPolicies)
+{
+  Map<L> map(8);
+  const int threadsNumber = 4;
+  const int perThread = 2000;
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < threadsNumber; ++t)
+    threads.emplace_back([&map, t]() {
+      for (int i = 0; i < perThread; ++i)
+        map.insert(t * perThread + i, std::to_string(i));
+      for (int i = 0; i < perThread; i += 2)
+        map.remove(t * perThread + i);
+    });
+  for (auto& thread : threads)
+    thread.join();
+
+  BOOST_CHECK_EQUAL(map.getSize(), static_cast<std::size_t>(threadsNumber * perThread / 2));
+  BOOST_CHECK_EQUAL(map.valueOf(perThread + 1), "1");
+  BOOST_CHECK(!map.contains(perThread));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,181 @@
+#include <CuckooHashMap.h>
+
+#include <cstdint>
+#include <map>
+#include <random>
+#include <string>
+#include <utility>
+
+#include <boost/test/unit_test.hpp>
+
+#include <boost/mpl/list.hpp>
+
+using TestedKeyTypes = boost::mpl::list<std::int32_t, std::uint64_t>;
+
+template <typename K>
+using Map = aisdi::CuckooHashMap<K, std::string>;
+
+using std::begin;
+using std::end;
+
+BOOST_AUTO_TEST_SUITE(CuckooHashMapTests)
+
+template <typename K>
+void thenMapContainsItems(const Map<K>& map,
+                          const std::map<K, std::string>& expected)
+{
+  BOOST_CHECK_EQUAL(map.getSize(), expected.size());
+
+  std::map<K, std::string> iterated;
+  for (const auto& item : map)
+    BOOST_CHECK(iterated.emplace(item.first, item.second).second);
+  BOOST_CHECK(iterated == expected);
+  for (const auto& item : expected)
+    BOOST_CHECK_EQUAL(map.valueOf(item.first), item.second);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenEmptyMap_WhenIterating_ThenBeginEqualsEnd,
+                              K,
+                              TestedKeyTypes)
+{
+  const Map<K> map;
+
+  BOOST_CHECK(map.isEmpty());
+  BOOST_CHECK(begin(map) == end(map));
+  BOOST_CHECK_THROW(*begin(map), std::out_of_range);
+  BOOST_CHECK_THROW(--end(map), std::out_of_range);
+  BOOST_CHECK_THROW(map.valueOf(1), std::out_of_range);
+  BOOST_CHECK(map.find(1) == end(map));
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenMap_WhenAddingAndRemovingItems_ThenMapContainsTheRest,
+                              K,
+                              TestedKeyTypes)
+{
+  Map<K> map = { { 1789, "Paris" }, { 753, "Rome" }, { 1410, "Grunwald" } };
+  map[753] = "Roma";
+
+  map.remove(1789);
+  map.remove(map.find(1410));
+
+  thenMapContainsItems<K>(map, { { 753, "Roma" } });
+  BOOST_CHECK_THROW(map.remove(1789), std::out_of_range);
+  BOOST_CHECK_THROW(map.remove(end(map)), std::out_of_range);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenMap_WhenIteratingBothWays_ThenEveryItemIsVisitedOnce,
+                              K,
+                              TestedKeyTypes)
+{
+  Map<K> map;
+  for (int i = 0; i < 100; ++i)
+    map[i] = std::to_string(i);
+
+  std::size_t forward = 0;
+  for (auto it = begin(map); it != end(map); ++it)
+    ++forward;
+  std::size_t backward = 0;
+  for (auto it = end(map); it != begin(map); --it)
+    ++backward;
+
+  BOOST_CHECK_EQUAL(forward, 100u);
+  BOOST_CHECK_EQUAL(backward, 100u);
+  BOOST_CHECK_THROW(++end(map), std::out_of_range);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenManyItems_WhenBucketsFillUp_ThenItemsAreDisplacedAndTableGrows,
+                              K,
+                              TestedKeyTypes)
+{
+  Map<K> map;
+  std::map<K, std::string> expected;
+  std::mt19937 device;
+
+  for (int i = 0; i < 50000; ++i)
+  {
+    K key = static_cast<K>(device());
+    map[key] = std::to_string(i);
+    expected[key] = std::to_string(i);
+  }
+
+  thenMapContainsItems<K>(map, expected);
+  // displacement fills the table well past what two choices of one slot would
+  BOOST_CHECK_GT(map.getLoadFactor(), 0.35);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenManyInsertsAndRemovals_WhenComparedToReference_ThenMapMatches,
+                              K,
+                              TestedKeyTypes)
+{
+  Map<K> map;
+  std::map<K, std::string> reference;
+  std::mt19937 device;
+  std::uniform_int_distribution<int> keys(0, 3000);
+
+  for (int i = 0; i < 60000; ++i)
+  {
+    K key = keys(device);
+    if (reference.count(key) && device() % 2)
+    {
+      map.remove(key);
+      reference.erase(key);
+    }
+    else
+    {
+      map[key] = std::to_string(i);
+      reference[key] = std::to_string(i);
+    }
+  }
+
+  thenMapContainsItems<K>(map, reference);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenMaps_WhenComparing_ThenOnlyItemsMatter,
+                              K,
+                              TestedKeyTypes)
+{
+  Map<K> map = { { 1, "a" }, { 2, "b" } };
+  Map<K> other = { { 2, "b" }, { 1, "a" } };
+
+  BOOST_CHECK(map == other);
+  other[1] = "c";
+  BOOST_CHECK(map != other);
+  other.remove(1);
+  BOOST_CHECK(map != other);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenMap_WhenCopyingAndMoving_ThenItemsFollow,
+                              K,
+                              TestedKeyTypes)
+{
+  Map<K> map = { { 1, "a" }, { 2, "b" } };
+
+  Map<K> copy(map);
+  copy[3] = "c";
+  Map<K> moved(std::move(copy));
+  map = moved;
+
+  thenMapContainsItems<K>(map, { { 1, "a" }, { 2, "b" }, { 3, "c" } });
+  BOOST_CHECK(copy.isEmpty());
+  BOOST_CHECK(begin(copy) == end(copy));
+  copy[4] = "d";
+  thenMapContainsItems<K>(copy, { { 4, "d" } });
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenMap_WhenClearing_ThenItCanBeFilledAgain,
+                              K,
+                              TestedKeyTypes)
+{
+  Map<K> map;
+  for (int i = 0; i < 100; ++i)
+    map[i] = std::to_string(i);
+
+  map.clear();
+
+  BOOST_CHECK(map.isEmpty());
+  BOOST_CHECK(begin(map) == end(map));
+  map[5] = "e";
+  thenMapContainsItems<K>(map, { { 5, "e" } });
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,162 @@
+#include <ExpiringMap.h>
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include <boost/test/unit_test.hpp>
+
+namespace
+{
+
+// Clock that moves only when told to; copies share the time.
+struct ManualClock
+{
+  using duration = std::chrono::milliseconds;
+  using rep = duration::rep;
+  using period = duration::period;
+  using time_point = std::chrono::time_point<ManualClock, duration>;
+  static constexpr bool is_steady = true;
+
+  std::shared_ptr<time_point> current = std::make_shared<time_point>();
+
+  time_point now() const
+  {
+    return *current;
+  }
+
+  void advance(duration by)
+  {
+    *current += by;
+  }
+};
+
+using Map = aisdi::ExpiringMap<std::int32_t, std::string, ManualClock>;
+using std::chrono::milliseconds;
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(ExpiringMapTests)
+
+BOOST_AUTO_TEST_CASE(GivenItemWithTtl_WhenDeadlinePasses_ThenItIsHiddenBeforeExpiring)
+{
+  ManualClock clock;
+  Map map(milliseconds(10), clock);
+  map.put(42, "Alice", milliseconds(25));
+
+  clock.advance(milliseconds(24));
+  BOOST_CHECK_EQUAL(map.valueOf(42), "Alice");
+  clock.advance(milliseconds(1));
+
+  BOOST_CHECK(map.find(42) == nullptr);
+  BOOST_CHECK(!map.contains(42));
+  BOOST_CHECK_THROW(map.valueOf(42), std::out_of_range);
+  BOOST_CHECK_EQUAL(map.getSize(), 1u);
+  // its tick (30 ms) isn't over yet
+  BOOST_CHECK_EQUAL(map.expire(), 0u);
+  clock.advance(milliseconds(5));
+  BOOST_CHECK_EQUAL(map.expire(), 1u);
+  BOOST_CHECK(map.isEmpty());
+}
+
+BOOST_AUTO_TEST_CASE(GivenItemsWithManyTtls_WhenTimePasses_ThenEachExpiresAtItsDeadline)
+{
+  ManualClock clock;
+  Map map(milliseconds(1), clock);
+  // across all levels of the wheel and beyond it
+  const std::int32_t ttls[] = { 1, 2, 63, 64, 65, 100, 4095, 4096, 4097, 300000,
+                                (1 << 24) - 1, 1 << 24, (1 << 24) + 7, 50000000 };
+  for (auto ttl : ttls)
+    map.put(ttl, std::to_string(ttl), milliseconds(ttl));
+
+  std::size_t left = map.getSize();
+  for (auto ttl : ttls)
+  {
+    clock.advance(milliseconds(ttl) - (clock.now() - ManualClock::time_point()) - milliseconds(1));
+    BOOST_CHECK_EQUAL(map.expire(), 0u);
+    BOOST_CHECK(map.contains(ttl));
+    clock.advance(milliseconds(1));
+    BOOST_CHECK(!map.contains(ttl));
+    BOOST_CHECK_EQUAL(map.expire(), 1u);
+    BOOST_CHECK_EQUAL(map.getSize(), --left);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(GivenItem_WhenPutAgainOrRenewed_ThenNewDeadlineApplies)
+{
+  ManualClock clock;
+  Map map(milliseconds(1), clock);
+  map.put(1, "Alice", milliseconds(10));
+  map.put(2, "Bob", milliseconds(10));
+  map.put(1, "Carol", milliseconds(100));
+  BOOST_CHECK(map.renew(2, milliseconds(50)));
+  BOOST_CHECK(!map.renew(3, milliseconds(50)));
+
+  clock.advance(milliseconds(20));
+  BOOST_CHECK_EQUAL(map.expire(), 0u);
+  BOOST_CHECK_EQUAL(map.valueOf(1), "Carol");
+  clock.advance(milliseconds(40));
+  BOOST_CHECK_EQUAL(map.expire(), 1u);
+  BOOST_CHECK(!map.contains(2));
+  BOOST_CHECK(!map.renew(2, milliseconds(50)));
+  BOOST_CHECK_EQUAL(map.getSize(), 1u);
+}
+
+BOOST_AUTO_TEST_CASE(GivenItems_WhenRemoving_ThenOnlyLiveItemsCount)
+{
+  ManualClock clock;
+  Map map(milliseconds(1), clock);
+  map.put(1, "Alice", milliseconds(10));
+  map.put(2, "Bob", milliseconds(30));
+
+  clock.advance(milliseconds(20));
+  BOOST_CHECK(!map.remove(1));
+  BOOST_CHECK(map.remove(2));
+  BOOST_CHECK(!map.remove(2));
+  BOOST_CHECK(map.isEmpty());
+  BOOST_CHECK_EQUAL(map.expire(), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(GivenManySessions_WhenPuttingOverTime_ThenPutsExpireOldOnes)
+{
+  ManualClock clock;
+  Map map(milliseconds(1), clock);
+  for (int i = 0; i < 10000; ++i)
+  {
+    map.put(i, "session", milliseconds(1000 + i % 7));
+    clock.advance(milliseconds(1));
+  }
+
+  BOOST_CHECK_LE(map.getSize(), 1007u);
+  BOOST_CHECK_GE(map.getSize(), 1000u);
+  BOOST_CHECK(map.contains(9999));
+  BOOST_CHECK(!map.contains(8000));
+}
+
+BOOST_AUTO_TEST_CASE(GivenDeadlineInThePast_WhenPutting_ThenItemIsHiddenAndExpiredNextTick)
+{
+  ManualClock clock;
+  clock.advance(milliseconds(500));
+  Map map(milliseconds(1), clock);
+  map.putUntil(1, "Alice", clock.now() - milliseconds(5));
+
+  BOOST_CHECK(!map.contains(1));
+  clock.advance(milliseconds(1));
+  BOOST_CHECK_EQUAL(map.expire(), 1u);
+}
+
+BOOST_AUTO_TEST_CASE(GivenNonPositiveTick_WhenCreatingMap_ThenExceptionIsThrown)
+{
+  BOOST_CHECK_THROW(Map(milliseconds(0)), std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_CASE(GivenSteadyClock_WhenItemIsPut_ThenItIsFound)
+{
+  aisdi::ExpiringMap<std::int32_t, std::string> map;
+  map.put(1, "Alice", std::chrono::hours(1));
+
+  BOOST_CHECK_EQUAL(map.valueOf(1), "Alice");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -2,7 +2,11 @@
 
 #include <cstdint>
 #include <string>
+#include <sstream>
 #include <map>
+#include <iterator>
+#include <vector>
+#include <type_traits>
 
 #include <boost/test/unit_test.hpp>
 
@@ -18,6 +22,16 @@ using std::end;
 
 BOOST_AUTO_TEST_SUITE(HashMapsTests)
 
+// buckets of the table that n items grow a map to
+template <typename K>
+std::size_t bucketsHolding(std::size_t n)
+{
+  std::size_t buckets = Map<K>::BUCKETS_NUMBER;
+  while (n > Map<K>::MAX_LOAD_FACTOR * buckets)
+    buckets = 2 * buckets + 1;
+  return buckets;
+}
+
 template <typename K>
 void thenMapContainsItems(const Map<K>& map,
                           const std::map<K, std::string>& expected)
@@ -591,6 +605,628 @@ BOOST_AUTO_TEST_CASE_TEMPLATE(GivenTwoMapsWithDifferentKeys_WhenComparingThem_Th
   BOOST_CHECK(map != other);
 }
 
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenMapWithItemsInEveryBucket_WhenIterating_ThenEndIsReached,
+                              K,
+                              TestedKeyTypes)
+{
+  Map<K> map;
+  for (int i = 0; i < 40000; ++i)
+    map[i] = std::string{};
+
+  std::size_t count = 0;
+  for (auto it = map.begin(); it != map.end(); ++it)
+    ++count;
+
+  BOOST_CHECK_EQUAL(count, map.getSize());
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenNonEmptyMap_WhenFindingBatch_ThenEveryKeyIsResolved,
+                              K,
+                              TestedKeyTypes)
+{
+  Map<K> map = { { 42, "Alice" }, { 27, "Bob" } };
+  const std::vector<K> keys = { 27, 1, 42 };
+  std::vector<typename Map<K>::value_type*> found;
+
+  map.findBatch(keys.begin(), keys.end(), std::back_inserter(found));
+
+  BOOST_REQUIRE_EQUAL(found.size(), 3u);
+  BOOST_CHECK_EQUAL(found[0]->second, "Bob");
+  BOOST_CHECK(found[1] == nullptr);
+  BOOST_CHECK_EQUAL(found[2]->first, 42);
+  found[2]->second = "Chuck";
+  BOOST_CHECK_EQUAL(map.valueOf(42), "Chuck");
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenNonEmptyMap_WhenInsertingBatch_ThenItemsAreAddedOrChanged,
+                              K,
+                              TestedKeyTypes)
+{
+  Map<K> map = { { 42, "Chuck" } };
+  std::vector<std::pair<K, std::string>> items;
+  for (int i = 0; i < 300; ++i)
+    items.emplace_back(i, std::to_string(i));
+
+  map.insertBatch(items.begin(), items.end());
+
+  BOOST_CHECK_EQUAL(map.getSize(), 300u);
+  BOOST_CHECK_EQUAL(map.valueOf(42), "42");
+  BOOST_CHECK_EQUAL(map.valueOf(299), "299");
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenItemsWithDuplicates_WhenBuildingInParallel_ThenLastValueOfEachKeyIsKept,
+                              K,
+                              TestedKeyTypes)
+{
+  std::vector<std::pair<K, std::string>> items;
+  std::map<K, std::string> expected;
+  for (int i = 0; i < 30000; ++i) {
+    K key = (i * 7919) % 11000;
+    items.emplace_back(key, std::to_string(i));
+    expected[key] = std::to_string(i);
+  }
+
+  const auto map = Map<K>::buildParallel(items.begin(), items.end(), 4);
+
+  thenMapContainsItems(map, expected);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenLargeMap_WhenReducingInParallel_ThenResultEqualsSequentialFold,
+                              K,
+                              TestedKeyTypes)
+{
+  Map<K> map;
+  for (int i = 0; i < 20000; ++i)
+    map[(i * 7919) % 20011] = std::to_string(i);
+  auto concat = [](std::string a, std::string b) { a += b; return a; };
+  auto keyOf = [](const typename Map<K>::value_type& item) { return std::to_string(item.first) + ","; };
+
+  std::string expected;
+  for (const auto& item : map)
+    expected += keyOf(item);
+
+  BOOST_CHECK(map.reduceParallel(std::string(), keyOf, concat, 4) == expected);
+  BOOST_CHECK_EQUAL(map.reduceParallel(std::size_t(0),
+                                       [](const typename Map<K>::value_type&) { return std::size_t(1); },
+                                       [](std::size_t a, std::size_t b) { return a + b; },
+                                       3),
+                    map.getSize());
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenLargeMap_WhenVisitingInParallel_ThenEveryItemIsVisitedOnce,
+                              K,
+                              TestedKeyTypes)
+{
+  Map<K> map;
+  for (int i = 0; i < 20000; ++i)
+    map[(i * 7919) % 20011] = "";
+
+  map.forEachParallel([](typename Map<K>::value_type& item) { item.second += "x"; }, 4);
+
+  for (const auto& item : map)
+    BOOST_CHECK_EQUAL(item.second, "x");
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenNonEmptyMap_WhenSavedAndLoaded_ThenItemsAreRestored,
+                              K,
+                              TestedKeyTypes)
+{
+  Map<K> map;
+  std::map<K, std::string> expected;
+  for (int i = 0; i < 10000; ++i) {
+    K key = (i * 7919) % 10007;
+    map[key] = std::string(i % 7, 'a' + i % 26);
+    expected[key] = map[key];
+  }
+  std::stringstream stream;
+  map.save(stream);
+
+  Map<K> loaded = { { 1, "overwritten" } };
+  loaded.load(stream);
+
+  thenMapContainsItems(loaded, expected);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenDamagedSnapshot_WhenLoading_ThenExceptionIsThrownAndMapIsKept,
+                              K,
+                              TestedKeyTypes)
+{
+  Map<K> map = { { 42, "Alice" }, { 27, "Bob" } };
+  std::stringstream stream;
+  map.save(stream);
+  std::string bytes = stream.str();
+  bytes[bytes.size() / 2] ^= 1;
+  std::stringstream damaged(bytes);
+
+  Map<K> loaded = { { 1, "kept" } };
+
+  BOOST_CHECK_THROW(loaded.load(damaged), aisdi::SnapshotError);
+  thenMapContainsItems(loaded, { { 1, "kept" } });
+}
+
+BOOST_AUTO_TEST_CASE(GivenSnapshotOfOtherTypeOfSameSize_WhenLoading_ThenExceptionIsThrown)
+{
+  const aisdi::HashMap<std::uint32_t, float> map = { { 42, 0.5f } };
+  std::stringstream asIntegers, asSigned;
+  map.save(asIntegers);
+  map.save(asSigned);
+
+  aisdi::HashMap<std::uint32_t, std::uint32_t> integers;
+  aisdi::HashMap<std::int32_t, float> signedKeys;
+
+  BOOST_CHECK_THROW(integers.load(asIntegers), aisdi::SnapshotError);
+  BOOST_CHECK_THROW(signedKeys.load(asSigned), aisdi::SnapshotError);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenMap_WhenFindingOrInsertingItems_ThenPointersToItemsAreReturned,
+                              K,
+                              TestedKeyTypes)
+{
+  Map<K> map = { { 42, "Alice" } };
+
+  auto found = map.findOrInsert(42);
+  auto inserted = map.findOrInsert(27);
+  inserted.first->second = "Bob";
+
+  BOOST_CHECK(!found.second);
+  BOOST_CHECK_EQUAL(found.first->second, "Alice");
+  BOOST_CHECK(inserted.second);
+  BOOST_CHECK_EQUAL(map.findItem(27), inserted.first);
+  BOOST_CHECK(map.findItem(1) == nullptr);
+  map.remove(42);
+  BOOST_CHECK_EQUAL(static_cast<const Map<K>&>(map).findItem(27)->second, "Bob");
+  thenMapContainsItems(map, { { 27, "Bob" } });
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenSmallMap_WhenGrowingPastInlineCapacity_ThenItemsStayInPlace,
+                              K,
+                              TestedKeyTypes)
+{
+  Map<K> map;
+  std::map<K, std::string> expected;
+  std::vector<const typename Map<K>::value_type*> items;
+  const K inlineItems = static_cast<K>(Map<K>::SMALL_CAPACITY);
+  for (K i = 0; i < inlineItems; ++i)
+  {
+    map[i] = std::to_string(i);
+    expected[i] = std::to_string(i);
+    items.push_back(map.findItem(i));
+  }
+  thenMapContainsItems(map, expected);
+
+  for (K i = inlineItems; i < 100; ++i)
+  {
+    map[i] = std::to_string(i);
+    expected[i] = std::to_string(i);
+  }
+
+  thenMapContainsItems(map, expected);
+  for (K i = 0; i < inlineItems; ++i)
+    BOOST_CHECK_EQUAL(map.findItem(i), items[i]);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenSmallMap_WhenIteratingBothWays_ThenItemsComeInInsertionOrder,
+                              K,
+                              TestedKeyTypes)
+{
+  Map<K> map = { { 42, "Alice" }, { 27, "Bob" }, { 8, "Carol" } };
+  map.remove(27);
+  map[3] = "Dave";
+
+  std::vector<K> forward, backward;
+  for (auto it = begin(map); it != end(map); ++it)
+    forward.push_back(it->first);
+  for (auto it = end(map); it != begin(map);)
+    backward.push_back((--it)->first);
+
+  BOOST_CHECK((forward == std::vector<K>{ 42, 8, 3 }));
+  BOOST_CHECK((backward == std::vector<K>{ 3, 8, 42 }));
+  BOOST_CHECK_THROW(--begin(map), std::out_of_range);
+  BOOST_CHECK_THROW(map.remove(27), std::out_of_range);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenSmallMap_WhenGrowingPastInlineCapacity_ThenFirstTableIsSmall,
+                              K,
+                              TestedKeyTypes)
+{
+  Map<K> map;
+  for (K i = 0; i <= K(Map<K>::SMALL_CAPACITY); ++i)
+    map[i] = "item";
+
+  // a few buckets, not a table sized for thousands of items
+  BOOST_CHECK_LT(map.getMemoryUsage(), 4096u);
+  BOOST_CHECK_EQUAL(map.valueOf(Map<K>::SMALL_CAPACITY), "item");
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenSmallMap_WhenRemovingWhileIterating_ThenNoItemIsSkipped,
+                              K,
+                              TestedKeyTypes)
+{
+  Map<K> map = { { 0, "item" }, { 1, "item" }, { 2, "item" }, { 3, "item" }, { 4, "item" } };
+
+  auto forward = std::next(map.find(0));
+  map.remove(map.find(0));
+  BOOST_CHECK_EQUAL((++forward)->first, 2);
+
+  auto backward = std::prev(end(map));
+  map.remove(map.find(3));
+  BOOST_CHECK_EQUAL((--backward)->first, 2);
+  BOOST_CHECK_EQUAL((--backward)->first, 1);
+  BOOST_CHECK(backward == begin(map));
+  BOOST_CHECK_THROW(--backward, std::out_of_range);
+  thenMapContainsItems(map, { { 1, "item" }, { 2, "item" }, { 4, "item" } });
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenSmallAndGrownMapsWithSameItems_WhenComparing_ThenTheyAreEqual,
+                              K,
+                              TestedKeyTypes)
+{
+  Map<K> grown;
+  for (K i = 0; i < 20; ++i)
+    grown[i] = "item";
+  for (K i = 3; i < 20; ++i)
+    grown.remove(i);
+  Map<K> small = { { 2, "item" }, { 1, "item" }, { 0, "item" } };
+  const Map<K> copy = small;
+
+  BOOST_CHECK(grown == small);
+  BOOST_CHECK(small == grown);
+  BOOST_CHECK(copy == small);
+  small[1] = "other";
+  BOOST_CHECK(grown != small);
+  BOOST_CHECK(copy != small);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenMapsInVector_WhenVectorGrows_ThenMapsAreMovedNotCopied,
+                              K,
+                              TestedKeyTypes)
+{
+  static_assert(std::is_nothrow_move_constructible<Map<K>>::value, "move may throw");
+  static_assert(std::is_nothrow_move_assignable<Map<K>>::value, "move may throw");
+  std::vector<Map<K>> maps(1);
+  for (K i = 0; i < 100; ++i)
+    maps[0][i] = "item";
+  const auto *item = &*maps[0].find(42);
+
+  maps.resize(maps.capacity() + 1);
+
+  BOOST_CHECK_EQUAL(&*maps[0].find(42), item);
+  BOOST_CHECK_EQUAL(maps[0].getSize(), 100u);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenMovedFromMap_WhenUsedAgain_ThenItBehavesAsEmptyMap,
+                              K,
+                              TestedKeyTypes)
+{
+  Map<K> map;
+  for (K i = 0; i < 100; ++i)
+    map[i] = "item";
+  Map<K> other(std::move(map));
+
+  BOOST_CHECK(map.isEmpty());
+  BOOST_CHECK(begin(map) == end(map));
+  map[1] = "again";
+  thenMapContainsItems(map, { { 1, "again" } });
+  BOOST_CHECK_EQUAL(other.getSize(), 100u);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenClearedMap_WhenFilledAgain_ThenOnlyNewItemsAreThere,
+                              K,
+                              TestedKeyTypes)
+{
+  Map<K> map;
+  for (K i = 0; i < 1000; ++i)
+    map[i] = "old";
+  map.clear();
+
+  BOOST_CHECK(map.isEmpty());
+  BOOST_CHECK(begin(map) == end(map));
+  map[7] = "new";
+  thenMapContainsItems(map, { { 7, "new" } });
+  map.clear();
+  map.clear();
+  BOOST_CHECK(map.isEmpty());
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenFullTable_WhenItGrows_ThenItemsStayInPlace,
+                              K,
+                              TestedKeyTypes)
+{
+  const int full = bucketsHolding<K>(10000) * Map<K>::MAX_LOAD_FACTOR;
+  Map<K> map;
+  std::vector<std::string*> values;
+  for (K i = 0; i < K(full); ++i)
+    values.push_back(&(map[i] = std::to_string(i)));
+
+  // enough to start growing and to finish migrating the whole old table
+  for (int i = full; i < full + 3000; ++i)
+    map[i] = std::to_string(i);
+
+  for (K i = 0; i < K(full); ++i)
+    BOOST_REQUIRE(values[i] == &map.valueOf(i));
+  BOOST_CHECK_EQUAL(map.getSize(), full + 3000u);
+  BOOST_CHECK_EQUAL(std::distance(begin(map), end(map)), full + 3000);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenTableBeingMigrated_WhenUsingMap_ThenBothTablesAreSeen,
+                              K,
+                              TestedKeyTypes)
+{
+  const int full = bucketsHolding<K>(10000) * Map<K>::MAX_LOAD_FACTOR;
+  Map<K> map;
+  std::map<K, std::string> expected;
+  for (int i = 0; i <= full; ++i)
+  {
+    map[i] = std::to_string(i);
+    expected[i] = std::to_string(i);
+  }
+
+  // the new table gets built and about half of the old one migrated meanwhile
+  for (int i = 0; i < 900; ++i)
+  {
+    map.remove(3 * i);
+    expected.erase(3 * i);
+  }
+  std::vector<std::pair<K, std::string>> batch;
+  for (int i = full + 1; i < full + 300; ++i)
+  {
+    batch.emplace_back(i, "batch");
+    expected[i] = "batch";
+  }
+  map.insertBatch(batch.begin(), batch.end());
+
+  thenMapContainsItems(map, expected);
+  std::size_t forward = 0, backward = 0;
+  for (auto it = begin(map); it != end(map); ++it)
+    ++forward;
+  for (auto it = end(map); it != begin(map); --it)
+    ++backward;
+  BOOST_CHECK_EQUAL(forward, expected.size());
+  BOOST_CHECK_EQUAL(backward, expected.size());
+  BOOST_CHECK_EQUAL(map.reduceParallel(std::size_t(0),
+                                       [](const typename Map<K>::value_type&) { return std::size_t(1); },
+                                       [](std::size_t a, std::size_t b) { return a + b; },
+                                       3),
+                    expected.size());
+
+  const Map<K> copy(map);
+  BOOST_CHECK(copy == map);
+  std::stringstream stream;
+  copy.save(stream);
+  Map<K> loaded;
+  loaded.load(stream);
+  thenMapContainsItems(loaded, expected);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenKeysCollidingInOneBucket_WhenAddingAndRemovingThem_ThenAllAreFound,
+                              K,
+                              TestedKeyTypes)
+{
+  Map<K> map;
+  std::map<K, std::string> expected;
+  // all in one bucket of the table they grow the map to
+  const K stride = bucketsHolding<K>(2000);
+  // in ascending order, which used to make the bucket a list
+  for (K i = 0; i < 2000; ++i)
+  {
+    map[i * stride] = std::to_string(i);
+    expected[i * stride] = std::to_string(i);
+  }
+  map[1] = "other bucket";
+  expected[1] = "other bucket";
+
+  thenMapContainsItems(map, expected);
+  BOOST_CHECK_EQUAL(std::distance(begin(map), end(map)), 2001);
+
+  // back to an array, then into a tree again
+  for (K i = 1; i < 2000; ++i)
+  {
+    map.remove(i * stride);
+    expected.erase(i * stride);
+  }
+  thenMapContainsItems(map, expected);
+  for (K i = 2000; i < 2010; ++i)
+  {
+    map[i * stride] = "again";
+    expected[i * stride] = "again";
+  }
+  thenMapContainsItems(map, expected);
+  std::size_t backward = 0;
+  for (auto it = end(map); it != begin(map); --it)
+    ++backward;
+  BOOST_CHECK_EQUAL(backward, expected.size());
+  const Map<K> copy(map);
+  BOOST_CHECK(copy == map);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenMostItemsRemoved_WhenShrinkingToFit_ThenMemoryIsFreedAndItemsStayInPlace,
+                              K,
+                              TestedKeyTypes)
+{
+  Map<K> map;
+  std::map<K, std::string> expected;
+  std::vector<std::string*> values;
+  for (K i = 0; i < 100000; ++i)
+    map[i] = std::to_string(i);
+  for (K i = 0; i < 100000; ++i)
+    if (i % 5)
+      map.remove(i);
+    else
+    {
+      expected[i] = std::to_string(i);
+      values.push_back(&map.valueOf(i));
+    }
+
+  const auto report = map.shrinkToFit();
+
+  BOOST_CHECK_LT(report.after, report.before);
+  BOOST_CHECK_EQUAL(report.after, map.getMemoryUsage());
+  thenMapContainsItems(map, expected);
+  for (K i = 0; i < 100000; i += 5)
+    BOOST_REQUIRE(values[i / 5] == &map.valueOf(i));
+  BOOST_CHECK_EQUAL(std::distance(begin(map), end(map)), 20000);
+  Map<K> filled;
+  for (const auto& item : expected)
+    filled[item.first] = item.second;
+  BOOST_CHECK_EQUAL(map.getMemoryUsage(), filled.getMemoryUsage());
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenFewItemsLeft_WhenShrinkingToFit_ThenMapIsSmallAgain,
+                              K,
+                              TestedKeyTypes)
+{
+  Map<K> map;
+  for (K i = 0; i < 1000; ++i)
+    map[i] = "item";
+  for (K i = 3; i < 1000; ++i)
+    map.remove(i);
+
+  map.shrinkToFit();
+
+  Map<K> small = { { 0, "item" }, { 1, "item" }, { 2, "item" } };
+  BOOST_CHECK_EQUAL(map.getMemoryUsage(), small.getMemoryUsage());
+  BOOST_CHECK(map == small);
+  BOOST_CHECK_EQUAL(std::distance(begin(map), end(map)), 3);
+  for (K i = 3; i < 100; ++i)
+    map[i] = "again";
+  BOOST_CHECK_EQUAL(map.getSize(), 100u);
+  BOOST_CHECK_EQUAL(map.valueOf(99), "again");
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenMinLoadFactor_WhenRemovingItems_ThenTableShrinksOnItsOwn,
+                              K,
+                              TestedKeyTypes)
+{
+  Map<K> map;
+  BOOST_CHECK_THROW(map.setMinLoadFactor(1), std::invalid_argument);
+  BOOST_CHECK_THROW(map.setMinLoadFactor(-0.5), std::invalid_argument);
+  map.setMinLoadFactor(0.25);
+  std::map<K, std::string> expected;
+  for (K i = 0; i < 100000; ++i)
+  {
+    map[i] = std::to_string(i);
+    expected[i] = std::to_string(i);
+  }
+
+  // enough to start shrinking and to finish migrating the whole old table
+  for (K i = 5000; i < 100000; ++i)
+  {
+    map.remove(i);
+    expected.erase(i);
+  }
+
+  thenMapContainsItems(map, expected);
+  BOOST_CHECK_EQUAL(std::distance(begin(map), end(map)), 5000);
+  Map<K> unshrunk;
+  for (K i = 0; i < 100000; ++i)
+    unshrunk[i] = std::to_string(i);
+  for (K i = 5000; i < 100000; ++i)
+    unshrunk.remove(i);
+  Map<K> filled;
+  for (const auto& item : expected)
+    filled[item.first] = item.second;
+  // shrinking leaves the table half loaded at most, so not as small as filling
+  BOOST_CHECK_LT(map.getMemoryUsage(), unshrunk.getMemoryUsage());
+  BOOST_CHECK_GE(map.getMemoryUsage(), filled.getMemoryUsage());
+  const Map<K> copy(map);
+  BOOST_CHECK_EQUAL(copy.getMinLoadFactor(), 0.25);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenFewHundredItemsLeft_WhenShrinking_ThenTableIsSmallerThanTheFirstOneUsedToBe,
+                              K,
+                              TestedKeyTypes)
+{
+  Map<K> shrinking, shrunkToFit;
+  shrinking.setMinLoadFactor(0.25);
+  for (K i = 0; i < 100000; ++i)
+  {
+    shrinking[i] = "item";
+    shrunkToFit[i] = "item";
+  }
+  for (K i = 200; i < 100000; ++i)
+  {
+    shrinking.remove(i);
+    shrunkToFit.remove(i);
+  }
+  shrunkToFit.shrinkToFit();
+
+  // a table of 15693 buckets alone took more
+  BOOST_CHECK_LT(shrinking.getMemoryUsage(), 64u << 10);
+  BOOST_CHECK_LT(shrunkToFit.getMemoryUsage(), 64u << 10);
+  BOOST_CHECK_EQUAL(shrinking.getSize(), 200u);
+  BOOST_CHECK_EQUAL(shrunkToFit.valueOf(199), "item");
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenExtractedNodes_WhenInsertingThemIntoOtherMap_ThenItemsAreNotReallocated,
+                              K,
+                              TestedKeyTypes)
+{
+  Map<K> map;
+  Map<K> other = { { 7, "kept" } };
+  std::vector<const typename Map<K>::value_type*> items;
+  for (K i = 0; i < 1000; ++i)
+  {
+    map[i] = std::to_string(i);
+    items.push_back(map.findItem(i));
+  }
+
+  // the first ones go to other's flat array, the rest to its buckets
+  for (K i = 0; i < 1000; ++i)
+  {
+    if (i == 7)
+      continue;
+    const auto inserted = other.insert(map.extract(i));
+    BOOST_REQUIRE(inserted.second);
+    BOOST_REQUIRE(inserted.first == items[i]);
+  }
+  auto conflicting = map.extract(map.find(7));
+  BOOST_CHECK(!other.insert(std::move(conflicting)).second);
+  BOOST_CHECK_EQUAL(conflicting.mapped(), "7");
+
+  BOOST_CHECK(map.isEmpty());
+  BOOST_CHECK(map.extract(7).isEmpty());
+  BOOST_CHECK_THROW(map.extract(end(map)), std::out_of_range);
+  BOOST_CHECK(!other.insert(typename Map<K>::node_type()).second);
+  BOOST_CHECK_EQUAL(other.getSize(), 1000u);
+  for (K i = 0; i < 1000; ++i)
+    if (i != 7)
+      BOOST_REQUIRE(other.findItem(i) == items[i]);
+  BOOST_CHECK_EQUAL(other.valueOf(7), "kept");
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenMaps_WhenMerging_ThenNonConflictingNodesAreMoved,
+                              K,
+                              TestedKeyTypes)
+{
+  Map<K> map = { { 1, "map" } };
+  Map<K> small = { { 1, "small" }, { 2, "small" } };
+  Map<K> other;
+  std::map<K, std::string> expected = { { 1, "map" }, { 2, "small" } }, left;
+  for (K i = 3; i < 40000; ++i)
+  {
+    other[i] = "other";
+    if (i % 10 == 0)
+      left[i] = "other";
+    else
+      expected[i] = "other";
+  }
+  const auto *item = other.findItem(3);
+
+  map.merge(small);
+  for (K i = 10; i < 40000; i += 10)
+    map[i] = "map";
+  for (const auto& kept : left)
+    expected[kept.first] = "map";
+  map.merge(other);
+
+  thenMapContainsItems(small, { { 1, "small" } });
+  thenMapContainsItems(other, left);
+  thenMapContainsItems(map, expected);
+  BOOST_CHECK_EQUAL(map.findItem(3), item);
+  BOOST_CHECK_EQUAL(std::distance(begin(map), end(map)), static_cast<std::ptrdiff_t>(expected.size()));
+  BOOST_CHECK_EQUAL(std::distance(begin(other), end(other)), static_cast<std::ptrdiff_t>(left.size()));
+}
+
 // ConstIterator is tested via Iterator methods.
 // If Iterator methods are to be changed, then new ConstIterator tests are required.
 
@@ -0,0 +1,193 @@
+#include <Journal.h>
+#include <HashMap.h>
+#include <TreeMap.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+#include <boost/mpl/list.hpp>
+
+using TestedMapTypes = boost::mpl::list<aisdi::TreeMap<std::int32_t, std::string>,
+                                        aisdi::HashMap<std::int32_t, std::string>>;
+
+namespace
+{
+
+// Snapshot and journal paths, removed on leaving the test.
+struct TemporaryFiles
+{
+  const std::string snapshot;
+  const std::string journal;
+
+  explicit TemporaryFiles(const std::string& name)
+    : snapshot("JournalTests_" + name + ".snapshot"), journal("JournalTests_" + name + ".journal")
+  {
+    removeAll();
+  }
+
+  ~TemporaryFiles()
+  {
+    removeAll();
+  }
+
+  void removeAll()
+  {
+    std::remove(snapshot.c_str());
+    std::remove((snapshot + ".tmp").c_str());
+    std::remove(journal.c_str());
+  }
+};
+
+std::string readFile(const std::string& path)
+{
+  std::ifstream in(path, std::ios::binary);
+  return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+void writeFile(const std::string& path, const std::string& bytes)
+{
+  std::ofstream(path, std::ios::binary | std::ios::trunc) << bytes;
+}
+
+template <typename Map>
+void fill(aisdi::JournaledMap<Map>& map)
+{
+  for (int i = 0; i < 1000; ++i)
+    map.assign(i, std::to_string(i));
+  for (int i = 0; i < 1000; i += 2)
+    map.remove(i);
+  map.assign(1, "one");
+}
+
+template <typename Map>
+void thenMapIsFilled(const Map& map)
+{
+  BOOST_CHECK_EQUAL(map.getSize(), 500u);
+  BOOST_CHECK_EQUAL(map.valueOf(1), "one");
+  BOOST_CHECK_EQUAL(map.valueOf(999), "999");
+  BOOST_CHECK(map.find(2) == map.end());
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(JournalTests)
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenJournaledChanges_WhenReopened_ThenMapIsRecovered,
+                              Map,
+                              TestedMapTypes)
+{
+  TemporaryFiles files("recovered");
+  {
+    aisdi::JournaledMap<Map> map(files.snapshot, files.journal);
+    fill(map);
+  }
+
+  aisdi::JournaledMap<Map> reopened(files.snapshot, files.journal);
+
+  thenMapIsFilled(reopened.getMap());
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenTornJournalTail_WhenReopened_ThenWholeRecordsAreKeptAndTailIsCut,
+                              Map,
+                              TestedMapTypes)
+{
+  TemporaryFiles files("torn");
+  {
+    aisdi::JournaledMap<Map> map(files.snapshot, files.journal);
+    map.assign(1, "one");
+    map.assign(2, "two");
+  }
+  std::string bytes = readFile(files.journal);
+  writeFile(files.journal, bytes.substr(0, bytes.size() - 3));
+
+  {
+    aisdi::JournaledMap<Map> reopened(files.snapshot, files.journal);
+    BOOST_CHECK_EQUAL(reopened.getMap().getSize(), 1u);
+    reopened.assign(3, "three");
+  }
+  aisdi::JournaledMap<Map> again(files.snapshot, files.journal);
+
+  BOOST_CHECK_EQUAL(again.getMap().getSize(), 2u);
+  BOOST_CHECK_EQUAL(again.getMap().valueOf(3), "three");
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenSmallCompactionThreshold_WhenChanging_ThenJournalIsCompactedIntoSnapshot,
+                              Map,
+                              TestedMapTypes)
+{
+  TemporaryFiles files("compacted");
+  aisdi::JournalOptions options;
+  options.compactAfterBytes = 4096;
+  {
+    aisdi::JournaledMap<Map> map(files.snapshot, files.journal, options);
+    fill(map);
+  }
+
+  BOOST_CHECK(readFile(files.journal).size() < 4096u);
+  BOOST_CHECK(!readFile(files.snapshot).empty());
+  aisdi::JournaledMap<Map> reopened(files.snapshot, files.journal, options);
+  thenMapIsFilled(reopened.getMap());
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenCrashAfterSnapshotBeforeJournalReset_WhenReopened_ThenMapIsTheSame,
+                              Map,
+                              TestedMapTypes)
+{
+  TemporaryFiles files("crashed");
+  std::string journal;
+  {
+    aisdi::JournaledMap<Map> map(files.snapshot, files.journal);
+    fill(map);
+    map.sync();
+    journal = readFile(files.journal);
+    map.compact();
+  }
+  writeFile(files.journal, journal); // as if the reset never happened
+
+  aisdi::JournaledMap<Map> reopened(files.snapshot, files.journal);
+
+  thenMapIsFilled(reopened.getMap());
+}
+
+BOOST_AUTO_TEST_CASE(GivenRecordsNotSyncedYet_WhenReadingJournal_ThenTheyAreAlreadyInTheFile)
+{
+  TemporaryFiles files("unsynced");
+  aisdi::JournalOptions options;
+  options.syncInterval = std::chrono::hours(1);
+  aisdi::Journal<std::int32_t, std::string> journal(files.journal, options);
+  journal.replay([](const std::vector<aisdi::JournalRecord<std::int32_t, std::string>>&) { });
+
+  journal.recordAssignment(42, "Alice");
+  journal.recordRemoval(27);
+
+  aisdi::Journal<std::int32_t, std::string> reader(files.journal);
+  std::vector<aisdi::JournalRecord<std::int32_t, std::string>> records;
+  reader.replay([&](const std::vector<aisdi::JournalRecord<std::int32_t, std::string>>& batch) {
+    records.insert(records.end(), batch.begin(), batch.end());
+  });
+  BOOST_REQUIRE_EQUAL(records.size(), 2u);
+  BOOST_CHECK_EQUAL(records[0].first, 42);
+  BOOST_CHECK_EQUAL(records[0].second, "Alice");
+  BOOST_CHECK(records[1].removal);
+  BOOST_CHECK_EQUAL(records[1].first, 27);
+}
+
+BOOST_AUTO_TEST_CASE(GivenJournalOfOtherKeyType_WhenOpening_ThenExceptionIsThrown)
+{
+  TemporaryFiles files("types");
+  {
+    aisdi::Journal<std::int32_t, std::string> journal(files.journal);
+  }
+
+  BOOST_CHECK_THROW((aisdi::JournaledMap<aisdi::TreeMap<std::uint64_t, std::string>>(files.snapshot, files.journal)),
+                    aisdi::SnapshotError);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,102 @@
+#include <LockFreeHashMap.h>
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+using Map = aisdi::LockFreeHashMap<std::int32_t, std::string>;
+
+BOOST_AUTO_TEST_SUITE(LockFreeHashMapTests)
+
+BOOST_AUTO_TEST_CASE(GivenEmptyMap_WhenReadingValueOfAnyKey_ThenExceptionIsThrown)
+{
+  const Map map;
+
+  BOOST_CHECK(map.isEmpty());
+  BOOST_CHECK_THROW(map.valueOf(1), std::out_of_range);
+}
+
+BOOST_AUTO_TEST_CASE(GivenNonEmptyMap_WhenInsertingAndAssigning_ThenLatestValueIsVisible)
+{
+  Map map;
+
+  BOOST_CHECK(map.insert(42, "Alice"));
+  BOOST_CHECK(!map.insert(42, "Bob"));
+  map.assign(27, "Bob");
+  map.assign(42, "Chuck");
+
+  std::string value;
+  BOOST_CHECK(map.find(42, value));
+  BOOST_CHECK_EQUAL(value, "Chuck");
+  BOOST_CHECK_EQUAL(map.valueOf(27), "Bob");
+  BOOST_CHECK_EQUAL(map.getSize(), 2u);
+}
+
+BOOST_AUTO_TEST_CASE(GivenNonEmptyMap_WhenRemovingKeys_ThenTheyAreGone)
+{
+  Map map(4, 3); // few buckets, so that chains are long
+  for (int i = 0; i < 20; ++i)
+    map.assign(i, std::to_string(i));
+
+  for (int i = 0; i < 20; i += 2)
+    BOOST_CHECK(map.remove(i));
+
+  BOOST_CHECK(!map.remove(0));
+  BOOST_CHECK_EQUAL(map.getSize(), 10u);
+  for (int i = 0; i < 20; ++i)
+    BOOST_CHECK_EQUAL(map.contains(i), i % 2 == 1);
+
+  map.clear();
+  BOOST_CHECK(map.isEmpty());
+  BOOST_CHECK(!map.contains(1));
+}
+
+// Meant to be run under ThreadSanitizer as well (cmake -DAISDI_TSAN=ON).
+BOOST_AUTO_TEST_CASE(GivenConcurrentWritersAndReaders_WhenStressed_ThenReadersSeeOnlyConsistentValues)
+{
+  Map map(8, 61);
+  const int keys = 512;
+  const int writers = 2;
+  const int readers = 2;
+  const int rounds = 3000;
+  std::atomic<bool> done{false};
+  std::atomic<int> inconsistencies{0};
+
+  std::vector<std::thread> threads;
+  for (int w = 0; w < writers; ++w)
+    threads.emplace_back([&, w]() {
+      for (int r = 0; r < rounds; ++r) {
+        int key = (r * 7 + w * 13) % keys;
+        if (r % 3 == 0) map.remove(key);
+        else if (r % 3 == 1) map.insert(key, std::to_string(key));
+        else map.assign(key, std::to_string(key));
+      }
+    });
+  for (int t = 0; t < readers; ++t)
+    threads.emplace_back([&]() {
+      std::string value;
+      while (!done.load()) {
+        for (int key = 0; key < keys; ++key)
+          if (map.find(key, value) && value != std::to_string(key))
+            ++inconsistencies;
+      }
+    });
+
+  for (int w = 0; w < writers; ++w)
+    threads[w].join();
+  done = true;
+  for (std::size_t t = writers; t < threads.size(); ++t)
+    threads[t].join();
+
+  BOOST_CHECK_EQUAL(inconsistencies.load(), 0);
+  std::size_t present = 0;
+  for (int key = 0; key < keys; ++key)
+    present += map.contains(key);
+  BOOST_CHECK_EQUAL(map.getSize(), present);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
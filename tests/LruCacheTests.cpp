@@ -0,0 +1,157 @@
+#include <LruCache.h>
+
+#include <cstdint>
+#include <string>
+
+#include <boost/test/unit_test.hpp>
+
+#include <boost/mpl/list.hpp>
+
+using TestedPolicies = boost::mpl::list<aisdi::LruEviction, aisdi::ClockEviction,
+                                        aisdi::SegmentedLruEviction>;
+
+template <typename Policy>
+using Cache = aisdi::LruCache<std::int32_t, std::string, Policy>;
+
+BOOST_AUTO_TEST_SUITE(LruCacheTests)
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenEmptyCache_WhenGettingItem_ThenMissIsCounted,
+                              P,
+                              TestedPolicies)
+{
+  Cache<P> cache(4);
+
+  BOOST_CHECK(cache.get(1) == nullptr);
+  BOOST_CHECK(cache.isEmpty());
+  BOOST_CHECK_EQUAL(cache.getStats().misses, 1u);
+  BOOST_CHECK_EQUAL(cache.getStats().hitRate(), 0.0);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenZeroCapacity_WhenCreatingCache_ThenExceptionIsThrown,
+                              P,
+                              TestedPolicies)
+{
+  BOOST_CHECK_THROW(Cache<P>(0), std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenFullCache_WhenPuttingManyItems_ThenSizeStaysAtCapacity,
+                              P,
+                              TestedPolicies)
+{
+  Cache<P> cache(100);
+  for (int i = 0; i < 1000; ++i)
+  {
+    cache.put(i, std::to_string(i));
+    BOOST_REQUIRE(*cache.get(i) == std::to_string(i));
+  }
+
+  BOOST_CHECK_EQUAL(cache.getSize(), 100u);
+  BOOST_CHECK_EQUAL(cache.getCapacity(), 100u);
+  BOOST_CHECK_EQUAL(cache.getStats().evictions, 900u);
+  int cached = 0;
+  for (int i = 0; i < 1000; ++i)
+    cached += cache.contains(i);
+  BOOST_CHECK_EQUAL(cached, 100);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenCachedItem_WhenPuttingSameKey_ThenValueIsReplacedWithoutEviction,
+                              P,
+                              TestedPolicies)
+{
+  Cache<P> cache(2);
+  cache.put(1, "Alice");
+  cache.put(2, "Bob");
+  cache.put(1, "Carol");
+
+  BOOST_CHECK_EQUAL(cache.getSize(), 2u);
+  BOOST_CHECK_EQUAL(*cache.get(1), "Carol");
+  BOOST_CHECK_EQUAL(*cache.get(2), "Bob");
+  BOOST_CHECK_EQUAL(cache.getStats().evictions, 0u);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenCachedItems_WhenRemoving_ThenOnlyThatItemIsGone,
+                              P,
+                              TestedPolicies)
+{
+  Cache<P> cache(3);
+  cache.put(1, "Alice");
+  cache.put(2, "Bob");
+  cache.put(3, "Carol");
+  cache.get(2);
+
+  BOOST_CHECK(cache.remove(2));
+  BOOST_CHECK(!cache.remove(2));
+  cache.put(4, "Dave");
+  cache.put(5, "Eve");
+
+  BOOST_CHECK_EQUAL(cache.getSize(), 3u);
+  BOOST_CHECK(!cache.contains(2));
+  BOOST_CHECK(cache.contains(5));
+  BOOST_CHECK_EQUAL(cache.getStats().evictions, 1u);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenSingleItemCapacity_WhenPuttingNewItem_ThenOldOneIsEvicted,
+                              P,
+                              TestedPolicies)
+{
+  Cache<P> cache(1);
+  cache.put(1, "Alice");
+  cache.get(1);
+  cache.put(2, "Bob");
+
+  BOOST_CHECK(!cache.contains(1));
+  BOOST_CHECK_EQUAL(*cache.get(2), "Bob");
+}
+
+BOOST_AUTO_TEST_CASE(GivenLruCache_WhenItemIsUsed_ThenLeastRecentlyUsedIsEvicted)
+{
+  Cache<aisdi::LruEviction> cache(3);
+  cache.put(1, "Alice");
+  cache.put(2, "Bob");
+  cache.put(3, "Carol");
+  cache.get(1);
+  cache.put(4, "Dave");
+
+  BOOST_CHECK(cache.contains(1));
+  BOOST_CHECK(!cache.contains(2));
+  BOOST_CHECK(cache.contains(3));
+  BOOST_CHECK(cache.contains(4));
+}
+
+BOOST_AUTO_TEST_CASE(GivenClockCache_WhenItemsAreReferenced_ThenFirstUnreferencedIsEvicted)
+{
+  Cache<aisdi::ClockEviction> cache(3);
+  cache.put(1, "Alice");
+  cache.put(2, "Bob");
+  cache.put(3, "Carol");
+  cache.get(1);
+  cache.get(2);
+  cache.put(4, "Dave");
+
+  BOOST_CHECK(cache.contains(1));
+  BOOST_CHECK(cache.contains(2));
+  BOOST_CHECK(!cache.contains(3));
+  BOOST_CHECK(cache.contains(4));
+
+  // the hand cleared the bits passing by
+  cache.put(5, "Eve");
+  BOOST_CHECK(!cache.contains(1));
+}
+
+BOOST_AUTO_TEST_CASE(GivenSegmentedLruCache_WhenScanningOneOffKeys_ThenReusedItemsSurvive)
+{
+  Cache<aisdi::SegmentedLruEviction> cache(10);
+  for (int i = 0; i < 5; ++i)
+  {
+    cache.put(i, "hot");
+    cache.get(i);
+  }
+  for (int i = 100; i < 200; ++i)
+    cache.put(i, "scanned");
+
+  for (int i = 0; i < 5; ++i)
+    BOOST_CHECK(cache.contains(i));
+  BOOST_CHECK_EQUAL(cache.getSize(), 10u);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,112 @@
+#include <MappedMap.h>
+#include <HashMap.h>
+#include <TreeMap.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <system_error>
+
+#include <boost/test/unit_test.hpp>
+
+namespace
+{
+
+// Removes the file on leaving the test.
+struct TemporaryFile
+{
+  const std::string path;
+
+  explicit TemporaryFile(const std::string& name)
+    : path("MappedMapTests_" + name + ".bin")
+  { }
+
+  ~TemporaryFile()
+  {
+    std::remove(path.c_str());
+  }
+};
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(MappedMapTests)
+
+BOOST_AUTO_TEST_CASE(GivenFileWrittenFromHashMap_WhenMapped_ThenItemsAreFoundInPlace)
+{
+  TemporaryFile file("fixed");
+  aisdi::HashMap<std::int32_t, double> source;
+  for (int i = 0; i < 5000; ++i)
+    source[i * 3] = i / 2.0;
+  aisdi::MappedMap<std::int32_t, double>::write(file.path, source);
+
+  const aisdi::MappedMap<std::int32_t, double> map(file.path);
+
+  BOOST_CHECK(map.verify());
+  BOOST_CHECK_EQUAL(map.getSize(), 5000u);
+  BOOST_CHECK_EQUAL(map.valueOf(300), 50.0);
+  BOOST_CHECK(!map.contains(301));
+  BOOST_CHECK_THROW(map.valueOf(301), std::out_of_range);
+  std::int32_t expected = 0;
+  for (const auto& item : map) {
+    BOOST_CHECK_EQUAL(item.first, expected);
+    expected += 3;
+  }
+}
+
+BOOST_AUTO_TEST_CASE(GivenFileWithStrings_WhenMapped_ThenStringsAreReadFromHeap)
+{
+  TemporaryFile file("strings");
+  aisdi::TreeMap<std::string, std::string> source = {
+    { "Warsaw", "Poland" }, { "Rome", "Italy" }, { "", "empty" }, { "Paris", "" } };
+  aisdi::MappedMap<std::string, std::string>::write(file.path, source);
+
+  aisdi::MappedMap<std::string, std::string> map(file.path);
+
+  BOOST_CHECK(map.valueOf("Rome") == std::string("Italy"));
+  BOOST_CHECK(map.valueOf("") == std::string("empty"));
+  BOOST_CHECK_EQUAL(map.valueOf("Paris").size(), 0u);
+  BOOST_CHECK(!map.contains("Berlin"));
+  BOOST_CHECK(map.lowerBound("S")->first == std::string("Warsaw"));
+  BOOST_CHECK(map.lowerBound("Z") == map.end());
+  BOOST_CHECK(map.begin()->first == std::string(""));
+}
+
+BOOST_AUTO_TEST_CASE(GivenEmptySourceMap_WhenMapped_ThenMappedMapIsEmpty)
+{
+  TemporaryFile file("empty");
+  aisdi::MappedMap<std::int32_t, std::int32_t>::write(file.path, aisdi::TreeMap<std::int32_t, std::int32_t>());
+
+  aisdi::MappedMap<std::int32_t, std::int32_t> map(file.path);
+
+  BOOST_CHECK(map.isEmpty());
+  BOOST_CHECK(map.begin() == map.end());
+  BOOST_CHECK(!map.contains(0));
+}
+
+BOOST_AUTO_TEST_CASE(GivenFileOfOtherTypeOrNoFile_WhenMapping_ThenExceptionIsThrown)
+{
+  TemporaryFile file("types");
+  aisdi::MappedMap<std::int32_t, std::int32_t>::write(file.path, aisdi::TreeMap<std::int32_t, std::int32_t>{ { 1, 2 } });
+  TemporaryFile garbage("garbage");
+  std::ofstream(garbage.path) << "definitely not a mapped map, but long enough to hold a header";
+
+  using Map = aisdi::MappedMap<std::uint64_t, std::int32_t>;
+  BOOST_CHECK_THROW(Map map(file.path), aisdi::SnapshotError);
+  BOOST_CHECK_THROW(Map map(garbage.path), aisdi::SnapshotError);
+  BOOST_CHECK_THROW(Map map("MappedMapTests_missing.bin"), std::system_error);
+}
+
+BOOST_AUTO_TEST_CASE(GivenMappedMap_WhenMoved_ThenItemsStayAvailable)
+{
+  TemporaryFile file("moved");
+  aisdi::MappedMap<std::int32_t, std::int32_t>::write(file.path, aisdi::TreeMap<std::int32_t, std::int32_t>{ { 1, 2 } });
+  aisdi::MappedMap<std::int32_t, std::int32_t> map(file.path);
+
+  aisdi::MappedMap<std::int32_t, std::int32_t> moved(std::move(map));
+
+  BOOST_CHECK_EQUAL(moved.valueOf(1), 2);
+  BOOST_CHECK(map.isEmpty());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,167 @@
+#include <ShardedTreeMap.h>
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+using Map = aisdi::ShardedTreeMap<std::int32_t, std::string>;
+
+BOOST_AUTO_TEST_SUITE(ShardedTreeMapTests)
+
+BOOST_AUTO_TEST_CASE(GivenConfiguredSplitPoints_WhenIterating_ThenItemsAreOrderedAcrossShards)
+{
+  Map map({ 300, 100, 200 });
+  for (int key : { 250, 5, 399, 100, 150, 299, 200 })
+    map.assign(key, std::to_string(key));
+
+  std::vector<int> keys;
+  map.forEach([&keys](const Map::value_type& item) { keys.push_back(item.first); });
+
+  BOOST_CHECK_EQUAL(map.getShardsNumber(), 4u);
+  BOOST_CHECK((keys == std::vector<int>{ 5, 100, 150, 200, 250, 299, 399 }));
+}
+
+BOOST_AUTO_TEST_CASE(GivenEmptyShardsInBetween_WhenIterating_ThenIteratorCrossesThemInKeyOrder)
+{
+  Map map({ 100, 200, 300, 400 });
+  for (int key : { 450, 5, 250, 99 })
+    map.assign(key, std::to_string(key));
+
+  std::vector<int> keys;
+  for (auto it = map.begin(); it != map.end(); ++it)
+  {
+    BOOST_CHECK_EQUAL(it->second, std::to_string(it->first));
+    keys.push_back((*it).first);
+  }
+
+  BOOST_CHECK((keys == std::vector<int>{ 5, 99, 250, 450 }));
+  // the locks went with the iterator reaching the end
+  map.assign(150, "150");
+  BOOST_CHECK(map.insert(350, "350"));
+  BOOST_CHECK_EQUAL(map.getSize(), 6u);
+  BOOST_CHECK_THROW(*map.end(), std::out_of_range);
+  const Map empty;
+  BOOST_CHECK(empty.begin() == empty.end());
+}
+
+BOOST_AUTO_TEST_CASE(GivenIterator_WhenMoveAssigned_ThenTargetTakesOverPositionAndLocks)
+{
+  Map map({ 100, 200 });
+  for (int key : { 5, 150, 250 })
+    map.assign(key, std::to_string(key));
+
+  Map::const_iterator it;
+  {
+    auto source = map.begin();
+    ++source;
+    it = std::move(source);
+    BOOST_CHECK(source == map.end());
+  }
+  BOOST_CHECK_EQUAL(it->first, 150);
+  ++it;
+  BOOST_CHECK_EQUAL(it->first, 250);
+  it = map.end();
+  // no locks left behind by either iterator
+  map.assign(50, "50");
+  BOOST_CHECK_EQUAL(map.getSize(), 4u);
+}
+
+BOOST_AUTO_TEST_CASE(GivenSampledSplitPoints_WhenCreated_ThenSampleQuantilesAreUsed)
+{
+  std::vector<int> sample;
+  for (int i = 0; i < 100; ++i)
+    sample.push_back(i);
+
+  Map map(sample.begin(), sample.end(), 4);
+
+  BOOST_CHECK_EQUAL(map.getShardsNumber(), 4u);
+  BOOST_CHECK(map.isEmpty());
+}
+
+BOOST_AUTO_TEST_CASE(GivenNonEmptyMap_WhenUsingKeys_ThenOperationsBehaveAsInTreeMap)
+{
+  Map map({ 100 });
+
+  BOOST_CHECK(map.insert(42, "Alice"));
+  BOOST_CHECK(!map.insert(42, "Bob"));
+  map.assign(127, "Bob");
+
+  BOOST_CHECK_EQUAL(map.valueOf(42), "Alice");
+  BOOST_CHECK_EQUAL(map.valueOf(127), "Bob");
+  BOOST_CHECK_THROW(map.valueOf(1), std::out_of_range);
+  BOOST_CHECK(map.remove(42));
+  BOOST_CHECK(!map.remove(42));
+  BOOST_CHECK_EQUAL(map.getSize(), 1u);
+}
+
+BOOST_AUTO_TEST_CASE(GivenSmallShardLimit_WhenShardOverflows_ThenItIsSplitOnline)
+{
+  Map map({}, 8);
+
+  for (int i = 0; i < 100; ++i)
+    map.assign(i, std::to_string(i));
+
+  BOOST_CHECK(map.getShardsNumber() > 1u);
+  BOOST_CHECK_EQUAL(map.getSize(), 100u);
+  int expected = 0;
+  map.forEach([&expected](const Map::value_type& item) {
+    BOOST_CHECK_EQUAL(item.first, expected);
+    ++expected;
+  });
+  for (int i = 0; i < 100; ++i)
+    BOOST_CHECK_EQUAL(map.valueOf(i), std::to_string(i));
+}
+
+BOOST_AUTO_TEST_CASE(GivenManyThreads_WhenWritingDifferentRanges_ThenAllItemsArePresent)
+{
+  Map map({ 1000, 2000, 3000 }, 256);
+  const int threadsNumber = 4;
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < threadsNumber; ++t)
+    threads.emplace_back([&map, t]() {
+      for (int i = 0; i < 1000; ++i)
+        map.assign(t * 1000 + i, std::to_string(i));
+    });
+  for (auto& thread : threads)
+    thread.join();
+
+  BOOST_CHECK_EQUAL(map.getSize(), 4000u);
+  BOOST_CHECK_EQUAL(map.valueOf(2999), "999");
+}
+
+BOOST_AUTO_TEST_CASE(GivenManyThreads_WhenWritingInterleavedKeys_ThenConcurrentSplitsKeepItemsInOrder)
+{
+  Map map({}, 16);
+  const int threadsNumber = 4, perThread = 2000;
+  std::atomic<int> missing(0);
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < threadsNumber; ++t)
+    threads.emplace_back([&map, &missing, t]() {
+      for (int i = 0; i < perThread; ++i)
+      {
+        map.assign(i * threadsNumber + t, std::to_string(t));
+        if (!map.contains(i * threadsNumber + t))
+          ++missing;
+      }
+    });
+  for (auto& thread : threads)
+    thread.join();
+
+  BOOST_CHECK_EQUAL(missing.load(), 0);
+  BOOST_CHECK_EQUAL(map.getSize(), std::size_t(threadsNumber * perThread));
+  BOOST_CHECK_GT(map.getShardsNumber(), std::size_t(threadsNumber * perThread / 16));
+  int expected = 0;
+  for (const auto& item : map)
+  {
+    BOOST_REQUIRE_EQUAL(item.first, expected);
+    ++expected;
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
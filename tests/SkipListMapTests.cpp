@@ -0,0 +1,149 @@
+#include <SkipListMap.h>
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+#include <boost/mpl/list.hpp>
+
+using TestedKeyTypes = boost::mpl::list<std::int32_t, std::uint64_t>;
+
+template <typename K>
+using Map = aisdi::SkipListMap<K, std::string>;
+
+BOOST_AUTO_TEST_SUITE(SkipListMapTests)
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenEmptyMap_WhenGettingIterators_ThenBeginEqualsEnd,
+                              K,
+                              TestedKeyTypes)
+{
+  const Map<K> map;
+
+  BOOST_CHECK(map.isEmpty());
+  BOOST_CHECK(map.begin() == map.end());
+  BOOST_CHECK_THROW(*map.end(), std::out_of_range);
+  BOOST_CHECK_THROW(map.valueOf(1), std::out_of_range);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenNonEmptyMap_WhenIterating_ThenItemsAreOrdered,
+                              K,
+                              TestedKeyTypes)
+{
+  const Map<K> map = { { 1789, "Paris" }, { 753, "Rome" }, { 1410, "Grunwald" } };
+
+  auto it = map.begin();
+
+  BOOST_CHECK_EQUAL(it->first, 753);
+  BOOST_CHECK_EQUAL((++it)->first, 1410);
+  BOOST_CHECK_EQUAL((++it)->second, "Paris");
+  BOOST_CHECK(++it == map.end());
+  BOOST_CHECK_EQUAL(map.getSize(), 3u);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenNonEmptyMap_WhenInsertingExistingKey_ThenValueIsKept,
+                              K,
+                              TestedKeyTypes)
+{
+  Map<K> map;
+
+  BOOST_CHECK(map.insert(42, "Alice"));
+  BOOST_CHECK(!map.insert(42, "Bob"));
+
+  BOOST_CHECK_EQUAL(map.valueOf(42), "Alice");
+  BOOST_CHECK_EQUAL(map.getSize(), 1u);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenNonEmptyMap_WhenSearchingLowerBound_ThenFirstNotLessItemIsReturned,
+                              K,
+                              TestedKeyTypes)
+{
+  const Map<K> map = { { 10, "a" }, { 20, "b" }, { 30, "c" } };
+
+  BOOST_CHECK_EQUAL(map.lowerBound(20)->first, 20);
+  BOOST_CHECK_EQUAL(map.lowerBound(21)->first, 30);
+  BOOST_CHECK_EQUAL(map.lowerBound(0)->first, 10);
+  BOOST_CHECK(map.lowerBound(31) == map.end());
+  BOOST_CHECK(map.find(21) == map.end());
+  BOOST_CHECK_EQUAL(map.find(30)->second, "c");
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenNonEmptyMap_WhenRemovingKeys_ThenTheyAreGone,
+                              K,
+                              TestedKeyTypes)
+{
+  Map<K> map;
+  for (int i = 0; i < 100; ++i)
+    map.insert(i, std::to_string(i));
+
+  for (int i = 0; i < 100; i += 3)
+    BOOST_CHECK(map.remove(i));
+
+  BOOST_CHECK(!map.remove(0));
+  std::size_t count = 0;
+  for (const auto& item : map) {
+    BOOST_CHECK(item.first % 3 != 0);
+    ++count;
+  }
+  BOOST_CHECK_EQUAL(count, map.getSize());
+  BOOST_CHECK_EQUAL(map.getSize(), 66u);
+}
+
+BOOST_AUTO_TEST_CASE(GivenMapWithCustomOrdering_WhenIterating_ThenItemsFollowThatOrdering)
+{
+  aisdi::SkipListMap<int, int, std::greater<int>> map = { { 1, 1 }, { 3, 3 }, { 2, 2 } };
+
+  auto it = map.begin();
+
+  BOOST_CHECK_EQUAL(it->first, 3);
+  BOOST_CHECK_EQUAL((++it)->first, 2);
+  BOOST_CHECK_EQUAL((++it)->first, 1);
+}
+
+// Meant to be run under ThreadSanitizer as well (cmake -DAISDI_TSAN=ON).
+BOOST_AUTO_TEST_CASE(GivenConcurrentWritersAndScanners_WhenStressed_ThenScansStayOrdered)
+{
+  Map<std::int32_t> map;
+  const int keys = 256;
+  const int writers = 3;
+  const int rounds = 3000;
+  std::atomic<bool> done{false};
+  std::atomic<int> disorders{0};
+
+  std::vector<std::thread> threads;
+  for (int w = 0; w < writers; ++w)
+    threads.emplace_back([&, w]() {
+      for (int r = 0; r < rounds; ++r) {
+        int key = (r * 11 + w * 17) % keys;
+        if (r % 2) map.remove(key);
+        else map.insert(key, std::to_string(key));
+      }
+    });
+  threads.emplace_back([&]() {
+    while (!done.load()) {
+      int previous = -1;
+      for (const auto& item : map) {
+        if (item.first <= previous || item.second != std::to_string(item.first))
+          ++disorders;
+        previous = item.first;
+      }
+    }
+  });
+
+  for (int w = 0; w < writers; ++w)
+    threads[w].join();
+  done = true;
+  threads.back().join();
+
+  BOOST_CHECK_EQUAL(disorders.load(), 0);
+  std::size_t count = 0;
+  for (auto it = map.begin(); it != map.end(); ++it)
+    ++count;
+  BOOST_CHECK_EQUAL(map.getSize(), count);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,132 @@
+#include <SpillableHashMap.h>
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <system_error>
+
+#include <boost/test/unit_test.hpp>
+
+namespace
+{
+
+const std::string SPILL_PATH = "SpillableHashMapTests.spill";
+
+std::string valueFor(int i)
+{
+  return "value of a key far too long for short string storage #" + std::to_string(i);
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(SpillableHashMapTests)
+
+BOOST_AUTO_TEST_CASE(GivenMapWithinBudget_WhenItemsAreUsed_ThenNothingIsSpilled)
+{
+  aisdi::SpillableHashMap<std::int32_t, std::string> map(SPILL_PATH, 1 << 20, 64);
+  for (int i = 0; i < 100; ++i)
+    map.assign(i, valueFor(i));
+
+  BOOST_CHECK_EQUAL(map.getSize(), 100u);
+  BOOST_CHECK_EQUAL(map.valueOf(42), valueFor(42));
+  BOOST_CHECK_EQUAL(map.getMetrics().evictions, 0u);
+  BOOST_CHECK_EQUAL(map.getMetrics().bytesSpilled, 0u);
+  BOOST_CHECK_EQUAL(map.getMetrics().hitRate(), 1.0);
+}
+
+BOOST_AUTO_TEST_CASE(GivenMapOverBudget_WhenItemsAreLookedUp_ThenSpilledBucketsAreFaultedIn)
+{
+  const std::size_t budget = 64 << 10;
+  aisdi::SpillableHashMap<std::int32_t, std::string> map(SPILL_PATH, budget, 64);
+  for (int i = 0; i < 5000; ++i)
+    map.assign(i, valueFor(i));
+
+  const aisdi::SpillMetrics& metrics = map.getMetrics();
+  BOOST_CHECK_EQUAL(map.getSize(), 5000u);
+  BOOST_CHECK_GT(metrics.evictions, 0u);
+  BOOST_CHECK_GT(metrics.bytesSpilled, 0u);
+  BOOST_CHECK_GT(metrics.spilledBuckets, 0u);
+  // one bucket - the pinned one - may stay over the budget
+  BOOST_CHECK_LT(metrics.residentBytes, 2 * budget);
+
+  for (int i = 0; i < 5000; ++i)
+    BOOST_CHECK_EQUAL(map.valueOf(i), valueFor(i));
+  BOOST_CHECK(!map.contains(5000));
+  BOOST_CHECK_GT(metrics.faults, 0u);
+  BOOST_CHECK_GT(metrics.bytesFaulted, 0u);
+  BOOST_CHECK_LT(metrics.hitRate(), 1.0);
+}
+
+BOOST_AUTO_TEST_CASE(GivenSpilledItems_WhenOverwrittenAndRemoved_ThenChangesSurviveSpilling)
+{
+  aisdi::SpillableHashMap<std::int32_t, std::string> map(SPILL_PATH, 16 << 10, 32);
+  for (int i = 0; i < 2000; ++i)
+    map.assign(i, valueFor(i));
+  for (int i = 0; i < 2000; i += 2)
+    map.assign(i, valueFor(-i) + valueFor(i)); // grows past the bucket's old region
+  for (int i = 0; i < 2000; i += 3)
+    BOOST_CHECK(map.remove(i));
+  BOOST_CHECK(!map.remove(0));
+
+  BOOST_CHECK_EQUAL(map.getSize(), 2000u - 667u);
+  for (int i = 0; i < 2000; ++i) {
+    const std::string *value = map.find(i);
+    if (i % 3 == 0)
+      BOOST_CHECK(value == nullptr);
+    else
+      BOOST_CHECK_EQUAL(map.valueOf(i), i % 2 ? valueFor(i) : valueFor(-i) + valueFor(i));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(GivenItemsGrowingAndShrinking_WhenSpilledOverAndOver_ThenSpillFileStaysBounded)
+{
+  aisdi::SpillableHashMap<std::int32_t, std::string> map(SPILL_PATH, 16 << 10, 32);
+  const int items = 2000;
+  const std::size_t longest = 200;
+  for (int round = 0; round < 30; ++round)
+    for (int i = 0; i < items; ++i)
+      map.assign(i, std::string(20 + (round * 37 + i * 11) % (longest - 20), 'x'));
+
+  std::ifstream file(SPILL_PATH, std::ios::binary | std::ios::ate);
+  const std::uint64_t fileBytes = file.tellg();
+  const std::uint64_t spillableBytes = items * (sizeof(std::int32_t) + sizeof(std::uint64_t) + longest);
+  BOOST_CHECK_LE(fileBytes, map.getMetrics().spillFileBytes);
+  BOOST_CHECK_LT(map.getMetrics().spillFileBytes, 4 * spillableBytes);
+  for (int i = 0; i < items; ++i)
+    BOOST_CHECK_EQUAL(map.valueOf(i).size(), 20 + (29 * 37 + i * 11) % (longest - 20));
+}
+
+BOOST_AUTO_TEST_CASE(GivenHotKeys_WhenColdOnesAreScanned_ThenHotBucketsMostlyStayResident)
+{
+  aisdi::SpillableHashMap<std::int32_t, std::int64_t> map(SPILL_PATH, 32 << 10, 256);
+  for (int i = 0; i < 20000; ++i)
+    map.assign(i, i);
+
+  const aisdi::SpillMetrics& metrics = map.getMetrics();
+  for (int round = 0; round < 20; ++round)
+    for (int hot = 0; hot < 8; ++hot)
+      BOOST_CHECK_EQUAL(map.valueOf(hot), hot);
+  const std::uint64_t faults = metrics.faults;
+  for (int hot = 0; hot < 8; ++hot)
+    BOOST_CHECK_EQUAL(map.valueOf(hot), hot);
+  BOOST_CHECK_EQUAL(metrics.faults, faults);
+}
+
+BOOST_AUTO_TEST_CASE(GivenMap_WhenDestroyed_ThenSpillFileIsRemoved)
+{
+  {
+    aisdi::SpillableHashMap<std::int32_t, std::int32_t> map(SPILL_PATH, 0, 8);
+    map.assign(1, 1);
+    map.assign(2, 2);
+    BOOST_CHECK(std::ifstream(SPILL_PATH).good());
+  }
+  BOOST_CHECK(!std::ifstream(SPILL_PATH).good());
+}
+
+BOOST_AUTO_TEST_CASE(GivenUnwritablePath_WhenMapIsCreated_ThenSystemErrorIsThrown)
+{
+  using Map = aisdi::SpillableHashMap<std::int32_t, std::int32_t>;
+  BOOST_CHECK_THROW(Map("no/such/directory/spill", 0), std::system_error);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -1,8 +1,18 @@
 #include <TreeMap.h>
+#include <HashMap.h>
 
+#include <chrono>
 #include <cstdint>
+#include <mutex>
+#include <set>
 #include <string>
+#include <thread>
+#include <sstream>
 #include <map>
+#include <functional>
+#include <iterator>
+#include <vector>
+#include <type_traits>
 
 #include <boost/test/unit_test.hpp>
 
@@ -591,6 +601,474 @@ BOOST_AUTO_TEST_CASE_TEMPLATE(GivenTwoMapsWithDifferentKeys_WhenComparingThem_Th
   BOOST_CHECK(map != other);
 }
 
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenMapWithCustomOrdering_WhenIterating_ThenItemsFollowThatOrdering,
+                              K,
+                              TestedKeyTypes)
+{
+  aisdi::TreeMap<K, std::string, std::greater<K>> map = { { 27, "Bob" }, { 42, "Alice" }, { 13, "Chuck" } };
+
+  auto it = map.begin();
+
+  BOOST_CHECK_EQUAL(it->first, 42);
+  BOOST_CHECK_EQUAL((++it)->first, 27);
+  BOOST_CHECK_EQUAL((++it)->first, 13);
+  BOOST_CHECK(++it == map.end());
+  BOOST_CHECK_EQUAL(map.valueOf(27), "Bob");
+}
+
+template <typename K>
+struct DirectedLess
+{
+  bool descending;
+
+  explicit DirectedLess(bool d = false) : descending(d) {}
+
+  bool operator()(const K& a, const K& b) const
+  {
+    return descending ? b < a : a < b;
+  }
+};
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenEmptyMapsWithDifferentOrderings_WhenAssigning_ThenOrderingIsTakenOver,
+                              K,
+                              TestedKeyTypes)
+{
+  using DirectedMap = aisdi::TreeMap<K, std::string, DirectedLess<K>>;
+  DirectedMap copied(DirectedLess<K>(false)), moved(DirectedLess<K>(false));
+  const DirectedMap descending(DirectedLess<K>(true));
+  DirectedMap source(DirectedLess<K>(true));
+
+  copied = descending;
+  moved = std::move(source);
+  DirectedMap constructed(std::move(moved));
+  for (DirectedMap* map : { &copied, &constructed })
+  {
+    (*map)[1] = "a";
+    (*map)[2] = "b";
+    BOOST_CHECK_EQUAL(map->begin()->first, 2);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(GivenMapWithStringKeys_WhenAddingAndRemovingItems_ThenLookupsFollowThem)
+{
+  aisdi::TreeMap<std::string, int> map;
+  map["prefix-b"] = 2;
+  map["prefix-a"] = 1;
+  map["prefix-c"] = 3;
+
+  map.remove("prefix-b");
+
+  BOOST_CHECK_EQUAL(map.getSize(), 2u);
+  BOOST_CHECK_EQUAL(map.begin()->first, "prefix-a");
+  BOOST_CHECK_EQUAL(map.valueOf("prefix-c"), 3);
+  BOOST_CHECK(map.find("prefix-b") == map.end());
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenNonEmptyMap_WhenSplittingOff_ThenUpperItemsAreMovedToOtherMap,
+                              K,
+                              TestedKeyTypes)
+{
+  Map<K> map = { { 50, "e" }, { 20, "b" }, { 70, "g" }, { 10, "a" }, { 30, "c" }, { 60, "f" }, { 40, "d" } };
+  Map<K> upper;
+
+  map.splitOff(35, upper);
+
+  thenMapContainsItems(map, { { 10, "a" }, { 20, "b" }, { 30, "c" } });
+  thenMapContainsItems(upper, { { 40, "d" }, { 50, "e" }, { 60, "f" }, { 70, "g" } });
+  BOOST_CHECK_EQUAL((--map.end())->first, 30);
+  BOOST_CHECK_EQUAL(upper.begin()->first, 40);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenNonEmptyMap_WhenFindingManyKeys_ThenItemsAreReportedInInputOrder,
+                              K,
+                              TestedKeyTypes)
+{
+  Map<K> map;
+  for (int i = 0; i < 1000; i += 2)
+    map[(i * 37) % 1000] = std::to_string(i);
+  std::vector<K> keys;
+  for (int i = 999; i >= 0; --i)
+    keys.push_back(i);
+
+  for (std::size_t group : { 1u, 3u, 16u, 1000u }) {
+    std::vector<const typename Map<K>::value_type*> found;
+    map.findMany(keys.begin(), keys.end(), std::back_inserter(found), group);
+
+    BOOST_REQUIRE_EQUAL(found.size(), keys.size());
+    for (std::size_t i = 0; i < keys.size(); ++i) {
+      auto it = map.find(keys[i]);
+      if (it == map.end())
+        BOOST_CHECK(found[i] == nullptr);
+      else
+        BOOST_CHECK(found[i] == &*it);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenEmptyMap_WhenFindingManyKeys_ThenNothingIsFound,
+                              K,
+                              TestedKeyTypes)
+{
+  const Map<K> map;
+  std::vector<K> keys = { 1, 2, 3 };
+  std::vector<const typename Map<K>::value_type*> found;
+
+  map.findMany(keys.begin(), keys.end(), std::back_inserter(found));
+
+  BOOST_CHECK((found == std::vector<const typename Map<K>::value_type*>(3, nullptr)));
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenItemsWithDuplicates_WhenBuildingInParallel_ThenLastValueOfEachKeyIsKept,
+                              K,
+                              TestedKeyTypes)
+{
+  std::vector<std::pair<K, std::string>> items;
+  std::map<K, std::string> expected;
+  for (int i = 0; i < 30000; ++i) {
+    K key = (i * 7919) % 11000;
+    items.emplace_back(key, std::to_string(i));
+    expected[key] = std::to_string(i);
+  }
+
+  const auto map = Map<K>::buildParallel(items.begin(), items.end(), 4);
+
+  thenMapContainsItems(map, expected);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenLargeMap_WhenReducingInParallel_ThenResultEqualsSequentialFold,
+                              K,
+                              TestedKeyTypes)
+{
+  Map<K> random, skewed;
+  for (int i = 0; i < 20000; ++i)
+    random[(i * 7919) % 20011] = std::to_string(i);
+  for (int i = 0; i < 9000; ++i)
+    skewed[i] = std::to_string(i); // degenerated into a list
+  auto concat = [](std::string a, std::string b) { a += b; return a; };
+  auto keyOf = [](const typename Map<K>::value_type& item) { return std::to_string(item.first) + ","; };
+
+  for (const Map<K>* map : { &random, &skewed }) {
+    std::string expected;
+    for (const auto& item : *map)
+      expected += keyOf(item);
+
+    BOOST_CHECK(map->reduceParallel(std::string(), keyOf, concat, 4) == expected);
+    BOOST_CHECK(map->reduceParallel(std::string(), keyOf, concat, 1) == expected);
+  }
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenLargeMap_WhenVisitingInParallel_ThenEveryItemIsVisitedOnce,
+                              K,
+                              TestedKeyTypes)
+{
+  Map<K> map;
+  for (int i = 0; i < 20000; ++i)
+    map[(i * 7919) % 20011] = "";
+
+  map.forEachParallel([](typename Map<K>::value_type& item) { item.second += "x"; }, 4);
+
+  for (const auto& item : map)
+    BOOST_CHECK_EQUAL(item.second, "x");
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenListShapedMap_WhenVisitingInParallel_ThenWorkIsShared,
+                              K,
+                              TestedKeyTypes)
+{
+  Map<K> map;
+  for (int i = 0; i < 9000; ++i)
+    map[i] = ""; // degenerated into a list, enough for two workers
+  std::mutex lock;
+  std::set<std::thread::id> workers;
+
+  map.forEachParallel([&](typename Map<K>::value_type& item) {
+    item.second += "x";
+    std::this_thread::sleep_for(std::chrono::microseconds(10));
+    std::lock_guard<std::mutex> guard(lock);
+    workers.insert(std::this_thread::get_id());
+  }, 4);
+
+  BOOST_CHECK_GT(workers.size(), 1u);
+  for (const auto& item : map)
+    BOOST_REQUIRE_EQUAL(item.second, "x");
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenNonEmptyMap_WhenSavedAndLoaded_ThenItemsAreRestored,
+                              K,
+                              TestedKeyTypes)
+{
+  Map<K> map;
+  std::map<K, std::string> expected;
+  for (int i = 0; i < 10000; ++i) {
+    K key = (i * 7919) % 10007;
+    map[key] = std::string(i % 7, 'a' + i % 26);
+    expected[key] = map[key];
+  }
+  std::stringstream stream;
+  map.save(stream);
+  stream << "trailing data";
+
+  Map<K> loaded = { { 1, "overwritten" } };
+  loaded.load(stream);
+
+  thenMapContainsItems(loaded, expected);
+  BOOST_CHECK(loaded == map);
+  std::string rest;
+  stream >> rest;
+  BOOST_CHECK_EQUAL(rest, "trailing");
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenEmptyMap_WhenSavedAndLoaded_ThenLoadedMapIsEmpty,
+                              K,
+                              TestedKeyTypes)
+{
+  const Map<K> map;
+  std::stringstream stream;
+  map.save(stream);
+
+  Map<K> loaded = { { 1, "overwritten" } };
+  loaded.load(stream);
+
+  BOOST_CHECK(loaded.isEmpty());
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenHashMapSnapshot_WhenLoadedIntoTreeMap_ThenItemsAreSorted,
+                              K,
+                              TestedKeyTypes)
+{
+  aisdi::HashMap<K, std::string> hashMap;
+  for (int i = 0; i < 1000; ++i)
+    hashMap[(i * 7919) % 1009] = std::to_string(i);
+  std::stringstream stream;
+  hashMap.save(stream);
+
+  Map<K> map;
+  map.load(stream);
+
+  BOOST_CHECK_EQUAL(map.getSize(), 1000u);
+  K previous = map.begin()->first;
+  for (auto it = ++map.begin(); it != map.end(); ++it) {
+    BOOST_CHECK(previous < it->first);
+    BOOST_CHECK_EQUAL(it->second, hashMap.valueOf(it->first));
+    previous = it->first;
+  }
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenDamagedSnapshot_WhenLoading_ThenExceptionIsThrownAndMapIsKept,
+                              K,
+                              TestedKeyTypes)
+{
+  Map<K> map = { { 42, "Alice" }, { 27, "Bob" } };
+  std::stringstream stream;
+  map.save(stream);
+  std::string bytes = stream.str();
+  bytes[bytes.size() / 2] ^= 1;
+  std::stringstream damaged(bytes);
+  std::stringstream truncated(bytes.substr(0, bytes.size() - 1));
+  std::stringstream garbage("definitely not a snapshot");
+
+  Map<K> loaded = { { 1, "kept" } };
+
+  BOOST_CHECK_THROW(loaded.load(damaged), aisdi::SnapshotError);
+  BOOST_CHECK_THROW(loaded.load(truncated), aisdi::SnapshotError);
+  BOOST_CHECK_THROW(loaded.load(garbage), aisdi::SnapshotError);
+  thenMapContainsItems(loaded, { { 1, "kept" } });
+}
+
+BOOST_AUTO_TEST_CASE(GivenSnapshotOfOtherKeyType_WhenLoading_ThenExceptionIsThrown)
+{
+  const Map<std::int32_t> map = { { 42, "Alice" } };
+  std::stringstream stream;
+  map.save(stream);
+
+  Map<std::uint64_t> loaded;
+
+  BOOST_CHECK_THROW(loaded.load(stream), aisdi::SnapshotError);
+}
+
+BOOST_AUTO_TEST_CASE(GivenSnapshotOfOtherTypeOfSameSize_WhenLoading_ThenExceptionIsThrown)
+{
+  const aisdi::TreeMap<std::int32_t, std::int32_t> map = { { 42, 7 } };
+  std::stringstream asFloats, asUnsigned;
+  map.save(asFloats);
+  map.save(asUnsigned);
+
+  aisdi::TreeMap<std::int32_t, float> floats;
+  aisdi::TreeMap<std::uint32_t, std::int32_t> unsignedKeys;
+
+  BOOST_CHECK_THROW(floats.load(asFloats), aisdi::SnapshotError);
+  BOOST_CHECK_THROW(unsignedKeys.load(asUnsigned), aisdi::SnapshotError);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenMapsInVector_WhenVectorGrows_ThenMapsAreMovedNotCopied,
+                              K,
+                              TestedKeyTypes)
+{
+  static_assert(std::is_nothrow_move_constructible<Map<K>>::value, "move may throw");
+  static_assert(std::is_nothrow_move_assignable<Map<K>>::value, "move may throw");
+  std::vector<Map<K>> maps(1);
+  for (K i = 0; i < 100; ++i)
+    maps[0][i] = "item";
+  const auto *item = &*maps[0].find(42);
+
+  maps.resize(maps.capacity() + 1);
+
+  BOOST_CHECK_EQUAL(&*maps[0].find(42), item);
+  BOOST_CHECK_EQUAL(maps[0].getSize(), 100u);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenMovedFromMap_WhenUsedAgain_ThenItBehavesAsEmptyMap,
+                              K,
+                              TestedKeyTypes)
+{
+  Map<K> map;
+  for (K i = 0; i < 100; ++i)
+    map[i] = "item";
+  Map<K> other(std::move(map));
+
+  BOOST_CHECK(map.isEmpty());
+  BOOST_CHECK(begin(map) == end(map));
+  map[1] = "again";
+  thenMapContainsItems(map, { { 1, "again" } });
+  BOOST_CHECK_EQUAL(other.getSize(), 100u);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenClearedMap_WhenFilledAgain_ThenOnlyNewItemsAreThere,
+                              K,
+                              TestedKeyTypes)
+{
+  Map<K> map;
+  for (K i = 0; i < 1000; ++i)
+    map[i] = "old";
+  map.clear();
+
+  BOOST_CHECK(map.isEmpty());
+  BOOST_CHECK(begin(map) == end(map));
+  map[7] = "new";
+  thenMapContainsItems(map, { { 7, "new" } });
+  map.clear();
+  map.clear();
+  BOOST_CHECK(map.isEmpty());
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenDegenerateTree_WhenCopying_ThenCopyHoldsSameItemsInOrder,
+                              K,
+                              TestedKeyTypes)
+{
+  Map<K> skewed;
+  for (int i = 0; i < 9000; ++i)
+    skewed[i] = std::to_string(i); // degenerated into a list
+  Map<K> assigned = { { 1, "overwritten" } };
+
+  Map<K> copy{skewed};
+  assigned = skewed;
+  skewed[4500] = "changed";
+
+  for (const Map<K>* map : { &copy, &assigned }) {
+    BOOST_CHECK_EQUAL(map->getSize(), 9000u);
+    K expected = 0;
+    for (const auto& item : *map) {
+      BOOST_REQUIRE_EQUAL(item.first, expected);
+      BOOST_CHECK_EQUAL(item.second, std::to_string(expected));
+      ++expected;
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenExtractedNode_WhenInsertingItIntoOtherMap_ThenItemIsNotReallocated,
+                              K,
+                              TestedKeyTypes)
+{
+  Map<K> map = { { 753, "Rome" }, { 1789, "Paris" }, { 1410, "Grunwald" } };
+  Map<K> other = { { 1410, "Tannenberg" } };
+  const auto *rome = &*map.find(753);
+
+  auto node = map.extract(753);
+  BOOST_CHECK(map.extract(753).isEmpty());
+  BOOST_REQUIRE(node);
+  BOOST_CHECK_EQUAL(node.key(), 753);
+  node.mapped() = "Roma";
+  const auto inserted = other.insert(std::move(node));
+
+  BOOST_CHECK(inserted.second);
+  BOOST_CHECK_EQUAL(inserted.first, rome);
+  BOOST_CHECK(node.isEmpty());
+  BOOST_CHECK_THROW(node.key(), std::out_of_range);
+  BOOST_CHECK(!other.insert(std::move(node)).second);
+
+  auto conflicting = map.extract(map.find(1410));
+  const auto refused = other.insert(std::move(conflicting));
+  BOOST_CHECK(!refused.second);
+  BOOST_CHECK_EQUAL(refused.first->second, "Tannenberg");
+  BOOST_CHECK_EQUAL(conflicting.mapped(), "Grunwald");
+  BOOST_CHECK_THROW(map.extract(end(map)), std::out_of_range);
+
+  thenMapContainsItems(map, { { 1789, "Paris" } });
+  thenMapContainsItems(other, { { 753, "Roma" }, { 1410, "Tannenberg" } });
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenMaps_WhenMerging_ThenNonConflictingNodesAreMoved,
+                              K,
+                              TestedKeyTypes)
+{
+  Map<K> map;
+  Map<K> other;
+  std::map<K, std::string> expected, left;
+  std::vector<const std::string*> values;
+  for (K i = 0; i < 20000; ++i)
+  {
+    if (i % 4 == 0)
+    {
+      map[i] = "map";
+      expected[i] = "map";
+    }
+    if (i % 2 == 0)
+    {
+      other[i] = "other";
+      if (i % 4 == 0)
+        left[i] = "other";
+      else
+        expected[i] = "other";
+    }
+  }
+  for (K i = 2; i < 20000; i += 4)
+    values.push_back(&other.valueOf(i));
+
+  map.merge(other);
+
+  thenMapContainsItems(map, expected);
+  thenMapContainsItems(other, left);
+  for (K i = 2; i < 20000; i += 4)
+    BOOST_REQUIRE(values[i / 4] == &map.valueOf(i));
+  K previous = 0;
+  std::size_t iterated = 0;
+  for (const auto& item : map)
+  {
+    BOOST_CHECK(!iterated || previous < item.first);
+    previous = item.first;
+    ++iterated;
+  }
+  BOOST_CHECK_EQUAL(iterated, expected.size());
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenNodeOfTreeMap_WhenInsertingItIntoHashMap_ThenItMovesBetweenKinds,
+                              K,
+                              TestedKeyTypes)
+{
+  Map<K> tree = { { 1, "a" }, { 2, "b" } };
+  aisdi::HashMap<K, std::string> hash;
+  for (K i = 10; i < 100; ++i)
+    hash[i] = "hashed";
+  const auto *item = &*tree.find(2);
+
+  BOOST_CHECK(hash.insert(tree.extract(2)).first == item);
+  BOOST_CHECK(tree.insert(hash.extract(50)).second);
+
+  thenMapContainsItems(tree, { { 1, "a" }, { 50, "hashed" } });
+  BOOST_CHECK_EQUAL(hash.findItem(2), item);
+  BOOST_CHECK_EQUAL(hash.getSize(), 90u);
+}
+
 // ConstIterator is tested via Iterator methods.
 // If Iterator methods are to be changed, then new ConstIterator tests are required.
 